@@ -4,4 +4,5 @@
 
 
 IMPLEMENT_PRIMARY_GAME_MODULE( FDefaultGameModuleImpl, NS, "NS" );
- 
\ No newline at end of file
+
+DEFINE_LOG_CATEGORY(LogNS);
@@ -5,5 +5,14 @@
 
 #include "Engine.h"
 
+DECLARE_LOG_CATEGORY_EXTERN(LogNS, Log, All);
+
+/** Stat group for NS gameplay hot paths, view with "stat NS" */
+DECLARE_STATS_GROUP(TEXT("NS"), STATGROUP_NS, STATCAT_Advanced);
+
+/** Object channels, named in [/Script/Engine.CollisionProfile] of DefaultEngine.ini */
+#define COLLISION_PROJECTILE	ECC_GameTraceChannel1
+#define COLLISION_RED_TEAM		ECC_GameTraceChannel2
+#define COLLISION_BLUE_TEAM		ECC_GameTraceChannel3
 
 #endif
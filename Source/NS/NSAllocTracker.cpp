@@ -0,0 +1,305 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "NS.h"
+#include "NSAllocTracker.h"
+#include "NSCharacter.h"
+#include "NSPlayerState.h"
+#include "NSPerfTracker.h"
+
+static const TCHAR* AllocCounterNames[] =
+{
+	TEXT("ShotTrace"),
+	TEXT("ShotDamage"),
+	TEXT("ShotEffects"),
+	TEXT("GameTasks"),
+	TEXT("HUDDraw")
+};
+static_assert(ARRAY_COUNT(AllocCounterNames) == (int32)ENSAllocCounter::Count, "Every ENSAllocCounter needs a name");
+
+struct FNSAllocCounterData
+{
+	uint64 Calls;
+	uint64 Allocations;
+	uint64 Bytes;
+};
+
+static FNSAllocCounterData AllocCounters[(int32)ENSAllocCounter::Count];
+
+/** Innermost open scope on the game thread */
+static int32 ActiveAllocCounter = INDEX_NONE;
+static bool bAllocCounting = false;
+
+/** Forwards everything to the allocator it wraps, counting game thread allocations of the open scope */
+class FNSMallocCountingProxy : public FMalloc
+{
+public:
+	explicit FNSMallocCountingProxy(FMalloc* InMalloc)
+		: UsedMalloc(InMalloc)
+	{
+	}
+
+	virtual void* Malloc(SIZE_T Count, uint32 Alignment) override
+	{
+		Track(Count);
+		return UsedMalloc->Malloc(Count, Alignment);
+	}
+
+	virtual void* Realloc(void* Original, SIZE_T Count, uint32 Alignment) override
+	{
+		// Any realloc to a non-zero size may have to move the block
+		if (Count > 0)
+		{
+			Track(Count);
+		}
+		return UsedMalloc->Realloc(Original, Count, Alignment);
+	}
+
+	virtual void Free(void* Original) override
+	{
+		UsedMalloc->Free(Original);
+	}
+
+	virtual bool GetAllocationSize(void* Original, SIZE_T& SizeOut) override
+	{
+		return UsedMalloc->GetAllocationSize(Original, SizeOut);
+	}
+
+	virtual void Trim() override
+	{
+		UsedMalloc->Trim();
+	}
+
+	virtual void SetupTLSCachesOnCurrentThread() override
+	{
+		UsedMalloc->SetupTLSCachesOnCurrentThread();
+	}
+
+	virtual void ClearAndDisableTLSCachesOnCurrentThread() override
+	{
+		UsedMalloc->ClearAndDisableTLSCachesOnCurrentThread();
+	}
+
+	virtual void InitializeStatsMetadata() override
+	{
+		UsedMalloc->InitializeStatsMetadata();
+	}
+
+	virtual void UpdateStats() override
+	{
+		UsedMalloc->UpdateStats();
+	}
+
+	virtual void GetAllocatorStats(FGenericMemoryStats& OutStats) override
+	{
+		UsedMalloc->GetAllocatorStats(OutStats);
+	}
+
+	virtual void DumpAllocatorStats(FOutputDevice& Ar) override
+	{
+		UsedMalloc->DumpAllocatorStats(Ar);
+	}
+
+	virtual bool IsInternallyThreadSafe() const override
+	{
+		return UsedMalloc->IsInternallyThreadSafe();
+	}
+
+	virtual bool ValidateHeap() override
+	{
+		return UsedMalloc->ValidateHeap();
+	}
+
+	virtual bool Exec(UWorld* InWorld, const TCHAR* Cmd, FOutputDevice& Ar) override
+	{
+		return UsedMalloc->Exec(InWorld, Cmd, Ar);
+	}
+
+	virtual const TCHAR* GetDescriptiveName() override
+	{
+		return UsedMalloc->GetDescriptiveName();
+	}
+
+private:
+	FORCEINLINE void Track(SIZE_T Count)
+	{
+		if (ActiveAllocCounter != INDEX_NONE && bAllocCounting && IsInGameThread())
+		{
+			FNSAllocCounterData& Data = AllocCounters[ActiveAllocCounter];
+			Data.Allocations++;
+			Data.Bytes += Count;
+		}
+	}
+
+	FMalloc* UsedMalloc;
+};
+
+static FNSMallocCountingProxy* AllocProxy = nullptr;
+
+bool FNSAllocTracker::IsEnabled()
+{
+	return bAllocCounting;
+}
+
+void FNSAllocTracker::Enable()
+{
+	check(IsInGameThread());
+
+	if (AllocProxy == nullptr)
+	{
+		// Never removed: blocks allocated through it may still be freed through GMalloc later
+		AllocProxy = new FNSMallocCountingProxy(GMalloc);
+		GMalloc = AllocProxy;
+		UE_LOG(LogNS, Log, TEXT("Allocation tracking proxy installed over %s"), AllocProxy->GetDescriptiveName());
+	}
+	bAllocCounting = true;
+}
+
+void FNSAllocTracker::Disable()
+{
+	bAllocCounting = false;
+}
+
+void FNSAllocTracker::Reset()
+{
+	FMemory::Memzero(AllocCounters);
+}
+
+uint64 FNSAllocTracker::GetCalls(ENSAllocCounter Counter)
+{
+	return AllocCounters[(int32)Counter].Calls;
+}
+
+uint64 FNSAllocTracker::GetAllocations(ENSAllocCounter Counter)
+{
+	return AllocCounters[(int32)Counter].Allocations;
+}
+
+void FNSAllocTracker::Report()
+{
+	for (int32 i = 0; i < (int32)ENSAllocCounter::Count; ++i)
+	{
+		const FNSAllocCounterData& Data = AllocCounters[i];
+		if (Data.Calls > 0)
+		{
+			UE_LOG(LogNS, Log, TEXT("%-12s %8llu calls %8llu allocs (%.2f per call) %10llu bytes"),
+				AllocCounterNames[i], Data.Calls, Data.Allocations, (double)Data.Allocations / Data.Calls, Data.Bytes);
+		}
+	}
+}
+
+int32 FNSAllocTracker::Enter(ENSAllocCounter Counter)
+{
+	const int32 PreviousCounter = ActiveAllocCounter;
+	if (bAllocCounting && IsInGameThread())
+	{
+		ActiveAllocCounter = (int32)Counter;
+		AllocCounters[ActiveAllocCounter].Calls++;
+	}
+	return PreviousCounter;
+}
+
+void FNSAllocTracker::Leave(int32 PreviousCounter)
+{
+	if (IsInGameThread())
+	{
+		ActiveAllocCounter = PreviousCounter;
+	}
+}
+
+static FAutoConsoleCommand AllocTrackCommand(
+	TEXT("ns.Alloc.Track"),
+	TEXT("Counts heap allocations inside the NS hot paths: ns.Alloc.Track <0/1>. Also enabled by -nsalloc."),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		if (Args.Num() > 0 && FCString::Atoi(*Args[0]) == 0)
+		{
+			FNSAllocTracker::Disable();
+		}
+		else
+		{
+			FNSAllocTracker::Reset();
+			FNSAllocTracker::Enable();
+		}
+	}));
+
+static FAutoConsoleCommand AllocReportCommand(
+	TEXT("ns.Alloc.Report"),
+	TEXT("Logs the heap allocations counted per NS hot path since ns.Alloc.Track"),
+	FConsoleCommandDelegate::CreateLambda([]()
+	{
+		FNSAllocTracker::Report();
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs AllocCheckShotCommand(
+	TEXT("ns.Alloc.CheckShot"),
+	TEXT("Fires N shots (default 100) from the first authoritative character at an enemy and fails if tracing or applying them allocated: ns.Alloc.CheckShot <N>"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		const int32 Shots = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 100;
+
+		ANSCharacter* Shooter = nullptr;
+		for (TActorIterator<ANSCharacter> Iter(World); Iter && Shooter == nullptr; ++Iter)
+		{
+			if ((*Iter)->Role == ROLE_Authority && (*Iter)->GetNSPlayerState() != nullptr)
+			{
+				Shooter = *Iter;
+			}
+		}
+
+		if (Shooter == nullptr)
+		{
+			UE_LOG(LogNS, Warning, TEXT("ns.Alloc.CheckShot needs an authoritative character with a player state"));
+			return;
+		}
+
+		// Aim at an enemy so the damage path runs too, straight up if there is none
+		ANSCharacter* Victim = nullptr;
+		for (TActorIterator<ANSCharacter> Iter(World); Iter && Victim == nullptr; ++Iter)
+		{
+			ANSPlayerState* VictimPS = (*Iter)->GetNSPlayerState();
+			if (VictimPS != nullptr && VictimPS->Team != Shooter->GetNSPlayerState()->Team && VictimPS->Health > 0)
+			{
+				Victim = *Iter;
+			}
+		}
+
+		const FVector Origin = Shooter->GetPawnViewLocation();
+		const FVector Direction = Victim != nullptr ? (Victim->GetActorLocation() - Origin).GetSafeNormal() : FVector::UpVector;
+		const FVector End = Origin + Direction * 10000000.0f;
+		const float VictimHealth = Victim != nullptr ? Victim->GetNSPlayerState()->Health : 0.0f;
+
+		const bool bWasCounting = FNSAllocTracker::IsEnabled();
+		FNSAllocTracker::Enable();
+
+		// The first shot grows the reused buffers to their working size and is not counted
+		for (int32 i = -1; i < Shots; ++i)
+		{
+			if (i == 0)
+			{
+				FNSAllocTracker::Reset();
+			}
+
+			Shooter->FireSpecialized(Origin, End);
+
+			// Keep the victim alive, a kill is not part of a regular shot
+			if (Victim != nullptr)
+			{
+				Victim->GetNSPlayerState()->Health = VictimHealth;
+			}
+		}
+
+		const uint64 Allocations = FNSAllocTracker::GetAllocations(ENSAllocCounter::ShotTrace) + FNSAllocTracker::GetAllocations(ENSAllocCounter::ShotDamage);
+		FNSAllocTracker::Report();
+
+		if (FNSPerfTracker::Expect(Allocations == 0, TEXT("ns.Alloc.CheckShot"),
+			FString::Printf(TEXT("%llu allocations over %d shots (%s)"), Allocations, Shots, Victim != nullptr ? TEXT("hitting an enemy") : TEXT("no enemy in the level"))))
+		{
+			UE_LOG(LogNS, Log, TEXT("ns.Alloc.CheckShot passed: no allocations over %d shots (%s)"),
+				Shots, Victim != nullptr ? TEXT("hitting an enemy") : TEXT("no enemy in the level"));
+		}
+
+		if (!bWasCounting)
+		{
+			FNSAllocTracker::Disable();
+		}
+	}));
@@ -0,0 +1,75 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#ifndef NS_ALLOC_TRACKING
+#define NS_ALLOC_TRACKING !UE_BUILD_SHIPPING
+#endif
+
+/** Hot paths whose heap allocations are counted */
+enum class ENSAllocCounter : uint8
+{
+	ShotTrace,
+	ShotDamage,
+	ShotEffects,
+	GameTasks,
+	HUDDraw,
+	Count
+};
+
+/**
+ * Heap allocations made on the game thread inside NS_ALLOC_SCOPE blocks.
+ *
+ * Enabled with -nsalloc or ns.Alloc.Track 1, which wraps GMalloc in a
+ * counting proxy for the rest of the session. Allocations are charged to
+ * the innermost open scope. ns.Alloc.Report logs allocations per call of
+ * every counter and ns.Alloc.CheckShot fires a series of shots and fails
+ * if tracing or applying them allocated at all.
+ */
+class FNSAllocTracker
+{
+public:
+	static bool IsEnabled();
+
+	/** Installs the proxy if needed and starts counting */
+	static void Enable();
+
+	/** Stops counting, the proxy stays installed */
+	static void Disable();
+
+	static void Reset();
+
+	static uint64 GetCalls(ENSAllocCounter Counter);
+	static uint64 GetAllocations(ENSAllocCounter Counter);
+
+	/** Logs the counters with at least one call */
+	static void Report();
+
+	/** Opens the scope of Counter and returns the one it replaces */
+	static int32 Enter(ENSAllocCounter Counter);
+	static void Leave(int32 PreviousCounter);
+};
+
+/** Charges the allocations of the enclosing scope to one counter */
+class FNSAllocScope
+{
+public:
+	explicit FNSAllocScope(ENSAllocCounter Counter)
+		: PreviousCounter(FNSAllocTracker::Enter(Counter))
+	{
+	}
+
+	~FNSAllocScope()
+	{
+		FNSAllocTracker::Leave(PreviousCounter);
+	}
+
+private:
+	int32 PreviousCounter;
+};
+
+#if NS_ALLOC_TRACKING
+#define NS_ALLOC_SCOPE(Counter) FNSAllocScope ANONYMOUS_VARIABLE(NSAllocScope_)(ENSAllocCounter::Counter)
+#else
+#define NS_ALLOC_SCOPE(Counter)
+#endif
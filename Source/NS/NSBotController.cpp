@@ -0,0 +1,75 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "NS.h"
+#include "NSBotController.h"
+#include "NSCharacter.h"
+
+
+ANSBotController::ANSBotController()
+{
+	// Bots need an ANSPlayerState for team, health and score
+	bWantsPlayerState = true;
+
+	ThinkInterval = 0.25f;
+	FireInterval = 0.5f;
+	AimSpread = 2.0f;
+	AcceptanceRadius = 800.0f;
+
+	Target = nullptr;
+	NextThinkTime = 0.0f;
+	NextFireTime = 0.0f;
+	bMoveIssued = false;
+}
+
+float ANSBotController::ScoreTarget(const FVector& From, const FVector& Forward, const FVector& TargetLocation)
+{
+	const FVector ToTarget = TargetLocation - From;
+	const float DistSq = ToTarget.SizeSquared();
+
+	// Prefer targets in front of us: a target behind counts as three times farther
+	const float Facing = FVector::DotProduct(Forward, ToTarget.GetSafeNormal());
+	return DistSq * (2.0f - Facing);
+}
+
+void ANSBotController::Think(ANSCharacter* BestTarget, float Now)
+{
+	NextThinkTime = Now + ThinkInterval;
+
+	ANSCharacter* BotChar = Cast<ANSCharacter>(GetPawn());
+	if (BotChar == nullptr)
+	{
+		return;
+	}
+
+	if (BestTarget != Target)
+	{
+		Target = BestTarget;
+		bMoveIssued = false;
+	}
+
+	if (Target == nullptr)
+	{
+		ClearFocus(EAIFocusPriority::Gameplay);
+		return;
+	}
+
+	SetFocus(Target);
+
+	// Line of sight is only checked against the best scored target
+	if (LineOfSightTo(Target))
+	{
+		if (Now >= NextFireTime)
+		{
+			NextFireTime = Now + FireInterval;
+
+			const FVector EyeLocation = BotChar->GetPawnViewLocation();
+			const FVector AimDir = FMath::VRandCone((Target->GetActorLocation() - EyeLocation).GetSafeNormal(), FMath::DegreesToRadians(AimSpread));
+			BotChar->FireAt(EyeLocation, AimDir);
+		}
+	}
+	else if (!bMoveIssued || GetMoveStatus() == EPathFollowingStatus::Idle)
+	{
+		MoveToActor(Target, AcceptanceRadius);
+		bMoveIssued = true;
+	}
+}
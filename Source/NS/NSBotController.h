@@ -0,0 +1,58 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "AIController.h"
+#include "NSBotController.generated.h"
+
+/**
+ * Server-side bot. It never thinks on its own tick: the game mode's
+ * FNSBotScheduler calls Think() when the bot's turn comes up inside the
+ * per-frame budget, and the bot fires through ANSCharacter::ServerFire
+ * exactly like a human player.
+ */
+UCLASS(config=Game)
+class NS_API ANSBotController : public AAIController
+{
+	GENERATED_BODY()
+
+public:
+	ANSBotController();
+
+	/** Seconds between two decisions of the same bot */
+	UPROPERTY(Config, EditDefaultsOnly, Category = Bot)
+	float ThinkInterval;
+
+	/** Seconds between two shots */
+	UPROPERTY(Config, EditDefaultsOnly, Category = Bot)
+	float FireInterval;
+
+	/** Random aim error, in degrees */
+	UPROPERTY(Config, EditDefaultsOnly, Category = Bot)
+	float AimSpread;
+
+	/** Distance at which the bot stops walking towards its target */
+	UPROPERTY(Config, EditDefaultsOnly, Category = Bot)
+	float AcceptanceRadius;
+
+	/**
+	 * Pure scoring function used by the scheduler, lower is better.
+	 * Safe to call from worker threads: it only reads the given values.
+	 */
+	static float ScoreTarget(const FVector& From, const FVector& Forward, const FVector& TargetLocation);
+
+	/** Runs one decision: line of sight on the chosen target, then move or fire */
+	void Think(class ANSCharacter* BestTarget, float Now);
+
+	float GetNextThinkTime() const { return NextThinkTime; }
+
+private:
+	UPROPERTY()
+	class ANSCharacter* Target;
+
+	float NextThinkTime;
+	float NextFireTime;
+
+	/** A path request is only issued when the target changes or the last one finished */
+	bool bMoveIssued;
+};
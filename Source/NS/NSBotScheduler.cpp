@@ -0,0 +1,305 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "NS.h"
+#include "NSBotScheduler.h"
+#include "NSBotController.h"
+#include "NSCharacter.h"
+#include "NSPlayerState.h"
+#include "NSGameMode.h"
+#include "NSPerfTracker.h"
+#include "Async/ParallelFor.h"
+
+DECLARE_CYCLE_STAT(TEXT("Bot Scheduler"), STAT_NSBotScheduler, STATGROUP_NS);
+DECLARE_CYCLE_STAT(TEXT("Bot Target Scoring"), STAT_NSBotScoring, STATGROUP_NS);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Bot Decisions"), STAT_NSBotDecisions, STATGROUP_NS);
+
+static TAutoConsoleVariable<int32> CVarBotLogStats(
+	TEXT("ns.Bots.LogStats"),
+	0,
+	TEXT("Logs bot count, scheduler cost and server frame time every 5 seconds."));
+
+FNSBotScheduler::FNSBotScheduler()
+	: Cursor(0)
+	, AvgThinkSeconds(0.0001)
+	, LastThinkMs(0.0f)
+	, LastDecisions(0)
+	, StatsTime(0.0f)
+	, StatsFrames(0)
+	, StatsThinkSeconds(0.0)
+	, StatsFrameSeconds(0.0)
+{
+}
+
+void FNSBotScheduler::AddBot(ANSBotController* Bot)
+{
+	if (Bot != nullptr)
+	{
+		Bots.AddUnique(Bot);
+	}
+}
+
+void FNSBotScheduler::RemoveBot(ANSBotController* Bot)
+{
+	Bots.Remove(Bot);
+}
+
+void FNSBotScheduler::GatherTargets(UWorld* World)
+{
+	Targets.Reset();
+
+	for (TActorIterator<ANSCharacter> Iter(World); Iter; ++Iter)
+	{
+		ANSPlayerState* PS = (*Iter)->GetNSPlayerState();
+
+		if (PS != nullptr && PS->Health > 0 && !(*Iter)->IsPendingKill())
+		{
+			FTarget& NewTarget = Targets[Targets.AddUninitialized()];
+			NewTarget.Character = *Iter;
+			NewTarget.Location = (*Iter)->GetActorLocation();
+			NewTarget.Team = PS->Team;
+		}
+	}
+}
+
+void FNSBotScheduler::ScoreQuery(FQuery& Query) const
+{
+	float BestScore = MAX_flt;
+	Query.BestTarget = INDEX_NONE;
+
+	for (int32 i = 0; i < Targets.Num(); ++i)
+	{
+		if (Targets[i].Team != Query.Team)
+		{
+			const float Score = ANSBotController::ScoreTarget(Query.Location, Query.Forward, Targets[i].Location);
+			if (Score < BestScore)
+			{
+				BestScore = Score;
+				Query.BestTarget = i;
+			}
+		}
+	}
+}
+
+void FNSBotScheduler::Tick(UWorld* World, float BudgetSeconds, bool bParallelScoring)
+{
+	SCOPE_CYCLE_COUNTER(STAT_NSBotScheduler);
+
+	LastThinkMs = 0.0f;
+	LastDecisions = 0;
+
+	Bots.RemoveAll([](const TWeakObjectPtr<ANSBotController>& Bot) { return !Bot.IsValid(); });
+	if (Bots.Num() == 0)
+	{
+		return;
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+	const float Now = World->GetTimeSeconds();
+
+	GatherTargets(World);
+
+	// Only score the bots we expect to reach with this frame's budget
+	const int32 BatchSize = FMath::Clamp(FMath::CeilToInt(BudgetSeconds / AvgThinkSeconds), 1, Bots.Num());
+
+	Batch.Reset();
+	for (int32 i = 0; i < Bots.Num() && Batch.Num() < BatchSize; ++i)
+	{
+		const int32 BotIndex = (Cursor + i) % Bots.Num();
+		ANSBotController* Bot = Bots[BotIndex].Get();
+		ANSCharacter* BotChar = Cast<ANSCharacter>(Bot->GetPawn());
+
+		if (BotChar != nullptr && BotChar->GetNSPlayerState() != nullptr && Bot->GetNextThinkTime() <= Now)
+		{
+			FQuery& Query = Batch[Batch.AddUninitialized()];
+			Query.BotIndex = BotIndex;
+			Query.Location = BotChar->GetActorLocation();
+			Query.Forward = Bot->GetControlRotation().Vector();
+			Query.Team = BotChar->GetNSPlayerState()->Team;
+			Query.BestTarget = INDEX_NONE;
+		}
+	}
+
+	{
+		SCOPE_CYCLE_COUNTER(STAT_NSBotScoring);
+
+		if (bParallelScoring && Batch.Num() > 1)
+		{
+			ParallelFor(Batch.Num(), [this](int32 Index)
+			{
+				ScoreQuery(Batch[Index]);
+			});
+		}
+		else
+		{
+			for (FQuery& Query : Batch)
+			{
+				ScoreQuery(Query);
+			}
+		}
+	}
+
+	// Line of sight, navigation and firing touch the world, so they stay on the game thread
+	int32 Decisions = 0;
+	for (const FQuery& Query : Batch)
+	{
+		if (Decisions > 0 && FPlatformTime::Seconds() - StartTime > BudgetSeconds)
+		{
+			break;
+		}
+
+		ANSCharacter* BestTarget = Query.BestTarget != INDEX_NONE ? Targets[Query.BestTarget].Character : nullptr;
+		Bots[Query.BotIndex]->Think(BestTarget, Now);
+
+		Cursor = (Query.BotIndex + 1) % Bots.Num();
+		++Decisions;
+	}
+
+	const double ThinkSeconds = FPlatformTime::Seconds() - StartTime;
+	if (Decisions > 0)
+	{
+		AvgThinkSeconds = FMath::Lerp(AvgThinkSeconds, FMath::Max(ThinkSeconds / Decisions, 0.000001), 0.1);
+	}
+
+	INC_DWORD_STAT_BY(STAT_NSBotDecisions, Decisions);
+
+	LastThinkMs = ThinkSeconds * 1000.0;
+	LastDecisions = Decisions;
+
+	LogStats(World->GetDeltaSeconds(), ThinkSeconds);
+}
+
+void FNSBotScheduler::LogStats(float DeltaSeconds, double ThinkSeconds)
+{
+	if (CVarBotLogStats.GetValueOnGameThread() == 0)
+	{
+		return;
+	}
+
+	StatsTime += DeltaSeconds;
+	StatsFrames++;
+	StatsThinkSeconds += ThinkSeconds;
+	StatsFrameSeconds += FApp::GetDeltaTime();
+
+	if (StatsTime >= 5.0f)
+	{
+		UE_LOG(LogNS, Log, TEXT("Bots: %d, scheduler %.3f ms/frame, server frame %.2f ms"),
+			Bots.Num(), StatsThinkSeconds * 1000.0 / StatsFrames, StatsFrameSeconds * 1000.0 / StatsFrames);
+
+		StatsTime = 0.0f;
+		StatsFrames = 0;
+		StatsThinkSeconds = 0.0;
+		StatsFrameSeconds = 0.0;
+	}
+}
+
+/** Frame times gathered by ns.Bots.Bench for one bot count */
+struct FNSBotBenchSample
+{
+	int32 Bots;
+	double SchedulerMs;
+	double MaxSchedulerMs;
+	double GameMs;
+	double FrameMs;
+	int32 Decisions;
+	int32 Frames;
+};
+
+static FAutoConsoleCommandWithWorldAndArgs BotsBenchCommand(
+	TEXT("ns.Bots.Bench"),
+	TEXT("Steps the server through bot counts (default 0 16 32 50 64), lets each settle for 2 seconds and measures it for the given seconds, then logs the scheduler and server frame time per count: ns.Bots.Bench <Seconds> <Count> <Count>..."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		ANSGameMode* GameMode = World != nullptr ? World->GetAuthGameMode<ANSGameMode>() : nullptr;
+		if (GameMode == nullptr)
+		{
+			UE_LOG(LogNS, Warning, TEXT("ns.Bots.Bench only runs on the server"));
+			return;
+		}
+
+		const float Seconds = Args.Num() > 0 ? FMath::Max(FCString::Atof(*Args[0]), 1.0f) : 5.0f;
+		const float SettleSeconds = 2.0f;
+
+		TSharedRef<TArray<FNSBotBenchSample>> Samples = MakeShareable(new TArray<FNSBotBenchSample>());
+		for (int32 i = 1; i < Args.Num(); ++i)
+		{
+			Samples->AddZeroed();
+			Samples->Last().Bots = FMath::Max(FCString::Atoi(*Args[i]), 0);
+		}
+		if (Samples->Num() == 0)
+		{
+			for (int32 Count : { 0, 16, 32, 50, 64 })
+			{
+				Samples->AddZeroed();
+				Samples->Last().Bots = Count;
+			}
+		}
+
+		UE_LOG(LogNS, Log, TEXT("ns.Bots.Bench: %d bot counts, %.0f s each, budget %.2f ms per frame"), Samples->Num(), Seconds, GameMode->BotThinkBudgetMs);
+
+		TSharedRef<int32> Current = MakeShareable(new int32(INDEX_NONE));
+		TSharedRef<float> Elapsed = MakeShareable(new float(0.0f));
+		TWeakObjectPtr<UWorld> WeakWorld(World);
+
+		FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([=](float DeltaTime)
+		{
+			UWorld* BenchWorld = WeakWorld.Get();
+			ANSGameMode* BenchGameMode = BenchWorld != nullptr ? BenchWorld->GetAuthGameMode<ANSGameMode>() : nullptr;
+			if (BenchGameMode == nullptr)
+			{
+				return false;
+			}
+
+			if (*Current != INDEX_NONE && *Elapsed < 0.0f)
+			{
+				*Elapsed += DeltaTime;
+				return true;
+			}
+
+			if (*Current != INDEX_NONE && *Elapsed < Seconds)
+			{
+				FNSBotBenchSample& Sample = (*Samples)[*Current];
+				const FNSBotScheduler& Scheduler = BenchGameMode->GetBotScheduler();
+				Sample.SchedulerMs += Scheduler.GetLastThinkMs();
+				Sample.MaxSchedulerMs = FMath::Max<double>(Sample.MaxSchedulerMs, Scheduler.GetLastThinkMs());
+				Sample.GameMs += FPlatformTime::ToMilliseconds(GGameThreadTime);
+				Sample.FrameMs += DeltaTime * 1000.0;
+				Sample.Decisions += Scheduler.GetLastDecisions();
+				Sample.Frames++;
+				*Elapsed += DeltaTime;
+				return true;
+			}
+
+			if (++*Current < Samples->Num())
+			{
+				// Bots join and leave right away, their characters spawn on the next simulation step
+				const int32 Target = (*Samples)[*Current].Bots;
+				while (BenchGameMode->GetBotScheduler().Num() < Target && BenchGameMode->AddBot() != nullptr)
+				{
+				}
+				while (BenchGameMode->GetBotScheduler().Num() > Target && BenchGameMode->RemoveBot())
+				{
+				}
+
+				*Elapsed = -SettleSeconds;
+				return true;
+			}
+
+			UE_LOG(LogNS, Log, TEXT("ns.Bots.Bench   bots  scheduler ms (max)  decisions/frame  game ms  frame ms"));
+			for (const FNSBotBenchSample& Sample : *Samples)
+			{
+				const double Frames = FMath::Max(Sample.Frames, 1);
+				UE_LOG(LogNS, Log, TEXT("ns.Bots.Bench  %5d  %8.3f (%6.3f)  %15.1f  %7.2f  %8.2f"),
+					Sample.Bots, Sample.SchedulerMs / Frames, Sample.MaxSchedulerMs, Sample.Decisions / Frames, Sample.GameMs / Frames, Sample.FrameMs / Frames);
+			}
+
+			// Timings depend on the machine, only the setup of every count is checked
+			for (const FNSBotBenchSample& Sample : *Samples)
+			{
+				FNSPerfTracker::Expect(Sample.Bots == 0 || Sample.Decisions > 0, TEXT("ns.Bots.Bench"),
+					FString::Printf(TEXT("%d bots made no decision in %d frames"), Sample.Bots, Sample.Frames));
+			}
+			FNSPerfTracker::Expect(BenchGameMode->GetBotScheduler().Num() == Samples->Last().Bots, TEXT("ns.Bots.Bench"),
+				FString::Printf(TEXT("%d bots in the scheduler, %d requested"), BenchGameMode->GetBotScheduler().Num(), Samples->Last().Bots));
+			return false;
+		}));
+	}));
@@ -0,0 +1,77 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+enum class ETeam : uint8;
+
+/**
+ * Time-sliced driver for every ANSBotController of the match.
+ *
+ * Each tick it builds one read-only snapshot of the alive characters, scores
+ * targets for the batch of bots expected to fit in the budget (optionally on
+ * worker threads) and then lets bots think, in round robin order, until the
+ * budget is spent. Bots that did not get their turn keep it for next frame.
+ */
+class FNSBotScheduler
+{
+public:
+	FNSBotScheduler();
+
+	void AddBot(class ANSBotController* Bot);
+
+	void RemoveBot(class ANSBotController* Bot);
+
+	/** Runs as many pending decisions as fit in BudgetSeconds */
+	void Tick(UWorld* World, float BudgetSeconds, bool bParallelScoring);
+
+	int32 Num() const { return Bots.Num(); }
+
+	/** Game thread time of the last Tick, in milliseconds */
+	float GetLastThinkMs() const { return LastThinkMs; }
+
+	/** Bots that thought during the last Tick */
+	int32 GetLastDecisions() const { return LastDecisions; }
+
+private:
+	struct FTarget
+	{
+		class ANSCharacter* Character;
+		FVector Location;
+		ETeam Team;
+	};
+
+	struct FQuery
+	{
+		int32 BotIndex;
+		FVector Location;
+		FVector Forward;
+		ETeam Team;
+		int32 BestTarget;
+	};
+
+	void GatherTargets(UWorld* World);
+
+	void ScoreQuery(FQuery& Query) const;
+
+	void LogStats(float DeltaSeconds, double ThinkSeconds);
+
+	TArray<TWeakObjectPtr<class ANSBotController>> Bots;
+
+	TArray<FTarget> Targets;
+
+	TArray<FQuery> Batch;
+
+	/** Next bot to get a turn */
+	int32 Cursor;
+
+	/** Running average of a single decision, used to size the batch */
+	double AvgThinkSeconds;
+
+	float LastThinkMs;
+	int32 LastDecisions;
+
+	float StatsTime;
+	int32 StatsFrames;
+	double StatsThinkSeconds;
+	double StatsFrameSeconds;
+};
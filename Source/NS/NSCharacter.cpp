@@ -4,16 +4,42 @@
 #include "NSCharacter.h"
 #include "NSProjectile.h"
 #include "NSPlayerState.h"
+#include "NSShotTrace.h"
+#include "NSWeaponDefinition.h"
+#include "NSFirePolicies.h"
+#include "NSPerfTracker.h"
+#include "NSAllocTracker.h"
+#include "NSMatchStats.h"
+#include "NSNetStats.h"
+#include "NSGameState.h"
+#include "NSHUD.h"
+#include "NSInterestGrid.h"
+#include "NSCharacterMovementComponent.h"
 #include "Net/UnrealNetwork.h"
 #include "Animation/AnimInstance.h"
 #include "GameFramework/InputSettings.h"
 
 DEFINE_LOG_CATEGORY_STATIC(LogFPChar, Warning, All);
 
+DECLARE_CYCLE_STAT(TEXT("Fire (single)"), STAT_NSFireSingle, STATGROUP_NS);
+DECLARE_CYCLE_STAT(TEXT("Fire (multi-hit)"), STAT_NSFireMultiHit, STATGROUP_NS);
+DECLARE_CYCLE_STAT(TEXT("Fire (pellets)"), STAT_NSFirePellets, STATGROUP_NS);
+
+static TAutoConsoleVariable<int32> CVarGenericFire(
+	TEXT("ns.Fire.Generic"),
+	0,
+	TEXT("1 runs shots through the generic fire path instead of the weapon's specialized policy."));
+
+static TAutoConsoleVariable<int32> CVarDrawFireDebug(
+	TEXT("ns.Fire.DrawDebug"),
+	1,
+	TEXT("Draws a persistent debug line for every shot traced on the server."));
+
 //////////////////////////////////////////////////////////////////////////
 // ANSCharacter
 
-ANSCharacter::ANSCharacter()
+ANSCharacter::ANSCharacter(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer.SetDefaultSubobjectClass<UNSCharacterMovementComponent>(ACharacter::CharacterMovementComponentName))
 {
 	// Set size for collision capsule
 	GetCapsuleComponent()->InitCapsuleSize(42.f, 96.0f);
@@ -69,6 +95,15 @@ ANSCharacter::ANSCharacter()
 	// Default offset from the character location for projectiles to spawn
 	GunOffset = FVector(100.0f, 30.0f, 10.0f);
 
+	FireFunctions = nullptr;
+	PendingShots = 0;
+	bSpawnProtected = false;
+	LastReplicatedTeam = CurrentTeam;
+	PoseRefreshFrame = MAX_uint64;
+
+	// Every shot of this character traces with the same params
+	ShotQueryParams = FCollisionQueryParams(FName(TEXT("NSShot")), false, this);
+
 	// Note: The ProjectileClass and the skeletal mesh/anim blueprints for Mesh1P are set in the
 	// derived blueprint asset named MyCharacter (to avoid direct content references in C++)
 }
@@ -78,13 +113,38 @@ void ANSCharacter::BeginPlay()
 	// Call the base class  
 	Super::BeginPlay();
 
+	FireFunctions = &FNSFirePolicyRegistry::Get(GetWeaponDefinition());
+
 	//FP_Gun->AttachToComponent(FP_Mesh, FAttachmentTransformRules(EAttachmentRule::SnapToTarget, true), TEXT("GripPoint")); //Attach gun mesh component to Skeleton, doing it here because the skelton is not yet created in the constructor
 
-	// TODO - Aadir la inicializacin del equipo 
-	if (Role != ROLE_Authority) 
-	{ 
-		SetTeam(CurrentTeam); 
+	// El equipo ya ha llegado con la replicacin inicial del actor,
+	// OnRep_CurrentTeam solo se ejecuta si cambia despus.
+	ApplyTeamCollision();
+	ApplyTeamAppearance();
+}
+
+bool ANSCharacter::ResolveHitZone(const FVector& Start, const FVector& End, ENSHitZone& OutZone, float& OutDistance)
+{
+	// Los hitboxes se leen del esqueleto animado, que el servidor no actualiza si nadie lo ve:
+	// se evala una vez, en el primer impacto del frame, y solo en los personajes alcanzados
+	USkeletalMeshComponent* MeshComp = GetMesh();
+	if (PoseRefreshFrame != GFrameCounter && MeshComp->SkeletalMesh != nullptr && !MeshComp->bRecentlyRendered)
+	{
+		PoseRefreshFrame = GFrameCounter;
+		MeshComp->RefreshBoneTransforms();
+	}
+
+	Hitboxes.Update(MeshComp);
+
+	// Sin huesos conocidos el esqueleto no es el maniqu: cuenta la cpsula entera como torso
+	if (Hitboxes.IsEmpty())
+	{
+		OutZone = ENSHitZone::Torso;
+		OutDistance = FVector::Dist(Start, GetActorLocation());
+		return true;
 	}
+
+	return Hitboxes.Raycast(Start, End, OutZone, OutDistance);
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -98,6 +158,9 @@ void ANSCharacter::SetupPlayerInputComponent(class UInputComponent* InputCompone
 	InputComponent->BindAction("Jump", IE_Pressed, this, &ACharacter::Jump);
 	InputComponent->BindAction("Jump", IE_Released, this, &ACharacter::StopJumping);
     InputComponent->BindAction("Fire", IE_Pressed, this, &ANSCharacter::OnFire);
+	InputComponent->BindAction("Fire", IE_Released, this, &ANSCharacter::OnStopFire);
+	InputComponent->BindAction("ShowScores", IE_Pressed, this, &ANSCharacter::OnShowScores);
+	InputComponent->BindAction("ShowScores", IE_Released, this, &ANSCharacter::OnHideScores);
 
 	InputComponent->BindAxis("MoveForward", this, &ANSCharacter::MoveForward);
 	InputComponent->BindAxis("MoveRight", this, &ANSCharacter::MoveRight);
@@ -111,30 +174,111 @@ void ANSCharacter::SetupPlayerInputComponent(class UInputComponent* InputCompone
 	InputComponent->BindAxis("LookUpRate", this, &ANSCharacter::LookUpAtRate);
 }
 
+void ANSCharacter::OnShowScores()
+{
+	APlayerController* PC = Cast<APlayerController>(GetController());
+	ANSHUD* HUD = PC != nullptr ? Cast<ANSHUD>(PC->GetHUD()) : nullptr;
+	if (HUD != nullptr)
+	{
+		HUD->SetScoreboardVisible(true);
+	}
+}
+
+void ANSCharacter::OnHideScores()
+{
+	APlayerController* PC = Cast<APlayerController>(GetController());
+	ANSHUD* HUD = PC != nullptr ? Cast<ANSHUD>(PC->GetHUD()) : nullptr;
+	if (HUD != nullptr)
+	{
+		HUD->SetScoreboardVisible(false);
+	}
+}
+
+void ANSCharacter::SetWeapon(UNSWeaponDefinition* NewWeapon)
+{
+	// Weapon replicates, a client changing it would only desync its own fire policy
+	if (Role < ROLE_Authority)
+	{
+		return;
+	}
+
+	StopFiring();
+	Weapon = NewWeapon;
+	FireFunctions = &FNSFirePolicyRegistry::Get(GetWeaponDefinition());
+}
+
+void ANSCharacter::OnRep_Weapon()
+{
+	StopFiring();
+	FireFunctions = &FNSFirePolicyRegistry::Get(GetWeaponDefinition());
+}
+
+const FNSFireFunctions& ANSCharacter::GetFireFunctions()
+{
+	if (FireFunctions == nullptr)
+	{
+		FireFunctions = &FNSFirePolicyRegistry::Get(GetWeaponDefinition());
+	}
+	return *FireFunctions;
+}
+
+const UNSWeaponDefinition* ANSCharacter::GetWeaponDefinition() const
+{
+	return Weapon != nullptr ? Weapon : GetDefault<UNSWeaponDefinition>();
+}
+
 void ANSCharacter::OnFire()
 {
+	if (PendingShots > 0)
+	{
+		return;
+	}
 
+	const FNSFireFunctions& Functions = GetFireFunctions();
+	PendingShots = Functions.bAutomatic ? MAX_int32 : Functions.ShotsPerTrigger;
+	FireShot();
+}
 
-	// try and play a firing animation if specified
-	if (FP_FireAnimation != NULL)
+void ANSCharacter::OnStopFire()
+{
+	if (GetFireFunctions().bAutomatic)
 	{
-		// Get the animation object for the arms mesh
-		UAnimInstance* AnimInstance = FP_Mesh->GetAnimInstance();
-		if (AnimInstance != NULL)
-		{
-			AnimInstance->Montage_Play(FP_FireAnimation, 1.f);
-		}
+		StopFiring();
+	}
+}
+
+void ANSCharacter::StopFiring()
+{
+	PendingShots = 0;
+
+	UWorld* World = GetWorld();
+	if (World != nullptr)
+	{
+		World->GetTimerManager().ClearTimer(RefireTimer);
 	}
+}
 
-	if (FP_GunShotParticle != nullptr)
+void ANSCharacter::FireShot()
+{
+	if (PendingShots <= 0)
 	{
-		FP_GunShotParticle->Activate(true);
+		return;
 	}
 
+	// The refire timer may outlive the controller: unpossessed, dead or respawned
+	APlayerController* pController = Cast<APlayerController>(GetController());
+	if (pController == nullptr || GEngine->GameViewport == nullptr || GEngine->GameViewport->Viewport == nullptr)
+	{
+		StopFiring();
+		return;
+	}
+	--PendingShots;
+
+	GetFireFunctions().PlayLocalEffects(this);
+
 	FVector mousePos; 
 	FVector mouseDir;
 
-	APlayerController* pController = Cast<APlayerController>(GetController());
 	FVector2D ScreenPos = GEngine->GameViewport->Viewport->GetSizeXY();
 
 	pController->DeprojectScreenPositionToWorld(ScreenPos.X / 2.0f, ScreenPos.Y / 2.0f, mousePos, mouseDir);
@@ -143,10 +287,21 @@ void ANSCharacter::OnFire()
 
 	ServerFire(mousePos, mouseDir);
 
+	if (PendingShots > 0)
+	{
+		GetWorldTimerManager().SetTimer(RefireTimer, this, &ANSCharacter::FireShot, GetWeaponDefinition()->FireInterval, false);
+	}
+}
+
+void ANSCharacter::FireAt(const FVector& Origin, const FVector& Direction)
+{
+	ServerFire(Origin, Direction * 10000000.0f);
 }
 
 bool ANSCharacter::ServerFire_Validate(const FVector pos, const FVector dir) 
 { 
+	NS_PERF_SCOPE(FireValidation);
+
 	// Validamos si la posicin y la direccin son vlidas. 
 	// En este caso, es vlido si no son iguales al vector por defecto. 
 	if (pos != FVector(ForceInit) && dir != FVector(ForceInit)) 
@@ -161,108 +316,228 @@ bool ANSCharacter::ServerFire_Validate(const FVector pos, const FVector dir)
 
 void ANSCharacter::ServerFire_Implementation(const FVector pos, const FVector dir) 
 { 
+	FNSNetStats::Record(ENSNetEvent::ServerFire, GetNetConnection(), FNSNetStats::RPCHeaderBytes + sizeof(pos) + sizeof(dir));
+
+	// El disparo se valida en paralelo con los dems del frame y se ejecuta en el tick del GameMode
+	ANSGameMode* GameMode = GetWorld()->GetAuthGameMode<ANSGameMode>();
+	if (GameMode != nullptr)
+	{
+		GameMode->GetTasks().QueueShot(this, pos, dir);
+	}
+	else
+	{
+		ProcessShot(pos, dir);
+	}
+}
+
+void ANSCharacter::ProcessShot(const FVector& pos, const FVector& dir)
+{
+	const UNSWeaponDefinition* WeaponDef = GetWeaponDefinition();
+
+	const TStatId FireStat = WeaponDef->PelletCount > 1 ? GET_STATID(STAT_NSFirePellets)
+		: (WeaponDef->MaxPenetrations > 0 ? GET_STATID(STAT_NSFireMultiHit) : GET_STATID(STAT_NSFireSingle));
+	FScopeCycleCounter CycleCounter(FireStat);
+	NS_PERF_SCOPE(Fire);
+
+	FNSMatchStats::Record(ENSStatsEvent::Shot, GetNSPlayerState());
+
+	ANSGameMode* GameMode = GetWorld()->GetAuthGameMode<ANSGameMode>();
+	if (GameMode != nullptr && NSPlayerState != nullptr && !NSPlayerState->bIsABot)
+	{
+		GameMode->GetCheatDetector().AddShot(NSPlayerState->PlayerId, GetWorld()->GetTimeSeconds(), pos, (dir - pos).GetSafeNormal());
+	}
+
+	if (CVarGenericFire.GetValueOnGameThread() != 0)
+	{
+		FireGeneric(pos, dir);
+	}
+	else
+	{
+		FireSpecialized(pos, dir);
+	}
+
+	if (CVarDrawFireDebug.GetValueOnGameThread() != 0)
+	{
+		// Dibujamos una linea que nos permite visualizar la trayectoria. 
+		DrawDebugLine(GetWorld(), pos, pos + (dir - pos).GetSafeNormal() * WeaponDef->Range, FColor::Red, true, 100, 0, 5.0f);
+	}
+}
+
+void ANSCharacter::FireGeneric(const FVector& Origin, const FVector& End, bool bSendEffects)
+{
 	// Llamamos a la funcin Fire para ejecutar el disparo. 
-	Fire(pos, dir); 
+	Fire(Origin, End); 
 	
-	// Adems, replicamos los efectos del disparo a todos los clientes 
-	// con la funcin definida para ello. 
-	MultiCastShootEffects(); 
+	// Adems, replicamos los efectos del disparo a los clientes 
+	// que pueden verlo u orlo. 
+	if (bSendEffects)
+	{
+		SendShootEffects();
+	}
+}
+
+void ANSCharacter::FireSpecialized(const FVector& Origin, const FVector& End)
+{
+	GetFireFunctions().ServerFire(this, GetWeaponDefinition(), Origin, (End - Origin).GetSafeNormal());
 }
 
 void ANSCharacter::MultiCastShootEffects_Implementation() 
 { 
-	// Ejecutamos la animacin del disparo en 3 Persona si est declarada. 
-	if (TP_FireAnimation != NULL) 
-	{ 
-		// Obtenemos la instancia de la animacin para el personaje 
-		UAnimInstance* AnimInstance = GetMesh()->GetAnimInstance();
-		if (AnimInstance != NULL) 
-		{ 
-			AnimInstance->Montage_Play(TP_FireAnimation, 1.f); 
-		} 
-	} // Ejecutamos el sonido del disparo si est declarado.
-	if (FireSound != NULL) 
-	{ 
-		UGameplayStatics::PlaySoundAtLocation(this, FireSound, GetActorLocation()); 
+	if (Role == ROLE_Authority)
+	{
+		FNSNetStats::RecordMulticast(ENSNetEvent::MultiCastShootEffects, this, FNSNetStats::RPCHeaderBytes);
 	}
 
-	// Activamos el sistema de particulas del disparo en 3 persona si est activado. 
-	if (TP_GunShotParticle != nullptr) 
-	{ 
-		TP_GunShotParticle->Activate(true); 
-	} 
-	// Creamos un proyectil en la localizacin del disparo. 
-	if (BulletParticle != nullptr) 
-	{ 
-		UGameplayStatics::SpawnEmitterAtLocation(GetWorld(), BulletParticle->Template, BulletParticle->GetComponentLocation(), BulletParticle->GetComponentRotation()); 
-	} 
+	PlayShotEffects();
+}
+
+void ANSCharacter::PlayShotEffects()
+{
+	// Weapons without effects never send these events, so this only runs the effects policy
+	GetFireFunctions().PlayRemoteEffects(this);
+}
+
+void ANSCharacter::SendShootEffects()
+{
+	NS_ALLOC_SCOPE(ShotEffects);
+
+	ANSGameMode* GameMode = GetWorld()->GetAuthGameMode<ANSGameMode>();
+	if (GameMode == nullptr || !FNSInterestGrid::IsEnabled())
+	{
+		MultiCastShootEffects();
+		return;
+	}
+
+	if (GetNetMode() != NM_DedicatedServer)
+	{
+		PlayShotEffects();
+	}
+	GameMode->SendShotEffects(this);
+}
+
+void ANSCharacter::SendRagdoll()
+{
+	ANSGameMode* GameMode = GetWorld()->GetAuthGameMode<ANSGameMode>();
+	if (GameMode == nullptr || !FNSInterestGrid::IsEnabled())
+	{
+		MultiCastRagdoll();
+		return;
+	}
+
+	BecomeCorpse(GetNetMode() != NM_DedicatedServer);
+	GameMode->SendRagdoll(this);
 }
 
 void ANSCharacter::Fire(const FVector pos, const FVector dir) 
 { 
 	// Representamos el rayo de la trayectoria del proyectil
-	FCollisionObjectQueryParams ObjQuery;
-	ObjQuery.AddObjectTypesToQuery(ECC_GameTraceChannel1); 
+	FNSShotDamageList Damages;
+	FNSShotTrace::Trace(this, CurrentTeam, GetWeaponDefinition(), pos, (dir - pos).GetSafeNormal(), FNSShotTrace::GetFireStream(), Damages);
 
-	FCollisionQueryParams ColQuery; 
-	ColQuery.AddIgnoredActor(this); 
-	FHitResult HitRes; 
-	
-	GetWorld()->LineTraceSingleByObjectType(HitRes, pos, dir, ObjQuery, ColQuery);
+	ApplyShotDamage(Damages);
+}
 
-	// Dibujamos una linea que nos permite visualizar la trayectoria. 
-	DrawDebugLine(GetWorld(), pos, dir, FColor::Red, true, 100, 0, 5.0f);
+void ANSCharacter::ApplyShotDamage(const FNSShotDamageList& Damages, bool bAimed)
+{
+	NS_ALLOC_SCOPE(ShotDamage);
 
-	// Preguntamos si el disparo ha impactado en algn objeto. 
-	if (HitRes.bBlockingHit) 
+	ANSGameMode* GameMode = GetWorld()->GetAuthGameMode<ANSGameMode>();
+	const bool bDetectCheats = bAimed && GameMode != nullptr && NSPlayerState != nullptr && !NSPlayerState->bIsABot;
+
+	// Un disparo que alcanza a varios enemigos cuenta como un solo acierto, y las explosiones no cuentan
+	if (bAimed && Damages.Num() > 0)
 	{
-		ANSCharacter* OtherChar = Cast<ANSCharacter>(HitRes.GetActor());
+		float ShotDamage = 0.0f;
+		for (const FNSShotDamage& Hit : Damages)
+		{
+			ShotDamage += Hit.Damage;
+		}
+		FNSMatchStats::Record(ENSStatsEvent::Hit, NSPlayerState, Damages[0].Victim->NSPlayerState, ShotDamage);
+	}
 
-		// Preguntamos si el disparo ha impactado en otro jugador y si es del otro equipo al que pertence el personaje. 		
-		if (OtherChar != nullptr && OtherChar->GetNSPlayerState()->Team != this->GetNSPlayerState()->Team)
-		{ 
-			// Indicamos al otro personaje que ha recibido un dao de 10.0f 
-			FDamageEvent thisEvent(UDamageType::StaticClass()); 
-			OtherChar->TakeDamage(10.0f, thisEvent, this->GetController(), this); 
-			
-			// Informamos al cliente que tiene el control del personaje, que ha tenido xito en su disparo.
-			APlayerController* thisPC = Cast<APlayerController>(GetController()); 
+	// Cada enemigo alcanzado recibe el dao de todos sus perdigones de una vez
+	for (const FNSShotDamage& Hit : Damages)
+	{
+		if (bDetectCheats && Hit.Victim->NSPlayerState != nullptr)
+		{
+			GameMode->GetCheatDetector().AddHit(NSPlayerState->PlayerId, Hit.Victim->NSPlayerState->PlayerId, GetWorld()->GetTimeSeconds());
+		}
+
+		FDamageEvent thisEvent(UDamageType::StaticClass()); 
+		Hit.Victim->TakeDamage(Hit.Damage, thisEvent, this->GetController(), this); 
+	}
+
+	if (Damages.Num() > 0)
+	{
+		// Informamos al cliente que tiene el control del personaje, que ha tenido xito en su disparo.
+		APlayerController* thisPC = Cast<APlayerController>(GetController()); 
+		if (thisPC != nullptr)
+		{
 			thisPC->ClientPlayForceFeedback(HitSuccessFeedback, false, NAME_None); 
-		} 
+		}
 	} 
 }
 
 float ANSCharacter::TakeDamage(float Damage, struct FDamageEvent const& DamageEvent, AController* EventInstigator, AActor* DamageCauser) 
 {
+	NS_PERF_SCOPE(Damage);
+
 	// Llamamos al mtodo de la clase padre 
 	Super::TakeDamage(Damage, DamageEvent, EventInstigator, DamageCauser); 
 	
 	// Comprobamos que esta funcin est siendo ejecutada por el servidor, 
 	// que el dao no se lo esta causando el propio jugador, 
 	// y que la salud actual del jugador es mayor que 0. 
-	if (Role == ROLE_Authority && DamageCauser != this && NSPlayerState->Health > 0)
+	if (Role == ROLE_Authority && DamageCauser != this && !bSpawnProtected && NSPlayerState->Health > 0)
 	{
 		// Restamos la salud, y ejecutamos en el cliente al que pertenece el jugador el sonido de que ha sido daado. 
 		NSPlayerState->Health -= Damage; 
 		
 		PlayPain(); 
+		FNSNetStats::Record(ENSNetEvent::PlayPain, GetNetConnection(), FNSNetStats::RPCHeaderBytes);
 		
 		// Comprobamos si ha muerto 
 		if (NSPlayerState->Health <= 0) 
 		{ 
-			// Incrementamos el nmero de muertes. NSPlayerState->Deaths++;
+			// Incrementamos el nmero de muertes.
+			NSPlayerState->Deaths++;
+
 			// Ejecutamos en todos los clientes la animacin de que el personaje a muerto. 
-			MultiCastRagdoll();
+			SendRagdoll();
 
 			// Incrementamos la puntuacin del jugador que ha conseguido matar al personaje. 
 			ANSCharacter * OtherChar = Cast< ANSCharacter >(DamageCauser); 
 			if (OtherChar) 
 			{ 
 				OtherChar->NSPlayerState->Score += 1.0f; 
+
+				// Sumamos la muerte al marcador del equipo y al registro de muertes del HUD. 
+				ANSGameState* GS = GetWorld()->GetGameState<ANSGameState>();
+				if (GS != nullptr)
+				{
+					GS->AddKill(OtherChar->NSPlayerState, NSPlayerState);
+				}
+
+				FNSMatchStats::Record(ENSStatsEvent::Kill, OtherChar->NSPlayerState, NSPlayerState);
+				FNSMatchStats::Record(ENSStatsEvent::Death, NSPlayerState, OtherChar->NSPlayerState);
 			} 
-			// Despus de 3 segundos, volvemos a crear al jugador en la partida. 
-			FTimerHandle thisTimer; 
-			GetWorldTimerManager().SetTimer<ANSCharacter>(thisTimer, this, &ANSCharacter::Respawn, 3.0f, false); 
+			else
+			{
+				// Sin asesino no hay AddKill que avise al marcador de la nueva muerte
+				ANSGameState* GS = GetWorld()->GetGameState<ANSGameState>();
+				if (GS != nullptr)
+				{
+					GS->NotifyScoreboardChanged();
+				}
+
+				FNSMatchStats::Record(ENSStatsEvent::Death, NSPlayerState);
+			}
+			// Despus de unos segundos, el GameMode vuelve a crear al jugador en la partida. 
+			ANSGameMode* GameMode = GetWorld()->GetAuthGameMode<ANSGameMode>();
+			if (GameMode != nullptr)
+			{
+				GameMode->ScheduleRespawn(this);
+			}
 		} 
 	} 
 	return Damage; 
@@ -279,17 +554,61 @@ void ANSCharacter::PlayPain_Implementation()
 
 void ANSCharacter::MultiCastRagdoll_Implementation() 
 { 
-	GetMesh()->SetPhysicsBlendWeight(1.0f); 
-	GetMesh()->SetSimulatePhysics(true); 
-	GetMesh()->SetCollisionProfileName("Ragdoll"); 
+	if (Role == ROLE_Authority)
+	{
+		FNSNetStats::RecordMulticast(ENSNetEvent::MultiCastRagdoll, this, FNSNetStats::RPCHeaderBytes);
+	}
+
+	// Un servidor dedicado no necesita simular el ragdoll, solo controla cunto dura el cadver
+	BecomeCorpse(GetNetMode() != NM_DedicatedServer);
+}
+
+void ANSCharacter::BecomeCorpse(bool bSimulatePhysics)
+{
+	if (bSimulatePhysics)
+	{
+		GetMesh()->SetPhysicsBlendWeight(1.0f); 
+		GetMesh()->SetSimulatePhysics(true); 
+		GetMesh()->SetCollisionProfileName("Ragdoll"); 
+	}
+	else if (GetNetMode() != NM_DedicatedServer)
+	{
+		// Un cliente lejano no lo simula, y un cadver de pie quedara peor que ninguno
+		GetMesh()->SetVisibility(false, true);
+	}
+
+	ANSGameState* GS = GetWorld()->GetGameState<ANSGameState>();
+	if (GS != nullptr)
+	{
+		GS->GetCorpseManager().AddCorpse(this);
+	}
+}
+
+void ANSCharacter::SetCorpseFade(float Alpha)
+{
+	if (DynamicMat != nullptr)
+	{
+		DynamicMat->SetScalarParameterValue(TEXT("FadeAlpha"), Alpha);
+	}
+}
+
+bool ANSCharacter::CanFadeCorpse() const
+{
+	float Alpha = 0.0f;
+	return DynamicMat != nullptr && DynamicMat->GetScalarParameterValue(TEXT("FadeAlpha"), Alpha);
 }
 
 void ANSCharacter::Respawn() 
 { 
 	// Comprobamos que esta funcin est siendo ejecutada por el servidor. 
 	if (Role == ROLE_Authority) 
-	{ // Restauramos la vida 
-		NSPlayerState->Health = 100.0f; 
+	{ 
+		// El GameMode crea el nuevo personaje, y PossessedBy restaura la vida
+		ANSGameMode* GameMode = GetWorld()->GetAuthGameMode<ANSGameMode>();
+		if (GameMode != nullptr)
+		{
+			GameMode->Respawn(GetController());
+		}
 	} 
 }
 
@@ -362,19 +681,84 @@ void ANSCharacter::PossessedBy(AController* NewController)
 	}
 }
 
+void ANSCharacter::UnPossessed()
+{
+	StopFiring();
+
+	Super::UnPossessed();
+}
+
+void ANSCharacter::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	StopFiring();
+
+	// A corpse can be destroyed before its controller respawns, the teams must not keep it
+	ANSGameMode* GameMode = GetWorld()->GetAuthGameMode<ANSGameMode>();
+	if (GameMode != nullptr)
+	{
+		GameMode->RemoveCharacter(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
 void ANSCharacter::GetLifetimeReplicatedProps(TArray< FLifetimeProperty > & OutLifetimeProps) const 
 { 
 	Super::GetLifetimeReplicatedProps(OutLifetimeProps); 
 	
 	DOREPLIFETIME(ANSCharacter, CurrentTeam);
+	DOREPLIFETIME(ANSCharacter, Weapon);
 }
 
-void ANSCharacter::SetTeam_Implementation(ETeam NewTeam) 
+void ANSCharacter::PreReplication(IRepChangedPropertyTracker& ChangedPropertyTracker)
+{
+	Super::PreReplication(ChangedPropertyTracker);
+
+	if (CurrentTeam != LastReplicatedTeam)
+	{
+		FNSNetStats::RecordMulticast(ENSNetEvent::Prop_CurrentTeam, this, FNSNetStats::PropertyHeaderBytes + sizeof(CurrentTeam));
+		LastReplicatedTeam = CurrentTeam;
+	}
+}
+
+void ANSCharacter::SetTeam(ETeam NewTeam) 
 { 
+	if (Role == ROLE_Authority)
+	{
+		CurrentTeam = NewTeam;
+
+		// OnRep no se ejecuta en el servidor
+		ApplyTeamCollision();
+		ApplyTeamAppearance();
+	}
+}
+
+void ANSCharacter::OnRep_CurrentTeam()
+{
+	ApplyTeamCollision();
+	ApplyTeamAppearance();
+}
+
+void ANSCharacter::ApplyTeamCollision()
+{
+	// Los disparos solo consultan el canal del equipo enemigo
+	const ECollisionChannel TeamChannel = FNSShotTrace::GetTeamChannel(CurrentTeam);
+	GetCapsuleComponent()->SetCollisionObjectType(TeamChannel);
+	GetMesh()->SetCollisionObjectType(TeamChannel);
+}
+
+void ANSCharacter::ApplyTeamAppearance()
+{
+	// Un servidor dedicado no dibuja, no necesita el material
+	if (GetNetMode() == NM_DedicatedServer)
+	{
+		return;
+	}
+
 	FLinearColor outColour; 
 	// Dependiendo del equipo que seamos, asignamos un color u otro. 
 
-	if (NewTeam == ETeam::BLUE_TEAM) 
+	if (CurrentTeam == ETeam::BLUE_TEAM) 
 	{ 
 		outColour = FLinearColor(0.0f, 0.0f, 0.5f); 
 	} 
@@ -386,9 +770,9 @@ void ANSCharacter::SetTeam_Implementation(ETeam NewTeam)
 	if (DynamicMat == nullptr)
 	{
 		DynamicMat = UMaterialInstanceDynamic::Create(GetMesh()->GetMaterial(0), this); 
-		DynamicMat->SetVectorParameterValue(TEXT("BodyColor"), outColour); 
 
 		GetMesh()->SetMaterial(0, DynamicMat); 
 		FP_Mesh->SetMaterial(0, DynamicMat);
 	}
+	DynamicMat->SetVectorParameterValue(TEXT("BodyColor"), outColour); 
 }
\ No newline at end of file
@@ -2,6 +2,8 @@
 #pragma once
 #include "GameFramework/Character.h"
 #include "NSGameMode.h"
+#include "NSShotTrace.h"
+#include "NSHitboxes.h"
 #include "NSCharacter.generated.h"
 
 class UInputComponent;
@@ -26,8 +28,14 @@ class ANSCharacter : public ACharacter
 	/** First person camera */
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Camera, meta = (AllowPrivateAccess = "true"))
 	class UCameraComponent* FirstPersonCameraComponent;
+
+	// Firing policies play our effects and send our multicasts
+	template<typename TracePolicy, typename ModePolicy, typename EffectsPolicy> friend struct TNSFirePolicy;
+	template<bool bMultiPellet, bool bPenetrating> friend struct TNSHitscanPolicy;
+	friend struct FNSEffectsPolicy;
+
 public:
-	ANSCharacter();
+	ANSCharacter(const FObjectInitializer& ObjectInitializer);
 
 	virtual void BeginPlay();
 
@@ -75,7 +83,12 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Gameplay) 
 	class UForceFeedbackEffect* HitSuccessFeedback;
 
-	UPROPERTY(Replicated, BlueprintReadWrite, Category = Team)
+	/** Damage, range, pellets and penetration of our shots. Uses UNSWeaponDefinition defaults when empty. Changed on the server with SetWeapon */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, ReplicatedUsing = OnRep_Weapon, Category = Gameplay)
+	class UNSWeaponDefinition* Weapon;
+
+	/** Equipo del personaje. Los clientes actualizan su aspecto en OnRep_CurrentTeam */
+	UPROPERTY(ReplicatedUsing = OnRep_CurrentTeam, BlueprintReadOnly, Category = Team)
 	ETeam CurrentTeam;
 
 protected:
@@ -86,9 +99,33 @@ protected:
 	/** Estado del jugador */
 	class ANSPlayerState* NSPlayerState;
 	
+	/** Specialized firing functions of the current weapon, use GetFireFunctions */
+	const struct FNSFireFunctions* FireFunctions;
+
+	/** Resolves FireFunctions if input or a multicast arrives before BeginPlay */
+	const struct FNSFireFunctions& GetFireFunctions();
+
+	/** Shots left in the current burst or automatic fire */
+	int32 PendingShots;
+
+	FTimerHandle RefireTimer;
+
 	/** Fires a projectile. */
 	void OnFire();
 
+	/** Stops automatic fire */
+	void OnStopFire();
+
+	/** Fires one shot of the current trigger pull and schedules the next one */
+	void FireShot();
+
+	/** Drops the rest of the burst or automatic fire */
+	void StopFiring();
+
+	/** Shows the scoreboard while the key is held */
+	void OnShowScores();
+	void OnHideScores();
+
 	/** Handles moving forward/backward */
 	void MoveForward(float Val);
 
@@ -109,6 +146,18 @@ protected:
 
 	/*Mtodo para el servidor que dibuja el rayo*/
 	void Fire(const FVector pos, const FVector dir);
+
+	/** Applies the damage of a traced shot and notifies the shooter on success. Only aimed hits go to the cheat detector */
+	void ApplyShotDamage(const FNSShotDamageList& Damages, bool bAimed = true);
+
+	/** Trace params of our shots, ignoring ourselves. Built once so firing does not allocate */
+	FCollisionQueryParams ShotQueryParams;
+
+	/** Bone capsules shots are resolved against, server only */
+	FNSHitboxSet Hitboxes;
+
+	/** Frame the pose was last evaluated for a shot, when nobody renders the mesh */
+	uint64 PoseRefreshFrame;
 	
 protected:
 	// APawn interface
@@ -117,8 +166,17 @@ protected:
 	virtual float TakeDamage(float Damage, struct FDamageEvent const& DamageEvent, AController* EventInstigator, AActor* DamageCauser) override; 
 	
 	virtual void PossessedBy(AController* NewController) override;
+
+	virtual void UnPossessed() override;
 	// End of APawn interface
 
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	virtual void PreReplication(IRepChangedPropertyTracker& ChangedPropertyTracker) override;
+
+	/** CurrentTeam sent in the previous net update, to account property traffic */
+	ETeam LastReplicatedTeam;
+
 
 public:
 	/** Returns Mesh1P subobject **/
@@ -135,6 +193,57 @@ public:
 	/*Informar para respawnear*/
 	void Respawn();
 
+	/** Ignora el dao mientras dura la proteccin tras aparecer. Solo en el servidor */
+	bool bSpawnProtected;
+
+	/** Fades the corpse out, 0 is fully visible. Needs a FadeAlpha parameter in the body material */
+	void SetCorpseFade(float Alpha);
+
+	/** Whether the body material has the FadeAlpha parameter */
+	bool CanFadeCorpse() const;
+
+	/** Fires from Origin along Direction through the same ServerFire path a player uses. Used by bots. */
+	void FireAt(const FVector& Origin, const FVector& Direction);
+
+	/** Server: changes the weapon and picks its specialized firing functions. Clients follow in OnRep_Weapon */
+	UFUNCTION(BlueprintCallable, BlueprintAuthorityOnly, Category = Gameplay)
+	void SetWeapon(class UNSWeaponDefinition* NewWeapon);
+
+	FORCEINLINE const FCollisionQueryParams& GetShotQueryParams() const { return ShotQueryParams; }
+
+	/** Server: damage of an explosion of one of our projectiles, with the same stats, kill credit and team score as a shot */
+	void ApplyExplosionDamage(const FNSShotDamageList& Damages) { ApplyShotDamage(Damages, false); }
+
+	/** Hitbox the segment from Start to End goes through first. False when it only crosses the outer capsule */
+	bool ResolveHitZone(const FVector& Start, const FVector& End, ENSHitZone& OutZone, float& OutDistance);
+
+	/** Forces the next shot to evaluate the pose again. Used by ns.Fire.HitboxBench */
+	void InvalidateHitboxes() { Hitboxes.Invalidate(); }
+
+	/** Current weapon, or the UNSWeaponDefinition defaults when none is set */
+	const class UNSWeaponDefinition* GetWeaponDefinition() const;
+
+	/** Server side of one shot, through the generic path. Used as reference by ns.Fire.Bench, which leaves the effects out */
+	void FireGeneric(const FVector& Origin, const FVector& End, bool bSendEffects = true);
+
+	/** Server side of one shot, through the weapon's specialized policy */
+	void FireSpecialized(const FVector& Origin, const FVector& End);
+
+	/** Server side of one validated fire request, through the generic or the specialized path */
+	void ProcessShot(const FVector& pos, const FVector& dir);
+
+	/** Server: plays the shot effects here and sends them to the players that can see or hear them */
+	void SendShootEffects();
+
+	/** Server: turns into a corpse here and on the players close enough to care */
+	void SendRagdoll();
+
+	/** 3rd person animation, sound and particles of one shot */
+	void PlayShotEffects();
+
+	/** Disables the capsule and hands the body to the corpse manager. Without physics a client just hides it */
+	void BecomeCorpse(bool bSimulatePhysics);
+
 private:
 
 	//FUNCIONES RPC
@@ -155,11 +264,22 @@ private:
 	UFUNCTION(Client, Reliable) 
 	void PlayPain();
 
+	/** Aplica el color del equipo actual al material del personaje */
+	void ApplyTeamAppearance();
+
+	/** Moves the capsule and the mesh to the object channel of the current team, so enemy shots find them and friendly ones do not */
+	void ApplyTeamCollision();
+
+	UFUNCTION()
+	void OnRep_CurrentTeam();
+
+	UFUNCTION()
+	void OnRep_Weapon();
+
 public:
 
-	/** Mtodo para modificar a todos los clientes de 
-	que pertenecen a un equipo concreto */
-	UFUNCTION(NetMultiCast, Reliable) 
+	/** Mtodo para asignar el equipo en el servidor. Se replica a 
+	todos los clientes mediante CurrentTeam */
 	void SetTeam(ETeam NewTeam);
 };
 
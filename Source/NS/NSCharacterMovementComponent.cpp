@@ -0,0 +1,136 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "NS.h"
+#include "NSCharacterMovementComponent.h"
+#include "NSNetStats.h"
+#include "NSPerfTracker.h"
+
+DECLARE_CYCLE_STAT(TEXT("Server Move"), STAT_NSServerMove, STATGROUP_NS);
+
+static TAutoConsoleVariable<int32> CVarMoveCompact(
+	TEXT("ns.Move.Compact"),
+	1,
+	TEXT("1 caps the server moves an owning client sends per second and quantizes its input so identical frames combine. 0 sends a move per frame, as stock."));
+
+/** Estimated payload of ServerMove: time stamp, acceleration, location, flags, roll, packed view, base and movement mode */
+static const int32 ServerMoveBytes = FNSNetStats::RPCHeaderBytes + 27;
+
+/** ServerMoveDual adds the time stamp, acceleration, flags and view of the pending move */
+static const int32 ServerMoveDualBytes = ServerMoveBytes + 15;
+
+/** Server moves received since ns.Move.Report started, game thread only */
+static uint64 MoveRPCs = 0;
+static uint64 MoveDualRPCs = 0;
+static uint64 MoveBytes = 0;
+static uint64 MoveCycles = 0;
+static double MoveReportStart = 0.0;
+
+/** Components that sent moves, only compared, never dereferenced */
+static TSet<const UNSCharacterMovementComponent*> MoveSenders;
+
+UNSCharacterMovementComponent::UNSCharacterMovementComponent()
+{
+	MaxMoveSendRate = 60.0f;
+	InputMagnitudeSteps = 8;
+	InputHeadingSteps = 256;
+	bInDualMove = false;
+}
+
+bool UNSCharacterMovementComponent::IsCompact()
+{
+	return CVarMoveCompact.GetValueOnGameThread() != 0;
+}
+
+FVector UNSCharacterMovementComponent::ScaleInputAcceleration(const FVector& InputPulse) const
+{
+	if (!IsCompact())
+	{
+		return Super::ScaleInputAcceleration(InputPulse);
+	}
+
+	const FVector Input = InputPulse.GetClampedToMaxSize(1.0f);
+	const float Magnitude = FMath::RoundToFloat(Input.Size2D() * InputMagnitudeSteps) / InputMagnitudeSteps;
+	if (Magnitude <= 0.0f)
+	{
+		return Super::ScaleInputAcceleration(FVector(0.0f, 0.0f, Input.Z));
+	}
+
+	const float HeadingStep = 2.0f * PI / InputHeadingSteps;
+	const float Heading = FMath::RoundToFloat(FMath::Atan2(Input.Y, Input.X) / HeadingStep) * HeadingStep;
+
+	float Sin, Cos;
+	FMath::SinCos(&Sin, &Cos, Heading);
+	return Super::ScaleInputAcceleration(FVector(Cos * Magnitude, Sin * Magnitude, Input.Z));
+}
+
+float UNSCharacterMovementComponent::GetClientNetSendDeltaTime(const APlayerController* PC, const FNetworkPredictionData_Client_Character* ClientData, const FSavedMovePtr& NewMove) const
+{
+	const float DeltaTime = Super::GetClientNetSendDeltaTime(PC, ClientData, NewMove);
+	return IsCompact() ? FMath::Max(DeltaTime, 1.0f / MaxMoveSendRate) : DeltaTime;
+}
+
+void UNSCharacterMovementComponent::ServerMove_Implementation(float TimeStamp, FVector_NetQuantize10 InAccel, FVector_NetQuantize100 ClientLoc, uint8 CompressedMoveFlags, uint8 ClientRoll, uint32 View, UPrimitiveComponent* ClientMovementBase, FName ClientBaseBoneName, uint8 ClientMovementMode)
+{
+	if (bInDualMove)
+	{
+		Super::ServerMove_Implementation(TimeStamp, InAccel, ClientLoc, CompressedMoveFlags, ClientRoll, View, ClientMovementBase, ClientBaseBoneName, ClientMovementMode);
+		return;
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_NSServerMove);
+	const uint32 StartCycles = FPlatformTime::Cycles();
+
+	Super::ServerMove_Implementation(TimeStamp, InAccel, ClientLoc, CompressedMoveFlags, ClientRoll, View, ClientMovementBase, ClientBaseBoneName, ClientMovementMode);
+
+	MoveCycles += FPlatformTime::Cycles() - StartCycles;
+	MoveSenders.Add(this);
+	MoveRPCs++;
+	MoveBytes += ServerMoveBytes;
+	FNSNetStats::Record(ENSNetEvent::ServerMove, CharacterOwner != nullptr ? CharacterOwner->GetNetConnection() : nullptr, ServerMoveBytes);
+}
+
+void UNSCharacterMovementComponent::ServerMoveDual_Implementation(float TimeStamp0, FVector_NetQuantize10 InAccel0, uint8 PendingFlags, uint32 View0, float TimeStamp, FVector_NetQuantize10 InAccel, FVector_NetQuantize100 ClientLoc, uint8 NewFlags, uint8 ClientRoll, uint32 View, UPrimitiveComponent* ClientMovementBase, FName ClientBaseBoneName, uint8 ClientMovementMode)
+{
+	SCOPE_CYCLE_COUNTER(STAT_NSServerMove);
+	const uint32 StartCycles = FPlatformTime::Cycles();
+
+	bInDualMove = true;
+	Super::ServerMoveDual_Implementation(TimeStamp0, InAccel0, PendingFlags, View0, TimeStamp, InAccel, ClientLoc, NewFlags, ClientRoll, View, ClientMovementBase, ClientBaseBoneName, ClientMovementMode);
+	bInDualMove = false;
+
+	MoveCycles += FPlatformTime::Cycles() - StartCycles;
+	MoveSenders.Add(this);
+	MoveDualRPCs++;
+	MoveBytes += ServerMoveDualBytes;
+	FNSNetStats::Record(ENSNetEvent::ServerMoveDual, CharacterOwner != nullptr ? CharacterOwner->GetNetConnection() : nullptr, ServerMoveDualBytes);
+}
+
+static FAutoConsoleCommand MoveReportCommand(
+	TEXT("ns.Move.Report"),
+	TEXT("On the server, counts the client moves received for the given seconds and logs moves, RPCs and estimated bytes per second and the processing time per RPC. Fails if a client sent more RPCs per second than MaxRate, by default 10% over MaxMoveSendRate, 0 to only report: ns.Move.Report <Seconds> <MaxRate>. Run the clients with t.MaxFPS 240 and compare ns.Move.Compact 0 and 1."),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		const float Seconds = Args.Num() > 0 ? FMath::Max(FCString::Atof(*Args[0]), 1.0f) : 10.0f;
+		const float MaxRate = Args.Num() > 1 ? FCString::Atof(*Args[1]) : GetDefault<UNSCharacterMovementComponent>()->MaxMoveSendRate * 1.1f;
+
+		MoveRPCs = MoveDualRPCs = MoveBytes = MoveCycles = 0;
+		MoveSenders.Reset();
+		MoveReportStart = FPlatformTime::Seconds();
+
+		FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([MaxRate](float DeltaTime)
+		{
+			const double Elapsed = FPlatformTime::Seconds() - MoveReportStart;
+			const uint64 RPCs = MoveRPCs + MoveDualRPCs;
+
+			UE_LOG(LogNS, Log, TEXT("ns.Move.Report: %.1f moves/s in %.1f RPCs/s (%.1f dual), %.0f bytes/s estimated, %.2f us per RPC on the server"),
+				(MoveRPCs + 2 * MoveDualRPCs) / Elapsed, RPCs / Elapsed, MoveDualRPCs / Elapsed, MoveBytes / Elapsed,
+				RPCs > 0 ? MoveCycles * FPlatformTime::GetSecondsPerCycle() * 1e6 / RPCs : 0.0);
+
+			// Averaged over the clients that moved, a dual move is one RPC
+			const double ClientRate = MoveSenders.Num() > 0 ? RPCs / Elapsed / MoveSenders.Num() : 0.0;
+			FNSPerfTracker::Expect(MaxRate <= 0.0f || ClientRate <= MaxRate, TEXT("ns.Move.Report"),
+				FString::Printf(TEXT("%.1f RPCs/s per client over %d clients, at most %.1f expected"), ClientRate, MoveSenders.Num(), MaxRate));
+			MoveSenders.Reset();
+			return false;
+		}), Seconds);
+	}));
@@ -0,0 +1,54 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "GameFramework/CharacterMovementComponent.h"
+#include "NSCharacterMovementComponent.generated.h"
+
+/**
+ * Character movement with a compact client to server move stream.
+ *
+ * The stock component sends a server move per client frame, which at high
+ * frame rates is most of the upstream traffic. In compact mode (ns.Move.Compact)
+ * the owning client:
+ *  - caps its move send rate at MaxMoveSendRate, independently of frame rate;
+ *    the frames in between are combined into the pending saved move,
+ *  - quantizes its input acceleration to InputMagnitudeSteps magnitudes and
+ *    InputHeadingSteps headings, so consecutive frames of the same input give
+ *    identical saved moves that can always be combined.
+ * The server side only accounts the moves received, see ns.Move.Report.
+ */
+UCLASS()
+class UNSCharacterMovementComponent : public UCharacterMovementComponent
+{
+	GENERATED_BODY()
+
+public:
+	UNSCharacterMovementComponent();
+
+	/** Most server moves per second the owning client sends in compact mode */
+	UPROPERTY(EditDefaultsOnly, Category = "Network", meta = (ClampMin = "5", ClampMax = "120"))
+	float MaxMoveSendRate;
+
+	/** Input magnitudes between 0 and 1 a compact move may carry */
+	UPROPERTY(EditDefaultsOnly, Category = "Network", meta = (ClampMin = "1"))
+	int32 InputMagnitudeSteps;
+
+	/** Input directions around the circle a compact move may carry */
+	UPROPERTY(EditDefaultsOnly, Category = "Network", meta = (ClampMin = "8"))
+	int32 InputHeadingSteps;
+
+	/** Whether the compact move stream is on, read by the owning client */
+	static bool IsCompact();
+
+	virtual void ServerMove_Implementation(float TimeStamp, FVector_NetQuantize10 InAccel, FVector_NetQuantize100 ClientLoc, uint8 CompressedMoveFlags, uint8 ClientRoll, uint32 View, UPrimitiveComponent* ClientMovementBase, FName ClientBaseBoneName, uint8 ClientMovementMode) override;
+	virtual void ServerMoveDual_Implementation(float TimeStamp0, FVector_NetQuantize10 InAccel0, uint8 PendingFlags, uint32 View0, float TimeStamp, FVector_NetQuantize10 InAccel, FVector_NetQuantize100 ClientLoc, uint8 NewFlags, uint8 ClientRoll, uint32 View, UPrimitiveComponent* ClientMovementBase, FName ClientBaseBoneName, uint8 ClientMovementMode) override;
+
+protected:
+	virtual FVector ScaleInputAcceleration(const FVector& InputPulse) const override;
+	virtual float GetClientNetSendDeltaTime(const APlayerController* PC, const FNetworkPredictionData_Client_Character* ClientData, const FSavedMovePtr& NewMove) const override;
+
+private:
+	/** Set while a dual move replays its two moves, so they are accounted once */
+	bool bInDualMove;
+};
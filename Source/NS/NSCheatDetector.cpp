@@ -0,0 +1,508 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "NS.h"
+#include "NSCheatDetector.h"
+#include "NSPerfTracker.h"
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Cheat Events Dropped"), STAT_NSCheatDropped, STATGROUP_NS);
+
+/** Queue sizes, rounded up to a power of two by the queue */
+static const uint32 CheatEventCapacity = 8192;
+static const uint32 CheatFlagCapacity = 256;
+
+/** Aim speed, in degrees per second, past which a turn is considered started */
+static const float TurnStartDegreesPerSecond = 45.0f;
+
+/** Flicks remembered per player */
+static const int32 ReactionWindow = 16;
+
+/** Seconds before the same flag is raised again for a player */
+static const float FlagCooldown = 10.0f;
+
+static const float SpeedViolationWindow = 5.0f;
+
+FNSCheatSettings::FNSCheatSettings()
+	: SnapDegrees(45.0f)
+	, MinReactionSeconds(0.1f)
+	, MaxInhumanSnaps(5)
+	, MaxHitRatio(0.85f)
+	, MinShots(40)
+	, SpeedTolerance(1.5f)
+	, MaxSpeedViolations(3)
+{
+}
+
+/** Everything the worker remembers about one player, fixed size */
+struct FNSCheatModel
+{
+	bool bHasView;
+	float ViewTime;
+	FVector ViewLocation;
+	FVector ViewAim;
+	float ViewMaxSpeed;
+
+	/** Aim and time when the current turn started, if turning */
+	bool bTurning;
+	float TurnTime;
+	FVector TurnAim;
+
+	/** Flick of the last shot, scored once we know whether it hit */
+	float ShotTime;
+	float ShotSnapDegrees;
+	float ShotReaction;
+	bool bShotHit;
+
+	/** One bit per shot, newest in bit 0 */
+	uint64 HitBits;
+	int32 NumShots;
+
+	/** Whether each of the last flicks was inhuman, newest in bit 0 */
+	uint32 SnapBits;
+	int32 NumSnaps;
+
+	int32 SpeedViolations;
+	float SpeedWindowStart;
+
+	float LastFlagTime[(int32)ENSCheatFlag::Count];
+
+	FNSCheatModel()
+	{
+		FMemory::Memzero(*this);
+		for (float& Time : LastFlagTime)
+		{
+			Time = -FlagCooldown;
+		}
+	}
+};
+
+static float AngleDegrees(const FVector& A, const FVector& B)
+{
+	return FMath::RadiansToDegrees(FMath::Acos(FMath::Clamp(FVector::DotProduct(A, B), -1.0f, 1.0f)));
+}
+
+class FNSCheatWorker : public FRunnable
+{
+public:
+	explicit FNSCheatWorker(FNSCheatDetector& InDetector)
+		: Detector(InDetector)
+		, bStopping(false)
+	{
+	}
+
+	virtual uint32 Run() override
+	{
+		while (!bStopping)
+		{
+			FNSCheatDetector::FEvent Event;
+			int64 Processed = 0;
+			while (Detector.Events.Dequeue(Event))
+			{
+				Process(Event);
+				++Processed;
+			}
+
+			if (Processed > 0)
+			{
+				FPlatformAtomics::InterlockedAdd(&Detector.ProcessedEvents, Processed);
+			}
+			else
+			{
+				FPlatformProcess::Sleep(0.002f);
+			}
+		}
+		return 0;
+	}
+
+	virtual void Stop() override
+	{
+		bStopping = true;
+	}
+
+private:
+	void Process(const FNSCheatDetector::FEvent& Event)
+	{
+		switch (Event.Type)
+		{
+		case FNSCheatDetector::EEventType::View:
+			OnView(Models.FindOrAdd(Event.PlayerId), Event);
+			break;
+
+		case FNSCheatDetector::EEventType::Shot:
+			OnShot(Models.FindOrAdd(Event.PlayerId), Event);
+			break;
+
+		case FNSCheatDetector::EEventType::Hit:
+			OnHit(Models.FindOrAdd(Event.PlayerId), Event);
+			break;
+
+		case FNSCheatDetector::EEventType::Reset:
+			if (FNSCheatModel* Model = Models.Find(Event.PlayerId))
+			{
+				Model->bHasView = false;
+				Model->bTurning = false;
+			}
+			break;
+
+		case FNSCheatDetector::EEventType::Remove:
+			Models.Remove(Event.PlayerId);
+			break;
+		}
+	}
+
+	void OnView(FNSCheatModel& Model, const FNSCheatDetector::FEvent& Event)
+	{
+		const FNSCheatSettings& Settings = Detector.Settings;
+
+		if (Model.bHasView && Event.Time > Model.ViewTime)
+		{
+			const float DeltaTime = Event.Time - Model.ViewTime;
+
+			// Falling has no limit, a sample taken in the air on either end is not checked
+			const float MaxSpeed = FMath::Min(Event.MaxSpeed, Model.ViewMaxSpeed) * Settings.SpeedTolerance;
+			const float Speed = FVector::Dist(Event.Location, Model.ViewLocation) / DeltaTime;
+			if (MaxSpeed > 0.0f && Speed > MaxSpeed)
+			{
+				if (Event.Time - Model.SpeedWindowStart > SpeedViolationWindow)
+				{
+					Model.SpeedWindowStart = Event.Time;
+					Model.SpeedViolations = 0;
+				}
+				if (++Model.SpeedViolations >= Settings.MaxSpeedViolations)
+				{
+					Raise(Model, Event.PlayerId, Event.Time, ENSCheatFlag::Speed, Speed);
+					Model.SpeedViolations = 0;
+				}
+			}
+
+			// A turn starts on the last sample before the aim speeds up and lasts while it keeps moving
+			const bool bMoving = AngleDegrees(Event.Direction, Model.ViewAim) / DeltaTime > TurnStartDegreesPerSecond;
+			if (bMoving && !Model.bTurning)
+			{
+				Model.bTurning = true;
+				Model.TurnTime = Model.ViewTime;
+				Model.TurnAim = Model.ViewAim;
+			}
+			else if (!bMoving)
+			{
+				Model.bTurning = false;
+			}
+		}
+
+		Model.bHasView = true;
+		Model.ViewTime = Event.Time;
+		Model.ViewLocation = Event.Location;
+		Model.ViewAim = Event.Direction;
+		Model.ViewMaxSpeed = Event.MaxSpeed;
+	}
+
+	void OnShot(FNSCheatModel& Model, const FNSCheatDetector::FEvent& Event)
+	{
+		ScoreLastShot(Model, Event.PlayerId);
+
+		// Without a turn in progress the whole flick happened since the last view sample
+		const FVector StartAim = Model.bTurning ? Model.TurnAim : Model.ViewAim;
+		const float StartTime = Model.bTurning ? Model.TurnTime : Model.ViewTime;
+
+		Model.ShotTime = Event.Time;
+		Model.ShotSnapDegrees = Model.bHasView ? AngleDegrees(StartAim, Event.Direction) : 0.0f;
+		Model.ShotReaction = Event.Time - StartTime;
+		Model.bShotHit = false;
+
+		Model.HitBits <<= 1;
+		Model.NumShots = FMath::Min(Model.NumShots + 1, 64);
+	}
+
+	void OnHit(FNSCheatModel& Model, const FNSCheatDetector::FEvent& Event)
+	{
+		// Pellets of one shot hit several victims at once, the shot counts as one hit
+		if (Model.NumShots > 0 && Event.Time == Model.ShotTime && !Model.bShotHit)
+		{
+			Model.bShotHit = true;
+			Model.HitBits |= 1;
+			ScoreLastShot(Model, Event.PlayerId);
+
+			const FNSCheatSettings& Settings = Detector.Settings;
+			const float HitRatio = (float)FMath::CountBits(Model.HitBits) / Model.NumShots;
+			if (Model.NumShots >= Settings.MinShots && HitRatio > Settings.MaxHitRatio)
+			{
+				Raise(Model, Event.PlayerId, Event.Time, ENSCheatFlag::HitRatio, HitRatio);
+			}
+		}
+	}
+
+	/** Adds the flick of the last shot to the window once, when it hit */
+	void ScoreLastShot(FNSCheatModel& Model, int32 PlayerId)
+	{
+		const FNSCheatSettings& Settings = Detector.Settings;
+		if (!Model.bShotHit || Model.ShotSnapDegrees < Settings.SnapDegrees)
+		{
+			return;
+		}
+
+		// Scored, do not count it again
+		Model.ShotSnapDegrees = 0.0f;
+
+		Model.SnapBits = (Model.SnapBits << 1) | (Model.ShotReaction < Settings.MinReactionSeconds ? 1 : 0);
+		Model.SnapBits &= (1u << ReactionWindow) - 1;
+		Model.NumSnaps = FMath::Min(Model.NumSnaps + 1, ReactionWindow);
+
+		const int32 Inhuman = FMath::CountBits(Model.SnapBits);
+		if (Inhuman >= Settings.MaxInhumanSnaps)
+		{
+			Raise(Model, PlayerId, Model.ShotTime, ENSCheatFlag::SnapAim, (float)Inhuman);
+		}
+	}
+
+	void Raise(FNSCheatModel& Model, int32 PlayerId, float Time, ENSCheatFlag Type, float Value)
+	{
+		float& LastTime = Model.LastFlagTime[(int32)Type];
+		if (Time - LastTime < FlagCooldown)
+		{
+			return;
+		}
+		LastTime = Time;
+
+		// The game mode will miss it if it stopped draining, nothing to wait for
+		Detector.Flags.Enqueue({ PlayerId, Type, Value });
+	}
+
+	FNSCheatDetector& Detector;
+	TMap<int32, FNSCheatModel> Models;
+	volatile bool bStopping;
+};
+
+FNSCheatDetector::FNSCheatDetector()
+	: Events(CheatEventCapacity)
+	, Flags(CheatFlagCapacity)
+	, Worker(nullptr)
+	, Thread(nullptr)
+	, QueuedEvents(0)
+	, DroppedEvents(0)
+	, ProcessedEvents(0)
+{
+}
+
+FNSCheatDetector::~FNSCheatDetector()
+{
+	Stop();
+}
+
+void FNSCheatDetector::Start()
+{
+	if (Thread == nullptr)
+	{
+		Worker = new FNSCheatWorker(*this);
+		Thread = FRunnableThread::Create(Worker, TEXT("NSCheatDetector"), 0, TPri_BelowNormal);
+	}
+}
+
+void FNSCheatDetector::Stop()
+{
+	if (Thread != nullptr)
+	{
+		Thread->Kill(true);
+		delete Thread;
+		delete Worker;
+		Thread = nullptr;
+		Worker = nullptr;
+	}
+}
+
+void FNSCheatDetector::Push(const FEvent& Event)
+{
+	if (Thread == nullptr)
+	{
+		return;
+	}
+
+	if (Events.Enqueue(Event))
+	{
+		++QueuedEvents;
+	}
+	else
+	{
+		++DroppedEvents;
+		INC_DWORD_STAT(STAT_NSCheatDropped);
+	}
+}
+
+void FNSCheatDetector::AddView(int32 PlayerId, float Time, const FVector& Location, const FVector& Aim, float MaxSpeed)
+{
+	Push({ EEventType::View, PlayerId, 0, Time, Location, Aim, MaxSpeed });
+}
+
+void FNSCheatDetector::AddShot(int32 PlayerId, float Time, const FVector& Origin, const FVector& Direction)
+{
+	Push({ EEventType::Shot, PlayerId, 0, Time, Origin, Direction });
+}
+
+void FNSCheatDetector::AddHit(int32 PlayerId, int32 VictimId, float Time)
+{
+	Push({ EEventType::Hit, PlayerId, VictimId, Time, FVector::ZeroVector, FVector::ZeroVector });
+}
+
+void FNSCheatDetector::ResetPlayer(int32 PlayerId)
+{
+	Push({ EEventType::Reset, PlayerId, 0, 0.0f, FVector::ZeroVector, FVector::ZeroVector });
+}
+
+void FNSCheatDetector::RemovePlayer(int32 PlayerId)
+{
+	Push({ EEventType::Remove, PlayerId, 0, 0.0f, FVector::ZeroVector, FVector::ZeroVector });
+}
+
+void FNSCheatDetector::Flush()
+{
+	while (Thread != nullptr && (uint64)ProcessedEvents < QueuedEvents)
+	{
+		FPlatformProcess::Sleep(0.0f);
+	}
+}
+
+/** Feeds 60 s of a human-like player and of a cheater at 30 view samples per second */
+static void FeedSyntheticPlayers(FNSCheatDetector& Detector, int32 HumanId, int32 CheaterId)
+{
+	const float SampleTime = 1.0f / 30.0f;
+	FRandomStream Random(4321);
+
+	FVector HumanLocation = FVector::ZeroVector;
+	float HumanYaw = 0.0f;
+	float HumanTurnLeft = 0.0f;
+
+	FVector CheaterLocation(0.0f, 5000.0f, 0.0f);
+	float CheaterYaw = 0.0f;
+
+	for (int32 Sample = 0; Sample < 30 * 60; ++Sample)
+	{
+		const float Time = Sample * SampleTime;
+
+		// Human: walks at 500 cm/s, turns 90 degrees in half a second every two seconds and taps
+		// a few shots in between, a bit under half of them hitting
+		HumanLocation.X += 500.0f * SampleTime;
+		if (Sample % 60 == 0)
+		{
+			HumanTurnLeft = 90.0f;
+		}
+		if (HumanTurnLeft > 0.0f)
+		{
+			const float Step = FMath::Min(HumanTurnLeft, 180.0f * SampleTime);
+			HumanYaw += Step;
+			HumanTurnLeft -= Step;
+		}
+		Detector.AddView(HumanId, Time, HumanLocation, FRotator(0.0f, HumanYaw, 0.0f).Vector(), 600.0f);
+
+		if (Sample % 6 == 5)
+		{
+			const float ShotTime = Time + 0.01f;
+			Detector.AddShot(HumanId, ShotTime, HumanLocation, FRotator(0.0f, HumanYaw + Random.FRandRange(-2.0f, 2.0f), 0.0f).Vector());
+			if (Random.FRand() < 0.45f)
+			{
+				Detector.AddHit(HumanId, CheaterId, ShotTime);
+			}
+		}
+
+		// Cheater: holds still, snaps 120 degrees and hits within 10 ms twice a second, and jumps
+		// 200 cm in a single sample every second
+		CheaterLocation.X += (Sample % 30 == 15 ? 200.0f : 500.0f * SampleTime);
+		Detector.AddView(CheaterId, Time, CheaterLocation, FRotator(0.0f, CheaterYaw, 0.0f).Vector(), 600.0f);
+
+		if (Sample % 15 == 0)
+		{
+			const float ShotTime = Time + 0.01f;
+			CheaterYaw += 120.0f;
+			Detector.AddShot(CheaterId, ShotTime, CheaterLocation, FRotator(0.0f, CheaterYaw, 0.0f).Vector());
+			Detector.AddHit(CheaterId, HumanId, ShotTime);
+		}
+	}
+}
+
+static FAutoConsoleCommand CheatSyntheticCommand(
+	TEXT("ns.Cheat.Synthetic"),
+	TEXT("Runs a detector over a synthetic human and a synthetic cheater and fails unless only the cheater is flagged, for snap aim, hit ratio and speed"),
+	FConsoleCommandDelegate::CreateLambda([]()
+	{
+		const int32 HumanId = 1;
+		const int32 CheaterId = 2;
+
+		TUniquePtr<FNSCheatDetector> Detector = MakeUnique<FNSCheatDetector>();
+		Detector->Start();
+		FeedSyntheticPlayers(*Detector, HumanId, CheaterId);
+		Detector->Flush();
+
+		int32 HumanFlags = 0;
+		bool CheaterFlags[(int32)ENSCheatFlag::Count] = {};
+		Detector->ConsumeFlags([&](const FNSCheatFlag& Flag)
+		{
+			if (Flag.PlayerId == HumanId)
+			{
+				++HumanFlags;
+			}
+			else
+			{
+				CheaterFlags[(int32)Flag.Type] = true;
+			}
+		});
+
+		const uint64 Dropped = Detector->GetDroppedEvents();
+		Detector->Stop();
+
+		const bool bPassed = HumanFlags == 0 && Dropped == 0
+			&& CheaterFlags[(int32)ENSCheatFlag::SnapAim] && CheaterFlags[(int32)ENSCheatFlag::HitRatio] && CheaterFlags[(int32)ENSCheatFlag::Speed];
+
+		if (FNSPerfTracker::Expect(bPassed, TEXT("ns.Cheat.Synthetic"),
+			FString::Printf(TEXT("human flags %d, cheater snap %d hit ratio %d speed %d, dropped events %llu"),
+				HumanFlags, CheaterFlags[(int32)ENSCheatFlag::SnapAim], CheaterFlags[(int32)ENSCheatFlag::HitRatio], CheaterFlags[(int32)ENSCheatFlag::Speed], Dropped)))
+		{
+			UE_LOG(LogNS, Log, TEXT("ns.Cheat.Synthetic passed"));
+		}
+	}));
+
+static FAutoConsoleCommand CheatBenchCommand(
+	TEXT("ns.Cheat.Bench"),
+	TEXT("Pushes N view, shot and hit events (default 1000000) of 64 players through a detector and logs the game thread cost per event and the events per second the worker keeps up with: ns.Cheat.Bench <N>"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		const int32 NumEvents = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 1000000;
+		const int32 Batch = (int32)CheatEventCapacity / 2;
+		FRandomStream Random(1234);
+
+		TUniquePtr<FNSCheatDetector> Detector = MakeUnique<FNSCheatDetector>();
+		Detector->Start();
+
+		double ProducerSeconds = 0.0;
+		const double StartTime = FPlatformTime::Seconds();
+		for (int32 Pushed = 0; Pushed < NumEvents; )
+		{
+			// Half the queue at a time so the producer never laps the worker and the count is exact
+			const int32 Count = FMath::Min(Batch, NumEvents - Pushed);
+			const double BatchStart = FPlatformTime::Seconds();
+			for (int32 i = 0; i < Count; ++i, ++Pushed)
+			{
+				const int32 PlayerId = Pushed % 64;
+				const float Time = (Pushed / 64) / 30.0f;
+				switch (Pushed % 8)
+				{
+				case 0:
+					Detector->AddShot(PlayerId, Time, FVector::ZeroVector, Random.GetUnitVector());
+					break;
+				case 1:
+					Detector->AddHit(PlayerId, (PlayerId + 1) % 64, Time);
+					break;
+				default:
+					Detector->AddView(PlayerId, Time, Random.GetUnitVector() * Random.FRandRange(0.0f, 100.0f), Random.GetUnitVector(), 600.0f);
+					break;
+				}
+			}
+			ProducerSeconds += FPlatformTime::Seconds() - BatchStart;
+			Detector->Flush();
+		}
+		const double TotalSeconds = FPlatformTime::Seconds() - StartTime;
+		const uint64 Dropped = Detector->GetDroppedEvents();
+		Detector->Stop();
+
+		UE_LOG(LogNS, Log, TEXT("ns.Cheat.Bench: %d events, %.1f ns per event on the game thread, %.2f M events/s through the worker, %llu dropped"),
+			NumEvents, ProducerSeconds * 1e9 / NumEvents, NumEvents / TotalSeconds / 1e6, Dropped);
+
+		// Batches of half the queue never overflow it, a drop means the queue lost events
+		FNSPerfTracker::Expect(Dropped == 0, TEXT("ns.Cheat.Bench"), FString::Printf(TEXT("%llu of %d events dropped"), Dropped, NumEvents));
+	}));
@@ -0,0 +1,144 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "Containers/CircularQueue.h"
+
+/** Limits past which a player is flagged */
+struct FNSCheatSettings
+{
+	/** Aim changes, in degrees, counted as a flick */
+	float SnapDegrees;
+
+	/** Flicks that hit faster than this, in seconds, count as inhuman */
+	float MinReactionSeconds;
+
+	/** Inhuman flicks among the last ReactionWindow flicks that raise a flag */
+	int32 MaxInhumanSnaps;
+
+	/** Hit ratio over the last 64 shots that raises a flag, once MinShots were fired */
+	float MaxHitRatio;
+	int32 MinShots;
+
+	/**
+	 * Speed allowed over the movement component's limit, as a multiplier, and violations
+	 * within 5 s that raise a flag. The margin covers net corrections and uneven sampling
+	 */
+	float SpeedTolerance;
+	int32 MaxSpeedViolations;
+
+	FNSCheatSettings();
+};
+
+enum class ENSCheatFlag : uint8
+{
+	SnapAim,
+	HitRatio,
+	Speed,
+	Count
+};
+
+struct FNSCheatFlag
+{
+	int32 PlayerId;
+	ENSCheatFlag Type;
+
+	/** Inhuman flicks, hit ratio or speed in cm/s, depending on Type */
+	float Value;
+};
+
+/**
+ * Aim and movement anomaly detection for human players.
+ *
+ * The game thread only copies validated shots, hits and view samples into
+ * a bounded lock-free queue; a worker thread keeps a fixed-size model per
+ * player (last view sample, start of the current turn, hit bits of the last
+ * 64 shots, last flicks) and raises flags into a second queue the game mode
+ * drains on its tick. Events are dropped, and counted, when the worker falls
+ * behind rather than ever blocking the game.
+ */
+class FNSCheatDetector
+{
+public:
+	FNSCheatDetector();
+	~FNSCheatDetector();
+
+	/** Read by the worker, only change while it is stopped */
+	FNSCheatSettings Settings;
+
+	void Start();
+	void Stop();
+	bool IsRunning() const { return Thread != nullptr; }
+
+	/**
+	 * Producer side, game thread only. Aim and Direction are unit vectors. MaxSpeed is the
+	 * movement component's limit in the current mode, 0 when there is none, as when falling
+	 */
+	void AddView(int32 PlayerId, float Time, const FVector& Location, const FVector& Aim, float MaxSpeed);
+	void AddShot(int32 PlayerId, float Time, const FVector& Origin, const FVector& Direction);
+	void AddHit(int32 PlayerId, int32 VictimId, float Time);
+
+	/** Forgets the movement history, after a teleport made by the server */
+	void ResetPlayer(int32 PlayerId);
+
+	void RemovePlayer(int32 PlayerId);
+
+	/** Hands every flag raised since the last call to Func, game thread only */
+	template<typename FuncType>
+	void ConsumeFlags(FuncType Func)
+	{
+		FNSCheatFlag Flag;
+		while (Flags.Dequeue(Flag))
+		{
+			Func(Flag);
+		}
+	}
+
+	/** Waits until the worker has processed every event queued so far. For tests and benchmarks */
+	void Flush();
+
+	uint64 GetQueuedEvents() const { return QueuedEvents; }
+	uint64 GetDroppedEvents() const { return DroppedEvents; }
+
+	enum class EEventType : uint8
+	{
+		View,
+		Shot,
+		Hit,
+		Reset,
+		Remove
+	};
+
+	struct FEvent
+	{
+		EEventType Type;
+		int32 PlayerId;
+		int32 OtherId;
+		float Time;
+		FVector Location;
+		FVector Direction;
+
+		/** Views only */
+		float MaxSpeed;
+	};
+
+private:
+	friend class FNSCheatWorker;
+
+	void Push(const FEvent& Event);
+
+	/** Game thread to worker */
+	TCircularQueue<FEvent> Events;
+
+	/** Worker to game thread */
+	TCircularQueue<FNSCheatFlag> Flags;
+
+	class FNSCheatWorker* Worker;
+	class FRunnableThread* Thread;
+
+	uint64 QueuedEvents;
+	uint64 DroppedEvents;
+
+	/** Written by the worker */
+	volatile int64 ProcessedEvents;
+};
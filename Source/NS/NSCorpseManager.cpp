@@ -0,0 +1,192 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "NS.h"
+#include "NSCorpseManager.h"
+#include "NSCharacter.h"
+
+DECLARE_CYCLE_STAT(TEXT("Corpse Manager"), STAT_NSCorpseManager, STATGROUP_NS);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Simulating Ragdolls"), STAT_NSSimulatingRagdolls, STATGROUP_NS);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Corpses"), STAT_NSCorpses, STATGROUP_NS);
+
+FNSCorpseManager::FNSCorpseManager()
+{
+	Settings.MaxRagdolls = 8;
+	Settings.MaxCorpses = 32;
+	Settings.LifeSpan = 20.0f;
+	Settings.FadeTime = 2.0f;
+	Settings.CullDistance = 5000.0f;
+	Settings.SettleSpeed = 5.0f;
+	Settings.SettleTime = 1.0f;
+}
+
+void FNSCorpseManager::AddCorpse(ANSCharacter* Character)
+{
+	if (Character == nullptr)
+	{
+		return;
+	}
+
+	// A corpse should not block movement, spawn points or shots
+	Character->GetCapsuleComponent()->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+
+	FCorpse& Corpse = Corpses[Corpses.AddUninitialized()];
+	Corpse.Character = Character;
+	Corpse.Age = 0.0f;
+	Corpse.StillTime = 0.0f;
+	Corpse.State = Character->GetMesh()->IsSimulatingPhysics() ? ECorpseState::Simulating : ECorpseState::Frozen;
+	Corpse.bCanFade = Character->CanFadeCorpse();
+
+	static bool bWarnedNoFade = false;
+	if (!Corpse.bCanFade && !bWarnedNoFade)
+	{
+		UE_LOG(LogNS, Warning, TEXT("The body material of %s has no FadeAlpha parameter, corpses disappear without fading"), *Character->GetClass()->GetName());
+		bWarnedNoFade = true;
+	}
+}
+
+int32 FNSCorpseManager::NumSimulating() const
+{
+	int32 Count = 0;
+	for (const FCorpse& Corpse : Corpses)
+	{
+		if (Corpse.State == ECorpseState::Simulating)
+		{
+			Count++;
+		}
+	}
+	return Count;
+}
+
+void FNSCorpseManager::Freeze(FCorpse& Corpse)
+{
+	USkeletalMeshComponent* Mesh = Corpse.Character->GetMesh();
+
+	// Without ticking the mesh keeps the last simulated pose instead of blending back to the animation
+	Mesh->SetSimulatePhysics(false);
+	Mesh->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	Mesh->SetComponentTickEnabled(false);
+
+	Corpse.State = ECorpseState::Frozen;
+}
+
+void FNSCorpseManager::Hide(FCorpse& Corpse)
+{
+	if (Corpse.State == ECorpseState::Simulating)
+	{
+		Freeze(Corpse);
+	}
+
+	// Component visibility does not replicate, unlike the actor's bHidden
+	Corpse.Character->GetMesh()->SetVisibility(false, true);
+	Corpse.State = ECorpseState::Hidden;
+}
+
+void FNSCorpseManager::Remove(FCorpse& Corpse)
+{
+	ANSCharacter* Character = Corpse.Character.Get();
+
+	if (Character->Role == ROLE_Authority)
+	{
+		Character->Destroy();
+	}
+	else if (Corpse.State != ECorpseState::Hidden)
+	{
+		// Replicated actors are destroyed by the server, until then keep it out of the scene
+		Hide(Corpse);
+	}
+
+	Corpse.Character = nullptr;
+}
+
+void FNSCorpseManager::Tick(UWorld* World, float DeltaSeconds)
+{
+	SCOPE_CYCLE_COUNTER(STAT_NSCorpseManager);
+
+	Corpses.RemoveAll([](const FCorpse& Corpse) { return !Corpse.Character.IsValid(); });
+
+	FVector ViewLocation;
+	FRotator ViewRotation;
+	APlayerController* LocalPC = GEngine->GetFirstLocalPlayerController(World);
+	const bool bHasView = LocalPC != nullptr;
+	if (bHasView)
+	{
+		LocalPC->GetPlayerViewPoint(ViewLocation, ViewRotation);
+	}
+
+	const float SettleSpeedSq = FMath::Square(Settings.SettleSpeed);
+	const float CullDistanceSq = FMath::Square(Settings.CullDistance);
+
+	int32 Simulating = NumSimulating();
+	const int32 ExcessCorpses = Corpses.Num() - Settings.MaxCorpses;
+
+	for (int32 i = 0; i < Corpses.Num(); ++i)
+	{
+		FCorpse& Corpse = Corpses[i];
+		Corpse.Age += DeltaSeconds;
+
+		if (i < ExcessCorpses)
+		{
+			if (Corpse.State == ECorpseState::Simulating)
+			{
+				Simulating--;
+			}
+			Remove(Corpse);
+			continue;
+		}
+
+		if (Corpse.State == ECorpseState::Simulating)
+		{
+			const bool bStill = Corpse.Character->GetMesh()->GetPhysicsLinearVelocity().SizeSquared() < SettleSpeedSq;
+			Corpse.StillTime = bStill ? Corpse.StillTime + DeltaSeconds : 0.0f;
+
+			// Corpses are ordered by age, so the oldest ragdolls are frozen first when over budget
+			if (Corpse.StillTime >= Settings.SettleTime || Simulating > Settings.MaxRagdolls)
+			{
+				Freeze(Corpse);
+				Simulating--;
+			}
+		}
+
+		if (Corpse.State == ECorpseState::Hidden)
+		{
+			if (Corpse.Age >= Settings.LifeSpan + Settings.FadeTime)
+			{
+				Remove(Corpse);
+			}
+			continue;
+		}
+
+		if (Corpse.State != ECorpseState::Fading)
+		{
+			if (Corpse.Age >= Settings.LifeSpan)
+			{
+				Corpse.State = ECorpseState::Fading;
+			}
+			else if (bHasView && Corpse.State == ECorpseState::Frozen
+				&& FVector::DistSquared(ViewLocation, Corpse.Character->GetActorLocation()) > CullDistanceSq)
+			{
+				// Far from our view is no reason to take it from anyone else's
+				Hide(Corpse);
+				continue;
+			}
+		}
+
+		if (Corpse.State == ECorpseState::Fading)
+		{
+			const float FadeAlpha = Settings.FadeTime > 0.0f ? (Corpse.Age - Settings.LifeSpan) / Settings.FadeTime : 1.0f;
+			if (FadeAlpha >= 1.0f)
+			{
+				Remove(Corpse);
+			}
+			else if (Corpse.bCanFade)
+			{
+				Corpse.Character->SetCorpseFade(FadeAlpha);
+			}
+		}
+	}
+
+	Corpses.RemoveAll([](const FCorpse& Corpse) { return !Corpse.Character.IsValid(); });
+
+	SET_DWORD_STAT(STAT_NSSimulatingRagdolls, Simulating);
+	SET_DWORD_STAT(STAT_NSCorpses, Corpses.Num());
+}
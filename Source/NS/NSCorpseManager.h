@@ -0,0 +1,85 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+struct FNSCorpseSettings
+{
+	/** Ragdolls allowed to simulate at the same time, the oldest ones are frozen first */
+	int32 MaxRagdolls;
+
+	/** Corpses kept in the level, the oldest ones are removed first */
+	int32 MaxCorpses;
+
+	/** Seconds before a corpse starts fading */
+	float LifeSpan;
+
+	/** Seconds a corpse takes to fade before being removed */
+	float FadeTime;
+
+	/** Settled corpses farther than this from the local view are hidden on this machine */
+	float CullDistance;
+
+	/** Speed, in cm/s, below which a ragdoll counts as still */
+	float SettleSpeed;
+
+	/** Seconds a ragdoll must stay still before it is frozen */
+	float SettleTime;
+};
+
+/**
+ * Keeps the cost of dead characters bounded on every machine. Ragdolls
+ * are frozen once settled or when too many simulate at once, and corpses
+ * fade and are removed by age and count. The server destroys corpses,
+ * clients only hide the ones they drop before it does. Distance to the
+ * local view only hides a corpse locally, also on a listen server: the
+ * view of the host must not decide what every other player sees.
+ */
+class FNSCorpseManager
+{
+public:
+	FNSCorpseManager();
+
+	FNSCorpseSettings Settings;
+
+	/** Starts tracking a character that just died */
+	void AddCorpse(class ANSCharacter* Character);
+
+	void Tick(UWorld* World, float DeltaSeconds);
+
+	int32 NumSimulating() const;
+
+	int32 Num() const { return Corpses.Num(); }
+
+private:
+	enum class ECorpseState : uint8
+	{
+		Simulating,
+		Frozen,
+		Fading,
+		/** Culled by distance on this machine, removed when its life ends */
+		Hidden
+	};
+
+	struct FCorpse
+	{
+		TWeakObjectPtr<class ANSCharacter> Character;
+		float Age;
+		float StillTime;
+		ECorpseState State;
+
+		/** The body material has the FadeAlpha parameter, otherwise the corpse disappears at the end of the fade */
+		bool bCanFade;
+	};
+
+	/** Stops the ragdoll simulation and keeps its last pose */
+	void Freeze(FCorpse& Corpse);
+
+	/** Out of the scene on this machine only */
+	void Hide(FCorpse& Corpse);
+
+	/** Destroys the corpse on the server, hides it on clients, and stops tracking it */
+	void Remove(FCorpse& Corpse);
+
+	/** Oldest first */
+	TArray<FCorpse> Corpses;
+};
@@ -0,0 +1,334 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "NS.h"
+#include "NSFirePolicies.h"
+#include "NSCharacter.h"
+#include "NSPlayerState.h"
+#include "NSProjectile.h"
+#include "NSShotTrace.h"
+#include "NSPerfTracker.h"
+#include "NSWeaponDefinition.h"
+#include "Animation/AnimInstance.h"
+
+template<bool bMultiPellet, bool bPenetrating>
+void TNSHitscanPolicy<bMultiPellet, bPenetrating>::Fire(ANSCharacter* Shooter, const UNSWeaponDefinition* Weapon, const FVector& Origin, const FVector& Direction)
+{
+	// The replicated team is cached on the character, no need for the player state here
+	FNSShotDamageList Damages;
+	FNSShotTrace::TraceT<bMultiPellet, bPenetrating>(Shooter, Shooter->CurrentTeam, Weapon, Origin, Direction, FNSShotTrace::GetFireStream(), Damages);
+	Shooter->ApplyShotDamage(Damages);
+}
+
+template<bool bMultiPellet, bool bPenetrating>
+void TNSHitscanPolicy<bMultiPellet, bPenetrating>::Trace(const ANSCharacter* Shooter, const UNSWeaponDefinition* Weapon, const FVector& Origin, const FVector& Direction, const FRandomStream& Spread, FNSShotDamageList& OutDamage)
+{
+	FNSShotTrace::TraceT<bMultiPellet, bPenetrating>(Shooter, Shooter->CurrentTeam, Weapon, Origin, Direction, Spread, OutDamage);
+}
+
+void FNSProjectilePolicy::Fire(ANSCharacter* Shooter, const UNSWeaponDefinition* Weapon, const FVector& Origin, const FVector& Direction)
+{
+	if (Weapon->ProjectileClass == nullptr)
+	{
+		return;
+	}
+
+	FActorSpawnParameters SpawnInfo;
+	SpawnInfo.Owner = Shooter;
+	SpawnInfo.Instigator = Shooter;
+	SpawnInfo.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+	// Spawn in front of the camera so the projectile does not hit ourselves
+	const FVector SpawnLocation = Origin + Direction * Shooter->GunOffset.X;
+	ANSProjectile* Projectile = Shooter->GetWorld()->SpawnActor<ANSProjectile>(Weapon->ProjectileClass, SpawnLocation, Direction.Rotation(), SpawnInfo);
+	if (Projectile != nullptr)
+	{
+		Projectile->SetShooterWeapon(Weapon, Shooter->CurrentTeam);
+	}
+}
+
+void FNSEffectsPolicy::PlayLocal(ANSCharacter* Shooter)
+{
+	// try and play a firing animation if specified
+	if (Shooter->FP_FireAnimation != nullptr)
+	{
+		UAnimInstance* AnimInstance = Shooter->FP_Mesh->GetAnimInstance();
+		if (AnimInstance != nullptr)
+		{
+			AnimInstance->Montage_Play(Shooter->FP_FireAnimation, 1.f);
+		}
+	}
+
+	if (Shooter->FP_GunShotParticle != nullptr)
+	{
+		Shooter->FP_GunShotParticle->Activate(true);
+	}
+}
+
+void FNSEffectsPolicy::PlayRemote(ANSCharacter* Shooter)
+{
+	if (Shooter->TP_FireAnimation != nullptr)
+	{
+		UAnimInstance* AnimInstance = Shooter->GetMesh()->GetAnimInstance();
+		if (AnimInstance != nullptr)
+		{
+			AnimInstance->Montage_Play(Shooter->TP_FireAnimation, 1.f);
+		}
+	}
+
+	if (Shooter->FireSound != nullptr)
+	{
+		UGameplayStatics::PlaySoundAtLocation(Shooter, Shooter->FireSound, Shooter->GetActorLocation());
+	}
+
+	if (Shooter->TP_GunShotParticle != nullptr)
+	{
+		Shooter->TP_GunShotParticle->Activate(true);
+	}
+
+	if (Shooter->BulletParticle != nullptr)
+	{
+		UGameplayStatics::SpawnEmitterAtLocation(Shooter->GetWorld(), Shooter->BulletParticle->Template, Shooter->BulletParticle->GetComponentLocation(), Shooter->BulletParticle->GetComponentRotation());
+	}
+}
+
+template<typename TracePolicy, typename ModePolicy, typename EffectsPolicy>
+void TNSFirePolicy<TracePolicy, ModePolicy, EffectsPolicy>::ServerFire(ANSCharacter* Shooter, const UNSWeaponDefinition* Weapon, const FVector& Origin, const FVector& Direction)
+{
+	TracePolicy::Fire(Shooter, Weapon, Origin, Direction);
+
+	// Weapons without effects do not send their events at all
+	if (EffectsPolicy::bReplicateEffects)
+	{
+		Shooter->SendShootEffects();
+	}
+}
+
+template<typename TracePolicy, typename ModePolicy, typename EffectsPolicy>
+static FNSFireFunctions MakeFireFunctions()
+{
+	typedef TNSFirePolicy<TracePolicy, ModePolicy, EffectsPolicy> FPolicy;
+
+	FNSFireFunctions Functions;
+	Functions.ServerFire = &FPolicy::ServerFire;
+	Functions.Trace = TracePolicy::bHitscan ? &TracePolicy::Trace : nullptr;
+	Functions.PlayLocalEffects = &EffectsPolicy::PlayLocal;
+	Functions.PlayRemoteEffects = &EffectsPolicy::PlayRemote;
+	Functions.ShotsPerTrigger = ModePolicy::ShotsPerTrigger;
+	Functions.bAutomatic = !!ModePolicy::bAutomatic;
+	return Functions;
+}
+
+template<typename TracePolicy, typename ModePolicy>
+static void AddEffectsVariants(TArray<FNSFireFunctions>& Table)
+{
+	Table.Add(MakeFireFunctions<TracePolicy, ModePolicy, FNSNoEffectsPolicy>());
+	Table.Add(MakeFireFunctions<TracePolicy, ModePolicy, FNSEffectsPolicy>());
+}
+
+template<typename TracePolicy>
+static void AddModeVariants(TArray<FNSFireFunctions>& Table)
+{
+	// Same order as ENSFireMode
+	AddEffectsVariants<TracePolicy, FNSSingleShotPolicy>(Table);
+	AddEffectsVariants<TracePolicy, FNSBurstPolicy>(Table);
+	AddEffectsVariants<TracePolicy, FNSAutoPolicy>(Table);
+}
+
+/** Trace variants, in table order */
+enum ENSTraceVariant
+{
+	Hitscan_Single,
+	Hitscan_Penetrating,
+	Hitscan_Pellets,
+	Hitscan_PenetratingPellets,
+	Projectile,
+	TraceVariant_Count
+};
+
+static const int32 FunctionsPerTrace = 3 * 2;
+
+const FNSFireFunctions& FNSFirePolicyRegistry::Get(const UNSWeaponDefinition* Weapon)
+{
+	return Get(Weapon, Weapon->bPlayEffects);
+}
+
+const FNSFireFunctions& FNSFirePolicyRegistry::Get(const UNSWeaponDefinition* Weapon, bool bPlayEffects)
+{
+	static TArray<FNSFireFunctions> Table;
+	if (Table.Num() == 0)
+	{
+		Table.Reserve(TraceVariant_Count * FunctionsPerTrace);
+		AddModeVariants<TNSHitscanPolicy<false, false>>(Table);
+		AddModeVariants<TNSHitscanPolicy<false, true>>(Table);
+		AddModeVariants<TNSHitscanPolicy<true, false>>(Table);
+		AddModeVariants<TNSHitscanPolicy<true, true>>(Table);
+		AddModeVariants<FNSProjectilePolicy>(Table);
+	}
+
+	int32 TraceVariant = Projectile;
+	if (Weapon->FireTrace == ENSFireTrace::Hitscan)
+	{
+		TraceVariant = (Weapon->PelletCount > 1 ? 2 : 0) + (Weapon->MaxPenetrations > 0 ? 1 : 0);
+	}
+
+	const int32 Index = TraceVariant * FunctionsPerTrace + (int32)Weapon->FireMode * 2 + (bPlayEffects ? 1 : 0);
+	return Table[Index];
+}
+
+/** Whether the specialized trace of Weapon hurts the same enemies as the generic one, for the same random pellets */
+static bool CheckSpecializedTrace(const ANSCharacter* Shooter, const UNSWeaponDefinition* Weapon, const FVector& Origin, const FVector& Direction)
+{
+	const FNSFireFunctions& Functions = FNSFirePolicyRegistry::Get(Weapon);
+	if (Functions.Trace == nullptr)
+	{
+		return true;
+	}
+
+	FNSShotDamageList Generic;
+	FNSShotDamageList Specialized;
+
+	// Seeded streams of its own, so the match keeps its random sequence
+	FNSShotTrace::Trace(Shooter, Shooter->CurrentTeam, Weapon, Origin, Direction, FRandomStream(1234), Generic);
+	Functions.Trace(Shooter, Weapon, Origin, Direction, FRandomStream(1234), Specialized);
+
+	bool bSame = Generic.Num() == Specialized.Num();
+	for (int32 i = 0; bSame && i < Generic.Num(); ++i)
+	{
+		const FNSShotDamage* Match = Specialized.FindByPredicate([&](const FNSShotDamage& Other) { return Other.Victim == Generic[i].Victim; });
+		bSame = Match != nullptr && FMath::IsNearlyEqual(Match->Damage, Generic[i].Damage, 0.01f);
+	}
+
+	return FNSPerfTracker::Expect(bSame, TEXT("ns.Fire.Bench"),
+		FString::Printf(TEXT("generic trace hurts %d enemies, specialized %d or with different damage"), Generic.Num(), Specialized.Num()));
+}
+
+/** One path of ns.Fire.Bench, fired at a fixed rate from the core ticker */
+struct FNSFireBenchRun
+{
+	TWeakObjectPtr<ANSCharacter> Shooter;
+	FVector Origin;
+	FVector End;
+	float Rate;
+	float Seconds;
+
+	/** 0 generic, 1 specialized */
+	int32 Path;
+	float Elapsed;
+	float ShotsDue;
+	int32 Shots[2];
+	int32 Frames[2];
+	double FireSeconds[2];
+};
+
+static bool TickFireBench(float DeltaTime, TSharedRef<FNSFireBenchRun> Run)
+{
+	ANSCharacter* Shooter = Run->Shooter.Get();
+	if (Shooter == nullptr)
+	{
+		UE_LOG(LogNS, Warning, TEXT("ns.Fire.Bench stopped, the shooter is gone"));
+		return false;
+	}
+
+	// Effects are left out of both paths, only the server side of the shot is compared
+	const UNSWeaponDefinition* Weapon = Shooter->GetWeaponDefinition();
+	const FNSFireFunctions& Functions = FNSFirePolicyRegistry::Get(Weapon, false);
+	const FVector Direction = (Run->End - Run->Origin).GetSafeNormal();
+
+	Run->ShotsDue += Run->Rate * DeltaTime;
+	const int32 Shots = FMath::FloorToInt(Run->ShotsDue);
+	Run->ShotsDue -= Shots;
+
+	const double StartTime = FPlatformTime::Seconds();
+	for (int32 i = 0; i < Shots; ++i)
+	{
+		if (Run->Path == 0)
+		{
+			Shooter->FireGeneric(Run->Origin, Run->End, false);
+		}
+		else
+		{
+			Functions.ServerFire(Shooter, Weapon, Run->Origin, Direction);
+		}
+	}
+	Run->FireSeconds[Run->Path] += FPlatformTime::Seconds() - StartTime;
+	Run->Shots[Run->Path] += Shots;
+	Run->Frames[Run->Path]++;
+
+	Run->Elapsed += DeltaTime;
+	if (Run->Elapsed < Run->Seconds)
+	{
+		return true;
+	}
+
+	if (Run->Path == 0)
+	{
+		Run->Path = 1;
+		Run->Elapsed = 0.0f;
+		Run->ShotsDue = 0.0f;
+		return true;
+	}
+
+	for (int32 i = 0; i < 2; ++i)
+	{
+		UE_LOG(LogNS, Log, TEXT("ns.Fire.Bench %s at %.0f shots/s: %d shots, %.2f us/shot, %.3f ms per frame"),
+			i == 0 ? TEXT("generic") : TEXT("specialized"), Run->Rate, Run->Shots[i],
+			Run->Shots[i] > 0 ? Run->FireSeconds[i] * 1000000.0 / Run->Shots[i] : 0.0,
+			Run->Frames[i] > 0 ? Run->FireSeconds[i] * 1000.0 / Run->Frames[i] : 0.0);
+	}
+	return false;
+}
+
+static FAutoConsoleCommandWithWorldAndArgs FireBenchCommand(
+	TEXT("ns.Fire.Bench"),
+	TEXT("Fires R shots per second (default 1000) for S seconds (default 5) through the generic and then the specialized server path of the first authoritative character, without effects, and logs the cost of each. Fails if the two traces disagree: ns.Fire.Bench <R> <S>"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		const float Rate = Args.Num() > 0 ? FMath::Max(FCString::Atof(*Args[0]), 1.0f) : 1000.0f;
+		const float Seconds = Args.Num() > 1 ? FMath::Max(FCString::Atof(*Args[1]), 0.1f) : 5.0f;
+
+		ANSCharacter* Shooter = nullptr;
+		for (TActorIterator<ANSCharacter> Iter(World); Iter && Shooter == nullptr; ++Iter)
+		{
+			if ((*Iter)->Role == ROLE_Authority && (*Iter)->GetNSPlayerState() != nullptr)
+			{
+				Shooter = *Iter;
+			}
+		}
+
+		if (Shooter == nullptr)
+		{
+			UE_LOG(LogNS, Warning, TEXT("ns.Fire.Bench needs an authoritative character with a player state"));
+			return;
+		}
+
+		const FVector Origin = Shooter->GetPawnViewLocation();
+
+		// Both traces must agree on a shot at an enemy, when there is one
+		for (TActorIterator<ANSCharacter> Iter(World); Iter; ++Iter)
+		{
+			if ((*Iter)->CurrentTeam != Shooter->CurrentTeam)
+			{
+				if (!CheckSpecializedTrace(Shooter, Shooter->GetWeaponDefinition(), Origin, ((*Iter)->GetActorLocation() - Origin).GetSafeNormal()))
+				{
+					return;
+				}
+				break;
+			}
+		}
+
+		// Shoot straight up so no one is hurt while measuring
+		TSharedRef<FNSFireBenchRun> Run = MakeShareable(new FNSFireBenchRun());
+		Run->Shooter = Shooter;
+		Run->Origin = Origin;
+		Run->End = Origin + FVector::UpVector * 10000000.0f;
+		Run->Rate = Rate;
+		Run->Seconds = Seconds;
+		Run->Path = 0;
+		Run->Elapsed = 0.0f;
+		Run->ShotsDue = 0.0f;
+		Run->Shots[0] = Run->Shots[1] = 0;
+		Run->Frames[0] = Run->Frames[1] = 0;
+		Run->FireSeconds[0] = Run->FireSeconds[1] = 0.0;
+
+		FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateStatic(&TickFireBench, Run));
+	}));
@@ -0,0 +1,99 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "NSShotTrace.h"
+
+/**
+ * Weapon firing expressed as compile-time policies. A weapon's behaviour is
+ * one TNSFirePolicy<Trace, Mode, Effects> instantiation, so its hot path only
+ * contains the code that weapon needs. FNSFirePolicyRegistry maps the enums
+ * of a UNSWeaponDefinition to the matching instantiation at runtime, which
+ * keeps weapons selectable from Blueprint.
+ */
+
+/** Hitscan on the server; pellet loop and penetration are compiled in or out */
+template<bool bMultiPellet, bool bPenetrating>
+struct TNSHitscanPolicy
+{
+	enum { bHitscan = true };
+
+	static void Fire(class ANSCharacter* Shooter, const class UNSWeaponDefinition* Weapon, const FVector& Origin, const FVector& Direction);
+
+	/** Damage the shot would deal, without applying it */
+	static void Trace(const class ANSCharacter* Shooter, const class UNSWeaponDefinition* Weapon, const FVector& Origin, const FVector& Direction, const FRandomStream& Spread, FNSShotDamageList& OutDamage);
+};
+
+/** Spawns the weapon's projectile on the server */
+struct FNSProjectilePolicy
+{
+	enum { bHitscan = false };
+
+	static void Fire(class ANSCharacter* Shooter, const class UNSWeaponDefinition* Weapon, const FVector& Origin, const FVector& Direction);
+
+	static void Trace(const class ANSCharacter* Shooter, const class UNSWeaponDefinition* Weapon, const FVector& Origin, const FVector& Direction, const FRandomStream& Spread, FNSShotDamageList& OutDamage) {}
+};
+
+struct FNSSingleShotPolicy
+{
+	enum { ShotsPerTrigger = 1, bAutomatic = false };
+};
+
+struct FNSBurstPolicy
+{
+	enum { ShotsPerTrigger = 3, bAutomatic = false };
+};
+
+struct FNSAutoPolicy
+{
+	enum { ShotsPerTrigger = 1, bAutomatic = true };
+};
+
+struct FNSNoEffectsPolicy
+{
+	enum { bReplicateEffects = false };
+
+	static void PlayLocal(class ANSCharacter* Shooter) {}
+	static void PlayRemote(class ANSCharacter* Shooter) {}
+};
+
+struct FNSEffectsPolicy
+{
+	enum { bReplicateEffects = true };
+
+	/** 1st person animation and particles on the shooting client */
+	static void PlayLocal(class ANSCharacter* Shooter);
+
+	/** 3rd person animation, sound and particles on every client */
+	static void PlayRemote(class ANSCharacter* Shooter);
+};
+
+template<typename TracePolicy, typename ModePolicy, typename EffectsPolicy>
+struct TNSFirePolicy
+{
+	/** Server side of one shot */
+	static void ServerFire(class ANSCharacter* Shooter, const class UNSWeaponDefinition* Weapon, const FVector& Origin, const FVector& Direction);
+};
+
+/** Runtime view of one TNSFirePolicy instantiation */
+struct FNSFireFunctions
+{
+	void (*ServerFire)(class ANSCharacter*, const class UNSWeaponDefinition*, const FVector&, const FVector&);
+
+	/** Specialized trace of hitscan weapons, null for projectiles. ns.Fire.Bench checks it against the generic one */
+	void (*Trace)(const class ANSCharacter*, const class UNSWeaponDefinition*, const FVector&, const FVector&, const FRandomStream&, FNSShotDamageList&);
+	void (*PlayLocalEffects)(class ANSCharacter*);
+	void (*PlayRemoteEffects)(class ANSCharacter*);
+	int32 ShotsPerTrigger;
+	bool bAutomatic;
+};
+
+class FNSFirePolicyRegistry
+{
+public:
+	/** Returns the specialized functions matching the weapon's settings */
+	static const FNSFireFunctions& Get(const class UNSWeaponDefinition* Weapon);
+
+	/** Same, with effects forced on or off */
+	static const FNSFireFunctions& Get(const class UNSWeaponDefinition* Weapon, bool bPlayEffects);
+};
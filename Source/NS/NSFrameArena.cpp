@@ -0,0 +1,92 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "NS.h"
+#include "NSFrameArena.h"
+
+DECLARE_MEMORY_STAT(TEXT("Frame Arena Capacity"), STAT_NSFrameArenaCapacity, STATGROUP_NS);
+DECLARE_MEMORY_STAT(TEXT("Frame Arena Peak"), STAT_NSFrameArenaPeak, STATGROUP_NS);
+
+FNSFrameArena& FNSFrameArena::Get()
+{
+	check(IsInGameThread());
+
+	// Never destroyed, the allocator may be gone by the time statics are
+	static FNSFrameArena* Arena = nullptr;
+	if (Arena == nullptr)
+	{
+		Arena = new FNSFrameArena();
+		FCoreDelegates::OnEndFrame.AddRaw(Arena, &FNSFrameArena::Reset);
+	}
+	return *Arena;
+}
+
+FNSFrameArena::FNSFrameArena()
+	: CurrentChunk(0)
+	, Offset(0)
+	, UsedBytes(0)
+	, PeakBytes(0)
+{
+}
+
+FNSFrameArena::~FNSFrameArena()
+{
+	for (const FChunk& Chunk : Chunks)
+	{
+		FMemory::Free(Chunk.Data);
+	}
+}
+
+void* FNSFrameArena::Alloc(SIZE_T Size, uint32 Alignment)
+{
+	// DEFAULT_ALIGNMENT is 0, which Align() would turn into offset 0 for every request
+	if (Alignment == 0)
+	{
+		Alignment = 16;
+	}
+
+	while (CurrentChunk < Chunks.Num())
+	{
+		const FChunk& Chunk = Chunks[CurrentChunk];
+		const SIZE_T Start = Align(Offset, Alignment);
+		if (Start + Size <= Chunk.Size)
+		{
+			Offset = Start + Size;
+			UsedBytes += Size;
+			return Chunk.Data + Start;
+		}
+
+		// The rest of this chunk is wasted until the reset
+		++CurrentChunk;
+		Offset = 0;
+	}
+
+	// Oversized requests get a chunk of their own, kept like the others
+	const SIZE_T NewSize = FMath::Max(ChunkSize, Align(Size, Alignment));
+	Chunks.Add({ (uint8*)FMemory::Malloc(NewSize, Alignment), NewSize });
+	CurrentChunk = Chunks.Num() - 1;
+	SET_MEMORY_STAT(STAT_NSFrameArenaCapacity, GetCapacity());
+
+	Offset = Size;
+	UsedBytes += Size;
+	return Chunks[CurrentChunk].Data;
+}
+
+void FNSFrameArena::Reset()
+{
+	PeakBytes = FMath::Max(PeakBytes, UsedBytes);
+	SET_MEMORY_STAT(STAT_NSFrameArenaPeak, PeakBytes);
+
+	CurrentChunk = 0;
+	Offset = 0;
+	UsedBytes = 0;
+}
+
+SIZE_T FNSFrameArena::GetCapacity() const
+{
+	SIZE_T Capacity = 0;
+	for (const FChunk& Chunk : Chunks)
+	{
+		Capacity += Chunk.Size;
+	}
+	return Capacity;
+}
@@ -0,0 +1,156 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+/**
+ * Linear allocator for gameplay temporaries that do not outlive the frame.
+ *
+ * Allocating is a pointer bump inside a chunk; nothing is freed one by one,
+ * the whole arena is rewound at the end of every frame. Chunks are kept
+ * between frames, so once the arena has grown to the frame's working size
+ * it never touches the heap again. Game thread only. Destructors are not
+ * run, so only trivially destructible types may be created in it.
+ */
+class FNSFrameArena
+{
+public:
+	/** The game thread arena, rewound on every end of frame */
+	static FNSFrameArena& Get();
+
+	FNSFrameArena();
+	~FNSFrameArena();
+
+	/** Alignment 0, DEFAULT_ALIGNMENT, means 16 */
+	void* Alloc(SIZE_T Size, uint32 Alignment);
+
+	template<typename T, typename... ArgTypes>
+	T* New(ArgTypes&&... Args)
+	{
+		static_assert(TIsTriviallyDestructible<T>::Value, "Frame arena objects are never destroyed");
+		return new (Alloc(sizeof(T), ALIGNOF(T))) T(Forward<ArgTypes>(Args)...);
+	}
+
+	/** Forgets every allocation. Memory handed out before is reused */
+	void Reset();
+
+	/** Bytes handed out since the last reset */
+	SIZE_T GetUsedBytes() const { return UsedBytes; }
+
+	/** Most bytes handed out in one frame */
+	SIZE_T GetPeakBytes() const { return PeakBytes; }
+
+	/** Bytes held in chunks */
+	SIZE_T GetCapacity() const;
+
+private:
+	struct FChunk
+	{
+		uint8* Data;
+		SIZE_T Size;
+	};
+
+	static const SIZE_T ChunkSize = 64 * 1024;
+
+	TArray<FChunk> Chunks;
+	int32 CurrentChunk;
+	SIZE_T Offset;
+	SIZE_T UsedBytes;
+	SIZE_T PeakBytes;
+};
+
+/**
+ * Container allocator drawing from the frame arena, for TArrays local to a
+ * frame: TArray<FRow, FNSFrameAllocator>. Growing copies into a new block and
+ * leaves the old one to the end of frame reset, so reserve when the size is known.
+ */
+class FNSFrameAllocator
+{
+public:
+	typedef int32 SizeType;
+
+	enum { NeedsElementType = false };
+	enum { RequireRangeCheck = true };
+
+	class ForAnyElementType
+	{
+	public:
+		ForAnyElementType()
+			: Data(nullptr)
+		{
+		}
+
+		FORCEINLINE void MoveToEmpty(ForAnyElementType& Other)
+		{
+			checkSlow(this != &Other);
+			Data = Other.Data;
+			Other.Data = nullptr;
+		}
+
+		FORCEINLINE FScriptContainerElement* GetAllocation() const
+		{
+			return Data;
+		}
+
+		void ResizeAllocation(int32 PreviousNumElements, int32 NumElements, SIZE_T NumBytesPerElement)
+		{
+			FScriptContainerElement* OldData = Data;
+			Data = nullptr;
+			if (NumElements > 0)
+			{
+				Data = (FScriptContainerElement*)FNSFrameArena::Get().Alloc(NumElements * NumBytesPerElement, DEFAULT_ALIGNMENT);
+				if (OldData != nullptr && PreviousNumElements > 0)
+				{
+					FMemory::Memcpy(Data, OldData, FMath::Min(NumElements, PreviousNumElements) * NumBytesPerElement);
+				}
+			}
+		}
+
+		int32 CalculateSlackReserve(int32 NumElements, SIZE_T NumBytesPerElement) const
+		{
+			return NumElements;
+		}
+
+		int32 CalculateSlackShrink(int32 NumElements, int32 NumAllocatedElements, SIZE_T NumBytesPerElement) const
+		{
+			// Shrinking would only waste more arena
+			return NumAllocatedElements;
+		}
+
+		int32 CalculateSlackGrow(int32 NumElements, int32 NumAllocatedElements, SIZE_T NumBytesPerElement) const
+		{
+			return FMath::Max(NumElements, NumAllocatedElements * 2 + 16);
+		}
+
+		SIZE_T GetAllocatedSize(int32 NumAllocatedElements, SIZE_T NumBytesPerElement) const
+		{
+			return NumAllocatedElements * NumBytesPerElement;
+		}
+
+		bool HasAllocation()
+		{
+			return Data != nullptr;
+		}
+
+	private:
+		ForAnyElementType(const ForAnyElementType&);
+		ForAnyElementType& operator=(const ForAnyElementType&);
+
+		FScriptContainerElement* Data;
+	};
+
+	template<typename ElementType>
+	class ForElementType : public ForAnyElementType
+	{
+	public:
+		FORCEINLINE ElementType* GetAllocation() const
+		{
+			return (ElementType*)ForAnyElementType::GetAllocation();
+		}
+	};
+};
+
+template <>
+struct TAllocatorTraits<FNSFrameAllocator> : TAllocatorTraitsBase<FNSFrameAllocator>
+{
+	enum { SupportsMove = true };
+};
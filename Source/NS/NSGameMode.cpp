@@ -3,9 +3,192 @@
 #include "NS.h"
 #include "NSGameMode.h"
 #include "NSHUD.h"
+#include "NSGameState.h"
 #include "NSPlayerState.h"
 #include "NSSPawnPoint.h"
 #include "NSCharacter.h"
+#include "NSBotController.h"
+#include "NSPerfTracker.h"
+#include "NSAllocTracker.h"
+#include "NSMatchStats.h"
+#include "NSNetStats.h"
+#include "NSPlayerController.h"
+
+static FAutoConsoleCommandWithWorldAndArgs AddBotsCommand(
+	TEXT("ns.Bots.Add"),
+	TEXT("Adds N server-side bots to the match: ns.Bots.Add <N>"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		ANSGameMode* GameMode = World ? Cast<ANSGameMode>(World->GetAuthGameMode()) : nullptr;
+		if (GameMode != nullptr)
+		{
+			const int32 Count = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 1;
+			for (int32 i = 0; i < Count; ++i)
+			{
+				GameMode->AddBot();
+			}
+		}
+	}));
+
+/** State of ns.Net.RespawnBench, stepped from the core ticker */
+struct FNSRespawnBenchRun
+{
+	TWeakObjectPtr<UWorld> World;
+	TArray<TWeakObjectPtr<AController>> Controllers;
+	TArray<TWeakObjectPtr<APawn>> OldPawns;
+	int32 Respawns;
+	int32 Done;
+	int32 Failed;
+
+	/** 0 idle window, 1 respawning, 2 letting the last respawns replicate */
+	int32 Phase;
+	float Elapsed;
+	float RespawnSeconds;
+	int64 StartBunches;
+	double IdleBunchesPerSecond;
+};
+
+static const float RespawnBenchWindowSeconds = 2.0f;
+
+/** Reliable bunches sent to every client so far, see FNSNetStats::GetReliableBunchesSent */
+static int64 GetReliableBunchesSent(UWorld* World, int32& OutConnections)
+{
+	int64 Bunches = 0;
+	OutConnections = 0;
+	UNetDriver* NetDriver = World->GetNetDriver();
+	if (NetDriver != nullptr)
+	{
+		for (UNetConnection* Connection : NetDriver->ClientConnections)
+		{
+			if (Connection != nullptr)
+			{
+				Bunches += FNSNetStats::GetReliableBunchesSent(Connection);
+				OutConnections++;
+			}
+		}
+	}
+	return Bunches;
+}
+
+static bool TickRespawnBench(float DeltaTime, TSharedRef<FNSRespawnBenchRun> Run)
+{
+	UWorld* World = Run->World.Get();
+	ANSGameMode* GameMode = World != nullptr ? World->GetAuthGameMode<ANSGameMode>() : nullptr;
+	if (GameMode == nullptr)
+	{
+		return false;
+	}
+
+	int32 Connections = 0;
+	const int64 Bunches = GetReliableBunchesSent(World, Connections);
+	Run->Elapsed += DeltaTime;
+
+	// The traffic of the match without respawns, subtracted from the respawn window
+	if (Run->Phase == 0)
+	{
+		if (Run->Elapsed >= RespawnBenchWindowSeconds)
+		{
+			Run->IdleBunchesPerSecond = (Bunches - Run->StartBunches) / Run->Elapsed;
+			Run->StartBunches = Bunches;
+			Run->Elapsed = 0.0f;
+			Run->Phase = 1;
+		}
+		return true;
+	}
+
+	// One respawn per frame, round robin over the players
+	if (Run->Phase == 1)
+	{
+		AController* Controller = Run->Controllers[Run->Done % Run->Controllers.Num()].Get();
+		APawn* OldPawn = Controller != nullptr ? Controller->GetPawn() : nullptr;
+		if (Controller != nullptr)
+		{
+			GameMode->Respawn(Controller);
+		}
+		if (Controller == nullptr || Controller->GetPawn() == nullptr || Controller->GetPawn() == OldPawn)
+		{
+			Run->Failed++;
+		}
+		Run->OldPawns.Add(OldPawn);
+
+		if (++Run->Done == Run->Respawns)
+		{
+			Run->RespawnSeconds = Run->Elapsed;
+			Run->Phase = 2;
+		}
+		return true;
+	}
+
+	if (Run->Elapsed < Run->RespawnSeconds + RespawnBenchWindowSeconds)
+	{
+		return true;
+	}
+
+	const double Total = Bunches - Run->StartBunches;
+	const double Idle = Run->IdleBunchesPerSecond * Run->Elapsed;
+	const double PerRespawn = (Total - Idle) / Run->Respawns;
+	UE_LOG(LogNS, Log, TEXT("ns.Net.RespawnBench %d respawns, %d players, %d connections: %.0f reliable bunches in %.1f s, %.0f expected without respawns, %.2f per respawn, %.3f per respawn per connection"),
+		Run->Respawns, Run->Controllers.Num(), Connections, Total, Run->Elapsed, Idle, PerRespawn, Connections > 0 ? PerRespawn / Connections : 0.0);
+
+	FNSPerfTracker::Expect(Run->Failed == 0, TEXT("ns.Net.RespawnBench"), FString::Printf(TEXT("%d of %d respawns left the player without a new character"), Run->Failed, Run->Respawns));
+
+	// The replaced characters only go now, their channel close bunches are not part of the respawn
+	for (const TWeakObjectPtr<APawn>& OldPawn : Run->OldPawns)
+	{
+		if (OldPawn.IsValid())
+		{
+			OldPawn->Destroy();
+		}
+	}
+	return false;
+}
+
+static FAutoConsoleCommandWithWorldAndArgs RespawnBenchCommand(
+	TEXT("ns.Net.RespawnBench"),
+	TEXT("Respawns the players N times (default 64), one per frame, and logs the reliable bunches sent per respawn and connection, from the channel sequence numbers and net of the idle traffic: ns.Net.RespawnBench <N>"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		ANSGameMode* GameMode = World != nullptr ? World->GetAuthGameMode<ANSGameMode>() : nullptr;
+		if (GameMode == nullptr || World->GetNetDriver() == nullptr)
+		{
+			UE_LOG(LogNS, Warning, TEXT("ns.Net.RespawnBench only runs on a server"));
+			return;
+		}
+
+		TSharedRef<FNSRespawnBenchRun> Run = MakeShareable(new FNSRespawnBenchRun());
+		Run->World = World;
+		Run->Respawns = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 64;
+		Run->Done = 0;
+		Run->Failed = 0;
+		Run->Phase = 0;
+		Run->Elapsed = 0.0f;
+		Run->RespawnSeconds = 0.0f;
+		Run->IdleBunchesPerSecond = 0.0;
+
+		for (FConstControllerIterator Iter = World->GetControllerIterator(); Iter; ++Iter)
+		{
+			if (Iter->IsValid() && Cast<ANSPlayerState>((*Iter)->PlayerState) != nullptr)
+			{
+				Run->Controllers.Add(Iter->Get());
+			}
+		}
+
+		int32 Connections = 0;
+		Run->StartBunches = GetReliableBunchesSent(World, Connections);
+		if (Run->Controllers.Num() == 0 || Connections == 0)
+		{
+			UE_LOG(LogNS, Warning, TEXT("ns.Net.RespawnBench needs players and connected clients"));
+			return;
+		}
+
+		UE_LOG(LogNS, Log, TEXT("ns.Net.RespawnBench: %d respawns among %d players with %d clients, after %.0f s of idle traffic"),
+			Run->Respawns, Run->Controllers.Num(), Connections, RespawnBenchWindowSeconds);
+
+		FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([Run](float DeltaTime)
+		{
+			return TickRespawnBench(DeltaTime, Run);
+		}));
+	}));
 
 ANSGameMode::ANSGameMode()
 	: Super()
@@ -17,15 +200,47 @@ ANSGameMode::ANSGameMode()
 	DefaultPawnClass = PlayerPawnClassFinder.Class;
 	PlayerStateClass = ANSPlayerState::StaticClass();
 
-	/**
-	* TODO - Hace que el atributo GameState se inicialice
-	*       con el GameState que hemos creado.
-	*/
+	// El GameState lleva el gestor de cadveres, que existe en servidor y clientes
+	GameStateClass = ANSGameState::StaticClass();
 
 	// use our custom HUD class
 	HUDClass = ANSHUD::StaticClass();
 
+	// Recibe los efectos que el filtro de inters le enva
+	PlayerControllerClass = ANSPlayerController::StaticClass();
+
 	bReplicates = true;
+
+	NumBots = 0;
+	BotThinkBudgetMs = 1.0f;
+	bParallelBotScoring = true;
+
+	RespawnDelay = 3.0f;
+	SpawnProtectionTime = 2.0f;
+
+	// Past the default net cull distance the characters are not relevant anyway
+	InterestAudibleRange = 4000.0f;
+	InterestVisibleRange = 10000.0f;
+	InterestLowFidelityRange = 15000.0f;
+	InterestViewConeDegrees = 120.0f;
+
+	MaxShotOriginError = 500.0f;
+
+	ServerTickRate = 60;
+	MaxSimulationSubSteps = 4;
+	MinNetUpdateScale = 0.25f;
+
+	bCheatDetection = true;
+	const FNSCheatSettings CheatDefaults;
+	CheatSnapDegrees = CheatDefaults.SnapDegrees;
+	CheatMinReactionSeconds = CheatDefaults.MinReactionSeconds;
+	CheatMaxInhumanSnaps = CheatDefaults.MaxInhumanSnaps;
+	CheatMaxHitRatio = CheatDefaults.MaxHitRatio;
+	CheatSpeedTolerance = CheatDefaults.SpeedTolerance;
+
+	HostFrameBudgetMs = 1000.0f / 60.0f;
+	HostSimBudgetMs = 4.0f;
+	HostMinScreenPercentage = 50;
 }
 
 void ANSGameMode::BeginPlay()
@@ -38,6 +253,37 @@ void ANSGameMode::BeginPlay()
 	*/
 	if (Role == ROLE_Authority)
 	{
+		Interest.Settings.AudibleRange = InterestAudibleRange;
+		Interest.Settings.VisibleRange = InterestVisibleRange;
+		Interest.Settings.LowFidelityRange = InterestLowFidelityRange;
+		Interest.Settings.ViewConeDegrees = InterestViewConeDegrees;
+		Tasks.MaxShotOriginError = MaxShotOriginError;
+		ServerClock.Configure(ServerTickRate, MaxSimulationSubSteps, MinNetUpdateScale);
+		HostBudget.Configure(HostFrameBudgetMs, HostSimBudgetMs, HostMinScreenPercentage);
+		HostBudget.SetActive(GetNetMode() == NM_ListenServer);
+
+		FNSMatchStats::BeginMatch();
+
+		if (bCheatDetection)
+		{
+			CheatDetector.Settings.SnapDegrees = CheatSnapDegrees;
+			CheatDetector.Settings.MinReactionSeconds = CheatMinReactionSeconds;
+			CheatDetector.Settings.MaxInhumanSnaps = CheatMaxInhumanSnaps;
+			CheatDetector.Settings.MaxHitRatio = CheatMaxHitRatio;
+			CheatDetector.Settings.SpeedTolerance = CheatSpeedTolerance;
+			CheatDetector.Start();
+		}
+
+		if (FParse::Param(FCommandLine::Get(), TEXT("nsalloc")))
+		{
+			FNSAllocTracker::Enable();
+		}
+
+		// Los equipos crecen hasta el mximo de jugadores, reservamos ya para no realojar al entrar
+		const int32 MaxTeamSize = (GameSession != nullptr ? GameSession->MaxPlayers : 16) + NumBots;
+		RedTeam.Reserve(MaxTeamSize);
+		BlueTeam.Reserve(MaxTeamSize);
+
 		for (TActorIterator<ANSSPawnPoint> Iter(GetWorld()); Iter; ++Iter)
 		{
 			if ((*Iter)->Team == ETeam::RED_TEAM)
@@ -50,16 +296,9 @@ void ANSGameMode::BeginPlay()
 			}
 		}
 
-		// Spawn the server
-		APlayerController* thisCont = GetWorld()->GetFirstPlayerController();
-
-		if (thisCont)
+		for (int32 i = 0; i < NumBots; ++i)
 		{
-			ANSCharacter* thisChar = Cast<ANSCharacter>(thisCont->GetPawn());
-
-			thisChar->SetTeam(ETeam::BLUE_TEAM);
-			BlueTeam.Add(thisChar);
-			Spawn(thisChar);
+			AddBot();
 		}
 
 		/**
@@ -74,6 +313,13 @@ void ANSGameMode::BeginPlay()
 
 void ANSGameMode::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
+	// Las estadsticas sobreviven al ServerTravel en disco
+	const ANSGameState* GS = GetGameState<ANSGameState>();
+	FNSMatchStats::EndMatch(GS != nullptr ? GS->RedScore : 0, GS != nullptr ? GS->BlueScore : 0);
+
+	CheatDetector.Stop();
+	HostBudget.SetActive(false);
+
 	if (EndPlayReason == EEndPlayReason::Quit ||
 		EndPlayReason == EEndPlayReason::EndPlayInEditor)
 	{
@@ -87,44 +333,104 @@ void ANSGameMode::Tick(float DeltaSeconds)
 	* TODO - Comprobar que slo el servidor puede ejecutar todas las instrucciones
 	*        de este mtodo.
 	*/
-	if (Role = ROLE_Authority)
+	if (Role == ROLE_Authority)
 	{
-		APlayerController* thisCont = GetWorld()->GetFirstPlayerController();
+		// Los bots tienen su propio presupuesto, el del anfitrin slo cubre la simulacin
+		BotScheduler.Tick(GetWorld(), BotThinkBudgetMs / 1000.0f, bParallelBotScoring);
 
-		if (ToBeSpawned.Num() != 0)
+		HostBudget.BeginSimulation();
+
+		// La simulacin avanza en pasos fijos, independientes de los frames del servidor
+		const int32 Steps = ServerClock.Advance(DeltaSeconds);
+		const float StepSeconds = ServerClock.GetStepSeconds(DeltaSeconds);
+		for (int32 Step = 0; Step < Steps; ++Step)
 		{
-			for (auto charToSpawn : ToBeSpawned)
+			// En un servidor local, los pasos que no caben en su presupuesto esperan al siguiente frame
+			if (Step > 0 && !HostBudget.HasSimulationTime())
 			{
-				Spawn(charToSpawn);
+				ServerClock.Defer(Steps - Step);
+				break;
 			}
+			SimulateStep(StepSeconds);
 		}
 
-		if (thisCont != nullptr && thisCont->IsInputKeyDown(EKeys::R))
+		HostBudget.EndSimulation(DeltaSeconds);
+
+		if (ServerClock.UpdateNetUpdateScale(DeltaSeconds))
 		{
-			bInGameMenu = false;
-			GetWorld()->ServerTravel(L"/Game/FirstPersonCPP/Maps/FirstPersonExampleMap?Listen");
+			ApplyNetUpdateScale(ServerClock.GetNetUpdateScale());
+		}
 
-			/**
-			* TODO - Asignar al atributo creado en el GameState,
-			*        el atributo de esta clase que indica si estamos
-			*        en el men o no.
-			*/
-			//Cast<ANSGameState>(GameState)->????;
+		FNSNetStats::Tick();
+		FNSMatchStats::Tick();
+
+		if (CheatDetector.IsRunning())
+		{
+			SampleCheatViews();
+
+			CheatDetector.ConsumeFlags([this](const FNSCheatFlag& Flag)
+			{
+				static const TCHAR* FlagNames[] = { TEXT("snap aim"), TEXT("hit ratio"), TEXT("speed") };
+				static_assert(ARRAY_COUNT(FlagNames) == (int32)ENSCheatFlag::Count, "Missing cheat flag names");
+
+				const APlayerState* const* Player = GameState->PlayerArray.FindByPredicate([&Flag](const APlayerState* PS)
+				{
+					return PS != nullptr && PS->PlayerId == Flag.PlayerId;
+				});
+				UE_LOG(LogNS, Warning, TEXT("Cheat detector: %s flagged for %s (%.2f)"),
+					Player != nullptr ? *(*Player)->PlayerName : TEXT("<gone>"), FlagNames[(int32)Flag.Type], Flag.Value);
+			});
 		}
 	}
 }
 
+void ANSGameMode::RestartMatch()
+{
+	if (Role == ROLE_Authority)
+	{
+		bInGameMenu = false;
+		GetWorld()->ServerTravel(L"/Game/FirstPersonCPP/Maps/FirstPersonExampleMap?Listen");
+
+		/**
+		* TODO - Asignar al atributo creado en el GameState,
+		*        el atributo de esta clase que indica si estamos
+		*        en el men o no.
+		*/
+		//Cast<ANSGameState>(GameState)->????;
+	}
+}
+
 void ANSGameMode::PostLogin(APlayerController* NewPlayer)
 {
+	// Con la partida empezada, Super llega a RestartPlayer y el jugador ya tiene equipo
 	Super::PostLogin(NewPlayer);
 
-	ANSCharacter* Teamless = Cast<ANSCharacter>(NewPlayer->GetPawn());
+	/**
+	* Quien se une a una partida empezada recibe de una vez los jugadores,
+	*        equipos, puntuaciones y personajes vivos, sin esperar a que
+	*        la replicacin abra cada actor.
+	*/
+	ANSPlayerController* NSController = Cast<ANSPlayerController>(NewPlayer);
+	if (NSController != nullptr && !NSController->IsLocalController())
+	{
+		TArray<uint8> Snapshot;
+		FNSMatchSnapshot::Write(GetWorld(), Snapshot);
+		NSController->ClientMatchSnapshot(Snapshot);
+		FNSNetStats::Record(ENSNetEvent::ClientMatchSnapshot, NSController->GetNetConnection(), FNSNetStats::RPCHeaderBytes + 4 + Snapshot.Num());
+	}
+}
+
+void ANSGameMode::RestartPlayer(AController* NewPlayer)
+{
+	Super::RestartPlayer(NewPlayer);
 
 	/**
-	* Obtener el ANSPlayerState del nuevo jugador que se ha unido.
-	*
+	* Todos los jugadores, el anfitrin y los de pantalla partida incluidos,
+	*        reciben aqu su primer personaje, al empezar la partida o al
+	*        unirse a ella. Los bots y las reapariciones crean el suyo.
 	*/
-	ANSPlayerState* NPlayerState = Teamless->GetNSPlayerState();
+	ANSCharacter* Teamless = Cast<ANSCharacter>(NewPlayer->GetPawn());
+	ANSPlayerState* NPlayerState = Cast<ANSPlayerState>(NewPlayer->PlayerState);
 
 	if (Teamless != nullptr && NPlayerState != nullptr)
 	{
@@ -136,90 +442,130 @@ void ANSGameMode::PostLogin(APlayerController* NewPlayer)
 	*        generar al jugador en la partida.
 	*/
 
-	if (Role== ROLE_Authority && Teamless != nullptr)
+	if (Role== ROLE_Authority && Teamless != nullptr && NPlayerState != nullptr &&
+		!RedTeam.Contains(Teamless) && !BlueTeam.Contains(Teamless))
 	{
-		/**
-		* Si el equipo azul tiene ms jugadores que el equipo rojo
-		*        asignaremos al jugador al equipo rojo. Hay que asignar el
-		*        equipo al ANSPlayerState.
-		*/
-		if (RedTeam.Num() <= BlueTeam.Num())
-		{
-			RedTeam.Add(Teamless);
-			NPlayerState->Team = ETeam::RED_TEAM;
-		}
-		else
-		{
-			BlueTeam.Add(Teamless);
-			NPlayerState->Team = ETeam::BLUE_TEAM;
-		}
-
 		// Assign Team and spawn
-		Teamless->SetTeam(NPlayerState->Team);
+		AssignTeam(Teamless, NPlayerState);
 		Spawn(Teamless);
 	}
 }
 
-void ANSGameMode::Spawn(class ANSCharacter* Character)
+void ANSGameMode::AssignTeam(class ANSCharacter* Character, class ANSPlayerState* NSPlayerState)
 {
+	NS_PERF_SCOPE(TeamAssignment);
+
 	/**
-	*Comprobar que somos el servidor cuando queramos
-	*        generar al jugador en la partida.
+	* Si el equipo azul tiene ms jugadores que el equipo rojo
+	*        asignaremos al jugador al equipo rojo. Hay que asignar el
+	*        equipo al ANSPlayerState.
 	*/
+	if (RedTeam.Num() <= BlueTeam.Num())
+	{
+		RedTeam.Add(Character);
+		NSPlayerState->Team = ETeam::RED_TEAM;
+	}
+	else
+	{
+		BlueTeam.Add(Character);
+		NSPlayerState->Team = ETeam::BLUE_TEAM;
+	}
 
-	if (Role == ROLE_Authority)
+	Character->SetTeam(NSPlayerState->Team);
+
+	ANSGameState* NSGameState = GetGameState<ANSGameState>();
+	if (NSGameState != nullptr)
 	{
-		// Find Spawn point that is not blocked
-		ANSSPawnPoint* thisSpawn = nullptr;
-		TArray<ANSSPawnPoint*>* targetTeam = nullptr;
+		NSGameState->NotifyScoreboardChanged();
+	}
+}
 
-		/**
-		* Segn el equipo del personaje, lo asignamos a la
-		*        cola de generacin de personajes del equipo correspondiente.
-		*/
-		
-		if (Character->GetNSPlayerState()->Team == ETeam::BLUE_TEAM)
-		{
-			targetTeam = &BlueSpawns;
-		}
-		else
-		{
-			targetTeam = &RedSpawns;
-		}
+ANSBotController* ANSGameMode::AddBot()
+{
+	if (Role != ROLE_Authority)
+	{
+		return nullptr;
+	}
 
+	FActorSpawnParameters SpawnInfo;
+	SpawnInfo.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
 
-		//Spawn points 
-		for (auto Spawn : (*targetTeam))
-		{
-			if (!Spawn->GetBlocked())
-			{
-				// Remove from spawn queue location
-				if (ToBeSpawned.Find(Character) != INDEX_NONE)
-				{
-					ToBeSpawned.Remove(Character);
-				}
+	ANSBotController* Bot = GetWorld()->SpawnActor<ANSBotController>(ANSBotController::StaticClass(), SpawnInfo);
+	ANSCharacter* BotChar = Cast<ANSCharacter>(GetWorld()->SpawnActor(DefaultPawnClass, nullptr, nullptr, SpawnInfo));
 
-				// Otherwise set actor location
-				Character->SetActorLocation(Spawn->
-					GetActorLocation());
+	if (Bot == nullptr || BotChar == nullptr)
+	{
+		return nullptr;
+	}
 
-				Spawn->UpdateOverlaps();
+	Bot->Possess(BotChar);
 
-				return;
-			}
-		}
+	ANSPlayerState* BotPS = Cast<ANSPlayerState>(Bot->PlayerState);
+	if (BotPS == nullptr)
+	{
+		return nullptr;
+	}
 
-		if (ToBeSpawned.Find(Character) == INDEX_NONE)
-		{
-			ToBeSpawned.Add(Character);
-		}
+	BotPS->bIsABot = true;
+	BotPS->SetPlayerName(FString::Printf(TEXT("Bot %d"), BotScheduler.Num() + 1));
+	BotChar->SetNSPlayerState(BotPS);
+
+	AssignTeam(BotChar, BotPS);
+	Spawn(BotChar);
+
+	BotScheduler.AddBot(Bot);
+
+	return Bot;
+}
+
+bool ANSGameMode::RemoveBot()
+{
+	if (Role != ROLE_Authority)
+	{
+		return false;
+	}
+
+	TActorIterator<ANSBotController> Iter(GetWorld());
+	if (!Iter)
+	{
+		return false;
+	}
+
+	// El personaje deja su equipo en EndPlay y el planificador olvida al bot destruido
+	ANSBotController* Bot = *Iter;
+	APawn* BotPawn = Bot->GetPawn();
+	Bot->UnPossess();
+	if (BotPawn != nullptr)
+	{
+		BotPawn->Destroy();
+	}
+	BotScheduler.RemoveBot(Bot);
+	Bot->Destroy();
+	return true;
+}
+
+void ANSGameMode::Spawn(class ANSCharacter* Character)
+{
+	/**
+	*Comprobar que somos el servidor cuando queramos
+	*        generar al jugador en la partida.
+	*/
+
+	if (Role == ROLE_Authority)
+	{
+		/**
+		* Los puntos de aparicin del equipo se puntan en paralelo en el
+		*        siguiente tick, y el personaje espera en la cola mientras
+		*        estn todos bloqueados.
+		*/
+		Tasks.QueueSpawn(Character);
 	}
 
 	
 }
 
 
-void ANSGameMode::Respawn(class ANSCharacter* Character)
+void ANSGameMode::Respawn(AController* Controller)
 {
 	/**
 	* TODO - Comprobar que somos el servidor cuando queramos
@@ -227,23 +573,42 @@ void ANSGameMode::Respawn(class ANSCharacter* Character)
 	*/
 	if (Role == ROLE_Authority)
 	{
-		AController* thisPC = Character->GetController();
-		Character->DetachFromControllerPendingDestroy();
+		NS_PERF_SCOPE(Respawn);
+
+		AController* thisPC = Controller;
+		ANSPlayerState* thisPS = thisPC != nullptr ? Cast<ANSPlayerState>(thisPC->PlayerState) : nullptr;
+		if (thisPS == nullptr)
+		{
+			return;
+		}
+
+		// The corpse may already be gone, the team lives in the player state
+		ANSCharacter* Character = Cast<ANSCharacter>(thisPC->GetPawn());
+		if (Character != nullptr)
+		{
+			Character->DetachFromControllerPendingDestroy();
+		}
 
 		ANSCharacter* newChar = Cast<ANSCharacter>(GetWorld()->SpawnActor(DefaultPawnClass));
 
 		if (newChar)
 		{
 			thisPC->Possess(newChar);
-			ANSPlayerState* thisPS = Cast<ANSPlayerState>(newChar->GetController()->PlayerState);
 
 			/**
-			* Asignar el equipo y el ANSPlayerState al nuevo personaje.
+			* Asignar el ANSPlayerState al nuevo personaje.
 			*/
-			thisPS->Team = Character->GetNSPlayerState()->Team;		
 			newChar->SetNSPlayerState(thisPS);
 
+			// El cuerpo anterior queda al gestor de cadveres, los equipos apuntan al nuevo
+			TArray<class ANSCharacter*>& TeamMembers = thisPS->Team == ETeam::RED_TEAM ? RedTeam : BlueTeam;
+			TeamMembers.Remove(Character);
+			TeamMembers.Add(newChar);
+
 			Spawn(newChar);
+
+			newChar->bSpawnProtected = true;
+			Timers.Schedule(SpawnProtectionTime, thisPC->GetUniqueID(), (uint8)ENSTimerType::SpawnProtectionEnd, newChar);
 			
 			/**
 			* Usar la funcin SetTeam para indicar a todos los jugadores
@@ -254,3 +619,144 @@ void ANSGameMode::Respawn(class ANSCharacter* Character)
 	}
 
 }
+
+
+void ANSGameMode::ScheduleRespawn(class ANSCharacter* Character)
+{
+	AController* Controller = Character->GetController();
+
+	if (Role == ROLE_Authority && Controller != nullptr)
+	{
+		Timers.Schedule(RespawnDelay, Controller->GetUniqueID(), (uint8)ENSTimerType::Respawn, Controller);
+	}
+}
+
+void ANSGameMode::OnTimerExpired(uint8 Type, uint32 OwnerId, UObject* Target)
+{
+	switch ((ENSTimerType)Type)
+	{
+	case ENSTimerType::Respawn:
+	{
+		// Keyed by controller: the corpse may have been removed before the delay ends
+		Respawn(Cast<AController>(Target));
+		break;
+	}
+	case ENSTimerType::SpawnProtectionEnd:
+	{
+		ANSCharacter* Character = Cast<ANSCharacter>(Target);
+		if (Character != nullptr)
+		{
+			Character->bSpawnProtected = false;
+		}
+		break;
+	}
+	}
+}
+
+void ANSGameMode::RemoveCharacter(ANSCharacter* Character)
+{
+	RedTeam.Remove(Character);
+	BlueTeam.Remove(Character);
+	Tasks.CancelSpawn(Character);
+	Tasks.CancelShots(Character);
+}
+
+void ANSGameMode::Logout(AController* Exiting)
+{
+	// Los temporizadores pendientes del jugador se cancelan al desconectarse
+	Timers.CancelOwner(Exiting->GetUniqueID());
+	Interest.Invalidate();
+
+	ANSCharacter* ExitingChar = Cast<ANSCharacter>(Exiting->GetPawn());
+	if (ExitingChar != nullptr)
+	{
+		RemoveCharacter(ExitingChar);
+	}
+
+	ANSBotController* Bot = Cast<ANSBotController>(Exiting);
+	if (Bot != nullptr)
+	{
+		BotScheduler.RemoveBot(Bot);
+	}
+
+	if (Exiting->PlayerState != nullptr)
+	{
+		CheatDetector.RemovePlayer(Exiting->PlayerState->PlayerId);
+	}
+
+	Super::Logout(Exiting);
+}
+
+
+void ANSGameMode::SendShotEffects(class ANSCharacter* Shooter)
+{
+	const FVector Location = Shooter->GetActorLocation();
+
+	Interest.ForEachInterested(GetWorld(), Location, Shooter->CurrentTeam, [Shooter, &Location](ANSPlayerController* Controller, ENSInterest Level)
+	{
+		// Actor references go as a NetGUID, locations quantized
+		if (Level == ENSInterest::Full)
+		{
+			Controller->ClientShootEffects(Shooter);
+			FNSNetStats::Record(ENSNetEvent::ClientShootEffects, Controller->GetNetConnection(), FNSNetStats::RPCHeaderBytes + 4);
+		}
+		else
+		{
+			Controller->ClientDistantShot(Location);
+			FNSNetStats::Record(ENSNetEvent::ClientDistantShot, Controller->GetNetConnection(), FNSNetStats::RPCHeaderBytes + 6);
+		}
+	});
+}
+
+void ANSGameMode::SendRagdoll(class ANSCharacter* Victim)
+{
+	Interest.ForEachInterested(GetWorld(), Victim->GetActorLocation(), Victim->CurrentTeam, [Victim](ANSPlayerController* Controller, ENSInterest Level)
+	{
+		Controller->ClientRagdoll(Victim, Level == ENSInterest::Full);
+		FNSNetStats::Record(ENSNetEvent::ClientRagdoll, Controller->GetNetConnection(), FNSNetStats::RPCHeaderBytes + 5);
+	});
+}
+
+void ANSGameMode::SimulateStep(float StepSeconds)
+{
+	Timers.Advance(StepSeconds, [this](uint8 Type, uint32 OwnerId, UObject* Target)
+	{
+		OnTimerExpired(Type, OwnerId, Target);
+	});
+
+	// Spawns, shots and projectiles queued until now, in parallel
+	Tasks.Tick(GetWorld(), StepSeconds, RedSpawns, BlueSpawns);
+}
+
+void ANSGameMode::ApplyNetUpdateScale(float Scale)
+{
+	for (TActorIterator<ANSCharacter> Iter(GetWorld()); Iter; ++Iter)
+	{
+		const ANSCharacter* Defaults = Iter->GetClass()->GetDefaultObject<ANSCharacter>();
+		Iter->NetUpdateFrequency = FMath::Max(Defaults->NetUpdateFrequency * Scale, Defaults->MinNetUpdateFrequency);
+	}
+}
+
+void ANSGameMode::SampleCheatViews()
+{
+	const float Now = GetWorld()->GetTimeSeconds();
+
+	for (const TArray<class ANSCharacter*>* Team : { &RedTeam, &BlueTeam })
+	{
+		for (ANSCharacter* Character : *Team)
+		{
+			const ANSPlayerState* PS = Character->GetNSPlayerState();
+			AController* Controller = Character->GetController();
+			if (PS == nullptr || PS->bIsABot || PS->Health <= 0 || Controller == nullptr)
+			{
+				continue;
+			}
+
+			// Walking, crouching, swimming and flying have their own limit, falling has none
+			const UCharacterMovementComponent* Movement = Character->GetCharacterMovement();
+			const float MaxSpeed = Movement->IsFalling() ? 0.0f : Movement->GetMaxSpeed();
+
+			CheatDetector.AddView(PS->PlayerId, Now, Character->GetActorLocation(), Controller->GetControlRotation().Vector(), MaxSpeed);
+		}
+	}
+}
@@ -1,6 +1,13 @@
 // Copyright 1998-2016 Epic Games, Inc. All Rights Reserved.
 #pragma once
 #include "GameFramework/GameMode.h"
+#include "NSBotScheduler.h"
+#include "NSTimerWheel.h"
+#include "NSInterestGrid.h"
+#include "NSGameTasks.h"
+#include "NSServerClock.h"
+#include "NSCheatDetector.h"
+#include "NSHostBudget.h"
 #include "NSGameMode.generated.h"
 
 UENUM(BlueprintType)
@@ -21,18 +28,177 @@ public:
 	virtual void BeginPlay() override;
 	virtual void Tick(float DeltaSeconds) override;
 	virtual void PostLogin(APlayerController* NewPlayer) override;
+	virtual void RestartPlayer(AController* NewPlayer) override;
 	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	virtual void Logout(AController* Exiting) override;
 
-	void Respawn(class ANSCharacter* Character);
+	/** Travels to a new match, asked by a local player of a listen server */
+	void RestartMatch();
+
+	/** Gives the controller a new character, whether or not its corpse is still around */
+	void Respawn(AController* Controller);
 	void Spawn(class ANSCharacter* Character);
 
+	/** Forgets a character leaving play: teams, queued spawn and queued shots */
+	void RemoveCharacter(class ANSCharacter* Character);
+
+	/** Respawns the character's controller after RespawnDelay seconds */
+	void ScheduleRespawn(class ANSCharacter* Character);
+
+	/** Seconds between death and respawn */
+	UPROPERTY(Config)
+	float RespawnDelay;
+
+	/** Seconds a respawned character ignores damage */
+	UPROPERTY(Config)
+	float SpawnProtectionTime;
+
+	/** Spawns a server-side bot and puts it in the smaller team */
+	class ANSBotController* AddBot();
+
+	/** Destroys one bot and its character. Returns false if there are none */
+	bool RemoveBot();
+
+	const FNSBotScheduler& GetBotScheduler() const { return BotScheduler; }
+
+	/** Bots spawned when the match begins */
+	UPROPERTY(Config)
+	int32 NumBots;
+
+	/** Game thread time, in milliseconds, all bots may spend thinking each frame */
+	UPROPERTY(Config)
+	float BotThinkBudgetMs;
+
+	/** Score bot targets on worker threads */
+	UPROPERTY(Config)
+	bool bParallelBotScoring;
+
+	/** Sends the shot effects of Shooter to the remote players that can see or hear them, a distant sound to the rest in range */
+	void SendShotEffects(class ANSCharacter* Shooter);
+
+	/** Sends the death of Victim to the remote players in range, as ragdoll only to those that may see it */
+	void SendRagdoll(class ANSCharacter* Victim);
+
+	/** Cosmetic events closer than this are always sent in full */
+	UPROPERTY(Config)
+	float InterestAudibleRange;
+
+	/** Cosmetic events closer than this are sent in full when in view or from a teammate */
+	UPROPERTY(Config)
+	float InterestVisibleRange;
+
+	/** Cosmetic events closer than this get a low fidelity version, farther ones are not sent */
+	UPROPERTY(Config)
+	float InterestLowFidelityRange;
+
+	/** Full angle, in degrees, of the view cone used for the visibility test */
+	UPROPERTY(Config)
+	float InterestViewConeDegrees;
+
+	/** Farthest, in cm, a fire request may start from the shooter's eyes before it is rejected */
+	UPROPERTY(Config)
+	float MaxShotOriginError;
+
+	/** Parallel phase of the frame: spawn scoring, shot validation and projectile movement */
+	FNSGameTasks& GetTasks() { return Tasks; }
+
+	/**
+	 * Simulation steps per second, usually 30, 60 or 128. 0 runs one step per server frame.
+	 * Spawn and fire requests and timers wait for the next step, several frames when the server runs faster than the tick rate
+	 */
+	UPROPERTY(Config)
+	int32 ServerTickRate;
+
+	/** Steps a slow frame may catch up on, the rest of the time is dropped */
+	UPROPERTY(Config)
+	int32 MaxSimulationSubSteps;
+
+	/** Lowest fraction of their NetUpdateFrequency characters drop to while the server falls behind */
+	UPROPERTY(Config)
+	float MinNetUpdateScale;
+
+	/** Aim and movement anomaly detection of human players, flags are logged */
+	FNSCheatDetector& GetCheatDetector() { return CheatDetector; }
+
+	/** Characters of a team, inspected by ns.Mem.Report */
+	const TArray<class ANSCharacter*>& GetTeamMembers(ETeam Team) const { return Team == ETeam::RED_TEAM ? RedTeam : BlueTeam; }
+
+	UPROPERTY(Config)
+	bool bCheatDetection;
+
+	/** See FNSCheatSettings */
+	UPROPERTY(Config)
+	float CheatSnapDegrees;
+
+	UPROPERTY(Config)
+	float CheatMinReactionSeconds;
+
+	UPROPERTY(Config)
+	int32 CheatMaxInhumanSnaps;
+
+	UPROPERTY(Config)
+	float CheatMaxHitRatio;
+
+	/** Multiplier over the movement component's max speed for the current mode */
+	UPROPERTY(Config)
+	float CheatSpeedTolerance;
+
+	/** Frame split between simulation and local rendering on a listen server */
+	FNSHostBudget& GetHostBudget() { return HostBudget; }
+
+	/** Frame time, in milliseconds, a listen server host aims for */
+	UPROPERTY(Config)
+	float HostFrameBudgetMs;
+
+	/** Part of the host frame, in milliseconds, the simulation may take. The local views get the rest. Bot thinking is not included */
+	UPROPERTY(Config)
+	float HostSimBudgetMs;
+
+	/** Lowest screen percentage the local views drop to when over their budget */
+	UPROPERTY(Config)
+	int32 HostMinScreenPercentage;
+
 private:
+	/** Puts the character in the smaller team and tells every client */
+	void AssignTeam(class ANSCharacter* Character, class ANSPlayerState* NSPlayerState);
+
+	FNSBotScheduler BotScheduler;
+
+	enum class ENSTimerType : uint8
+	{
+		Respawn,
+		SpawnProtectionEnd
+	};
+
+	void OnTimerExpired(uint8 Type, uint32 OwnerId, UObject* Target);
+
+	/** Respawn and spawn protection timers of every player, keyed by controller */
+	FNSTimerWheel Timers;
+
+	/** Remote players bucketed by view location, for cosmetic events */
+	FNSInterestGrid Interest;
+
+	FNSGameTasks Tasks;
+
+	FNSServerClock ServerClock;
+
+	FNSCheatDetector CheatDetector;
+
+	FNSHostBudget HostBudget;
+
+	/** Sends the view of every living human character to the cheat detector */
+	void SampleCheatViews();
+
+	/** One step of timers, fire processing and projectiles. What was queued since the last step runs here */
+	void SimulateStep(float StepSeconds);
+
+	void ApplyNetUpdateScale(float Scale);
+
 	TArray<class ANSCharacter*> RedTeam;
 	TArray<class ANSCharacter*> BlueTeam;
 
 	TArray<class ANSSPawnPoint*> RedSpawns;
 	TArray<class ANSSPawnPoint*> BlueSpawns;
-	TArray<class ANSCharacter*> ToBeSpawned;
 
 	bool bGameStarted;
 	bool bInGameMenu;
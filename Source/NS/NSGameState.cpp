@@ -2,7 +2,280 @@
 
 #include "NS.h"
 #include "NSGameState.h"
+#include "NSPlayerState.h"
+#include "NSCharacter.h"
+#include "NSPerfTracker.h"
+#include "Net/UnrealNetwork.h"
 
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Physics Step (ms)"), STAT_NSPhysicsStep, STATGROUP_NS);
 
+static TAutoConsoleVariable<int32> CVarCorpseLogStats(
+	TEXT("ns.Corpses.LogStats"),
+	0,
+	TEXT("Logs corpse count, simulating ragdolls and physics step time every 5 seconds."));
 
+void FNSPhysicsTimerTickFunction::ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent)
+{
+	if (Target != nullptr && !Target->IsPendingKill())
+	{
+		Target->OnPhysicsTimer(bEndOfPhysics);
+	}
+}
 
+FString FNSPhysicsTimerTickFunction::DiagnosticMessage()
+{
+	return bEndOfPhysics ? TEXT("FNSPhysicsTimerTickFunction[End]") : TEXT("FNSPhysicsTimerTickFunction[Start]");
+}
+
+ANSGameState::ANSGameState()
+{
+	PrimaryActorTick.bCanEverTick = true;
+
+	MaxRagdolls = 8;
+	MaxCorpses = 32;
+	CorpseLifeSpan = 20.0f;
+	CorpseFadeTime = 2.0f;
+	CorpseCullDistance = 5000.0f;
+
+	PhysicsStartTime = 0.0;
+	PhysicsSeconds = 0.0;
+	PhysicsFrames = 0;
+	StatsTime = 0.0f;
+
+	CorpseBenchTime = 0.0f;
+	CorpseBenchDeaths = 0;
+	CorpseBenchPhysicsSeconds = 0.0;
+	CorpseBenchMaxStep = 0.0;
+	CorpseBenchFrames = 0;
+	CorpseBenchMaxSimulating = 0;
+	CorpseBenchMaxCorpses = 0;
+
+	RedScore = 0;
+	BlueScore = 0;
+	ScoreboardVersion = 0;
+	KillFeedVersion = 0;
+}
+
+void ANSGameState::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME(ANSGameState, RedScore);
+	DOREPLIFETIME(ANSGameState, BlueScore);
+	DOREPLIFETIME(ANSGameState, KillFeed);
+}
+
+void ANSGameState::AddPlayerState(APlayerState* PlayerState)
+{
+	Super::AddPlayerState(PlayerState);
+	NotifyScoreboardChanged();
+}
+
+void ANSGameState::RemovePlayerState(APlayerState* PlayerState)
+{
+	Super::RemovePlayerState(PlayerState);
+	NotifyScoreboardChanged();
+}
+
+void ANSGameState::AddKill(ANSPlayerState* Killer, ANSPlayerState* Victim)
+{
+	if (Role != ROLE_Authority || Killer == nullptr || Victim == nullptr)
+	{
+		return;
+	}
+
+	if (Killer->Team == ETeam::RED_TEAM)
+	{
+		RedScore++;
+	}
+	else
+	{
+		BlueScore++;
+	}
+
+	if (KillFeed.Num() >= MaxKillFeed)
+	{
+		KillFeed.RemoveAt(0);
+	}
+
+	FNSKillEvent& Kill = KillFeed[KillFeed.AddDefaulted()];
+	Kill.KillerName = Killer->PlayerName;
+	Kill.VictimName = Victim->PlayerName;
+	Kill.KillerTeam = Killer->Team;
+	Kill.VictimTeam = Victim->Team;
+
+	// OnRep functions do not run on the server, a listen host needs the bumps too
+	KillFeedVersion++;
+	NotifyScoreboardChanged();
+}
+
+void ANSGameState::OnRep_KillFeed()
+{
+	KillFeedVersion++;
+}
+
+void ANSGameState::BeginPlay()
+{
+	Super::BeginPlay();
+
+	CorpseManager.Settings.MaxRagdolls = MaxRagdolls;
+	CorpseManager.Settings.MaxCorpses = MaxCorpses;
+	CorpseManager.Settings.LifeSpan = CorpseLifeSpan;
+	CorpseManager.Settings.FadeTime = CorpseFadeTime;
+	CorpseManager.Settings.CullDistance = CorpseCullDistance;
+
+	StartPhysicsTimer.Target = this;
+	StartPhysicsTimer.bEndOfPhysics = false;
+	StartPhysicsTimer.bCanEverTick = true;
+	StartPhysicsTimer.TickGroup = TG_StartPhysics;
+	StartPhysicsTimer.RegisterTickFunction(GetLevel());
+
+	EndPhysicsTimer.Target = this;
+	EndPhysicsTimer.bEndOfPhysics = true;
+	EndPhysicsTimer.bCanEverTick = true;
+	EndPhysicsTimer.TickGroup = TG_EndPhysics;
+	EndPhysicsTimer.RegisterTickFunction(GetLevel());
+}
+
+void ANSGameState::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	StartPhysicsTimer.UnRegisterTickFunction();
+	EndPhysicsTimer.UnRegisterTickFunction();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void ANSGameState::OnPhysicsTimer(bool bEndOfPhysics)
+{
+	const double Now = FPlatformTime::Seconds();
+
+	if (!bEndOfPhysics)
+	{
+		PhysicsStartTime = Now;
+	}
+	else if (PhysicsStartTime > 0.0)
+	{
+		const double StepSeconds = Now - PhysicsStartTime;
+		PhysicsSeconds += StepSeconds;
+		PhysicsFrames++;
+
+		if (CorpseBenchTime > 0.0f)
+		{
+			CorpseBenchPhysicsSeconds += StepSeconds;
+			CorpseBenchMaxStep = FMath::Max(CorpseBenchMaxStep, StepSeconds);
+			CorpseBenchFrames++;
+		}
+
+		SET_FLOAT_STAT(STAT_NSPhysicsStep, StepSeconds * 1000.0);
+	}
+}
+
+void ANSGameState::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	CorpseManager.Tick(GetWorld(), DeltaSeconds);
+
+	// The game state ticks on the server and on every client, so both check their budgets
+	FNSMemoryReport::Tick(GetWorld(), MemoryCheck);
+
+	if (CorpseBenchTime > 0.0f)
+	{
+		TickCorpseBench(DeltaSeconds);
+	}
+
+	if (CVarCorpseLogStats.GetValueOnGameThread() != 0)
+	{
+		StatsTime += DeltaSeconds;
+		if (StatsTime >= 5.0f && PhysicsFrames > 0)
+		{
+			UE_LOG(LogNS, Log, TEXT("Corpses: %d, simulating ragdolls: %d, physics step %.3f ms"),
+				CorpseManager.Num(), CorpseManager.NumSimulating(), PhysicsSeconds * 1000.0 / PhysicsFrames);
+
+			StatsTime = 0.0f;
+			PhysicsSeconds = 0.0;
+			PhysicsFrames = 0;
+		}
+	}
+}
+
+void ANSGameState::StartCorpseBench(int32 Deaths, float Seconds)
+{
+	const AGameModeBase* GameMode = GetDefaultGameMode();
+	UClass* CharacterClass = GameMode != nullptr && GameMode->DefaultPawnClass != nullptr && GameMode->DefaultPawnClass->IsChildOf(ANSCharacter::StaticClass())
+		? *GameMode->DefaultPawnClass : ANSCharacter::StaticClass();
+
+	// In front of the view, so distance culling does not hide them
+	FVector ViewLocation = FVector::ZeroVector;
+	FRotator ViewRotation = FRotator::ZeroRotator;
+	APlayerController* LocalPC = GEngine->GetFirstLocalPlayerController(GetWorld());
+	if (LocalPC != nullptr)
+	{
+		LocalPC->GetPlayerViewPoint(ViewLocation, ViewRotation);
+	}
+	const FVector Center = ViewLocation + FRotator(0.0f, ViewRotation.Yaw, 0.0f).Vector() * 1000.0f;
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	FRandomStream Random(1234);
+
+	// The same path as a death: dedicated servers keep the corpse without simulating it
+	int32 Spawned = 0;
+	for (int32 i = 0; i < Deaths; ++i)
+	{
+		const FVector Location = Center + FVector(Random.FRandRange(-800.0f, 800.0f), Random.FRandRange(-800.0f, 800.0f), 200.0f);
+		ANSCharacter* Character = GetWorld()->SpawnActor<ANSCharacter>(CharacterClass, Location, FRotator(0.0f, Random.FRandRange(0.0f, 360.0f), 0.0f), SpawnParams);
+		if (Character != nullptr)
+		{
+			Character->BecomeCorpse(GetNetMode() != NM_DedicatedServer);
+			Spawned++;
+		}
+	}
+
+	CorpseBenchTime = FMath::Max(Seconds, 0.1f);
+	CorpseBenchDeaths = Spawned;
+	CorpseBenchPhysicsSeconds = 0.0;
+	CorpseBenchMaxStep = 0.0;
+	CorpseBenchFrames = 0;
+	CorpseBenchMaxSimulating = 0;
+	CorpseBenchMaxCorpses = 0;
+}
+
+void ANSGameState::TickCorpseBench(float DeltaSeconds)
+{
+	// Measured after the corpse manager ticked, which is what keeps them within budget
+	CorpseBenchMaxSimulating = FMath::Max(CorpseBenchMaxSimulating, CorpseManager.NumSimulating());
+	CorpseBenchMaxCorpses = FMath::Max(CorpseBenchMaxCorpses, CorpseManager.Num());
+
+	CorpseBenchTime -= DeltaSeconds;
+	if (CorpseBenchTime > 0.0f)
+	{
+		return;
+	}
+	CorpseBenchTime = 0.0f;
+
+	UE_LOG(LogNS, Log, TEXT("ns.Corpses.Bench %d deaths: physics step %.3f ms average, %.3f ms max over %d frames, at most %d ragdolls simulating and %d corpses"),
+		CorpseBenchDeaths, CorpseBenchFrames > 0 ? CorpseBenchPhysicsSeconds * 1000.0 / CorpseBenchFrames : 0.0, CorpseBenchMaxStep * 1000.0,
+		CorpseBenchFrames, CorpseBenchMaxSimulating, CorpseBenchMaxCorpses);
+
+	FNSPerfTracker::Expect(CorpseBenchMaxSimulating <= MaxRagdolls && CorpseBenchMaxCorpses <= MaxCorpses, TEXT("ns.Corpses.Bench"),
+		FString::Printf(TEXT("%d ragdolls simulating for a budget of %d, %d corpses for a budget of %d"),
+			CorpseBenchMaxSimulating, MaxRagdolls, CorpseBenchMaxCorpses, MaxCorpses));
+}
+
+static FAutoConsoleCommandWithWorldAndArgs CorpsesBenchCommand(
+	TEXT("ns.Corpses.Bench"),
+	TEXT("Kills D characters (default 100) in front of the view and logs the physics step time over S seconds (default 10). Fails if the ragdoll or corpse budgets are exceeded: ns.Corpses.Bench <D> <S>"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		ANSGameState* GameState = World != nullptr ? World->GetGameState<ANSGameState>() : nullptr;
+		if (GameState == nullptr)
+		{
+			UE_LOG(LogNS, Warning, TEXT("ns.Corpses.Bench needs an NS game state"));
+			return;
+		}
+
+		const int32 Deaths = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 100;
+		const float Seconds = Args.Num() > 1 ? FCString::Atof(*Args[1]) : 10.0f;
+		GameState->StartCorpseBench(Deaths, Seconds);
+	}));
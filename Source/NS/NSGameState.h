@@ -3,17 +3,153 @@
 #pragma once
 
 #include "GameFramework/GameState.h"
+#include "NSCorpseManager.h"
+#include "NSMemoryReport.h"
+#include "NSGameMode.h"
 #include "NSGameState.generated.h"
 
+/** Stamps the game thread time at the start or at the end of the physics step */
+USTRUCT()
+struct FNSPhysicsTimerTickFunction : public FTickFunction
+{
+	GENERATED_USTRUCT_BODY()
+
+	class ANSGameState* Target;
+
+	bool bEndOfPhysics;
+
+	virtual void ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent) override;
+
+	virtual FString DiagnosticMessage() override;
+};
+
+template<>
+struct TStructOpsTypeTraits<FNSPhysicsTimerTickFunction> : public TStructOpsTypeTraitsBase
+{
+	enum
+	{
+		WithCopy = false
+	};
+};
+
+/** One line of the kill feed */
+USTRUCT()
+struct FNSKillEvent
+{
+	GENERATED_USTRUCT_BODY()
+
+	UPROPERTY()
+	FString KillerName;
+
+	UPROPERTY()
+	FString VictimName;
+
+	UPROPERTY()
+	ETeam KillerTeam;
+
+	UPROPERTY()
+	ETeam VictimTeam;
+};
+
 /**
  * 
  */
-UCLASS()
+UCLASS(config=Game)
 class NS_API ANSGameState : public AGameState
 {
 	GENERATED_BODY()
-	
-	
-	
-	
+
+public:
+	ANSGameState();
+
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	virtual void Tick(float DeltaSeconds) override;
+
+	virtual void AddPlayerState(APlayerState* PlayerState) override;
+	virtual void RemovePlayerState(APlayerState* PlayerState) override;
+
+	FNSCorpseManager& GetCorpseManager() { return CorpseManager; }
+
+	/** Server only: adds the kill to the team score and the kill feed */
+	void AddKill(class ANSPlayerState* Killer, class ANSPlayerState* Victim);
+
+	/** Marks the scoreboard as dirty on this machine */
+	void NotifyScoreboardChanged() { ScoreboardVersion++; }
+
+	/** Local counters the HUD compares to know when to rebuild */
+	int32 GetScoreboardVersion() const { return ScoreboardVersion; }
+	int32 GetKillFeedVersion() const { return KillFeedVersion; }
+
+	UPROPERTY(Replicated)
+	int32 RedScore;
+
+	UPROPERTY(Replicated)
+	int32 BlueScore;
+
+	/** Latest kills, oldest first */
+	UPROPERTY(ReplicatedUsing = OnRep_KillFeed)
+	TArray<FNSKillEvent> KillFeed;
+
+	/** Kills kept in the feed */
+	static const int32 MaxKillFeed = 5;
+
+	/** Called by the physics timer tick functions */
+	void OnPhysicsTimer(bool bEndOfPhysics);
+
+	/** Kills Deaths characters in front of the local view and reports the physics step for Seconds. Used by ns.Corpses.Bench */
+	void StartCorpseBench(int32 Deaths, float Seconds);
+
+	/** Ragdolls allowed to simulate at the same time */
+	UPROPERTY(Config)
+	int32 MaxRagdolls;
+
+	/** Corpses kept in the level */
+	UPROPERTY(Config)
+	int32 MaxCorpses;
+
+	/** Seconds before a corpse starts fading */
+	UPROPERTY(Config)
+	float CorpseLifeSpan;
+
+	/** Seconds a corpse takes to fade */
+	UPROPERTY(Config)
+	float CorpseFadeTime;
+
+	/** Settled corpses farther than this from the local view fade right away */
+	UPROPERTY(Config)
+	float CorpseCullDistance;
+
+private:
+	UFUNCTION()
+	void OnRep_KillFeed();
+
+	int32 ScoreboardVersion;
+	int32 KillFeedVersion;
+
+	FNSCorpseManager CorpseManager;
+
+	/** Budget check of this world, separate from the other PIE worlds */
+	FNSMemoryCheckState MemoryCheck;
+
+	FNSPhysicsTimerTickFunction StartPhysicsTimer;
+	FNSPhysicsTimerTickFunction EndPhysicsTimer;
+
+	double PhysicsStartTime;
+
+	/** Physics step wall time, averaged for ns.Corpses.LogStats */
+	double PhysicsSeconds;
+	int32 PhysicsFrames;
+	float StatsTime;
+
+	/** Seconds left of ns.Corpses.Bench, 0 when not running */
+	float CorpseBenchTime;
+	int32 CorpseBenchDeaths;
+	double CorpseBenchPhysicsSeconds;
+	double CorpseBenchMaxStep;
+	int32 CorpseBenchFrames;
+	int32 CorpseBenchMaxSimulating;
+	int32 CorpseBenchMaxCorpses;
+
+	void TickCorpseBench(float DeltaSeconds);
 };
@@ -0,0 +1,767 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "NS.h"
+#include "NSGameTasks.h"
+#include "NSCharacter.h"
+#include "NSPlayerState.h"
+#include "NSProjectile.h"
+#include "NSSPawnPoint.h"
+#include "NSPerfTracker.h"
+#include "NSAllocTracker.h"
+#include "NSMatchStats.h"
+#include "NSShotTrace.h"
+#include "NSWeaponDefinition.h"
+#include "GameFramework/ProjectileMovementComponent.h"
+#include "HAL/ThreadSingleton.h"
+
+DECLARE_CYCLE_STAT(TEXT("Tasks Wait"), STAT_NSTasksWait, STATGROUP_NS);
+DECLARE_CYCLE_STAT(TEXT("Tasks Apply"), STAT_NSTasksApply, STATGROUP_NS);
+DECLARE_CYCLE_STAT(TEXT("Tasks Snapshot"), STAT_NSTasksSnapshot, STATGROUP_NS);
+DECLARE_CYCLE_STAT(TEXT("Spawn Scoring"), STAT_NSSpawnScoring, STATGROUP_NS);
+DECLARE_CYCLE_STAT(TEXT("Shot Validation"), STAT_NSShotValidation, STATGROUP_NS);
+DECLARE_CYCLE_STAT(TEXT("Projectile Sweeps"), STAT_NSProjectileSweeps, STATGROUP_NS);
+DECLARE_CYCLE_STAT(TEXT("Explosion Queries"), STAT_NSExplosionQueries, STATGROUP_NS);
+DECLARE_CYCLE_STAT(TEXT("Explosion Damage"), STAT_NSExplosionDamage, STATGROUP_NS);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Explosions"), STAT_NSExplosions, STATGROUP_NS);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Rejected Shots"), STAT_NSRejectedShots, STATGROUP_NS);
+
+static TAutoConsoleVariable<int32> CVarTaskWorkers(
+	TEXT("ns.Tasks.Workers"),
+	0,
+	TEXT("Task graph tasks each parallel gameplay job is split into. 0 uses one per task graph worker thread."));
+
+static int32 WorkersOverride = 0;
+
+/** Splits [0, Num) into one task per worker, started once Prerequisites are done */
+template<typename BodyType>
+static void DispatchRange(int32 Num, const FGraphEventArray* Prerequisites, TStatId StatId, FGraphEventArray& OutEvents, BodyType Body)
+{
+	if (Num == 0)
+	{
+		return;
+	}
+
+	const int32 ChunkSize = FMath::DivideAndRoundUp(Num, FNSGameTasks::GetNumWorkers());
+	for (int32 Start = 0; Start < Num; Start += ChunkSize)
+	{
+		const int32 End = FMath::Min(Start + ChunkSize, Num);
+		OutEvents.Add(FFunctionGraphTask::CreateAndDispatchWhenReady([Body, Start, End]()
+		{
+			for (int32 Index = Start; Index < End; ++Index)
+			{
+				Body(Index);
+			}
+		}, StatId, Prerequisites));
+	}
+}
+
+/** Overlaps of the last explosion query issued by this thread */
+class FNSOverlapBuffer : public TThreadSingleton<FNSOverlapBuffer>
+{
+public:
+	FNSOverlapBuffer()
+	{
+		Overlaps.Reserve(64);
+	}
+
+	TArray<FOverlapResult> Overlaps;
+};
+
+/** Uniform point in the box of half size Extent around the origin */
+static FVector RandomPointInExtent(const FRandomStream& Random, const FVector& Extent)
+{
+	return FVector(Random.FRandRange(-Extent.X, Extent.X), Random.FRandRange(-Extent.Y, Extent.Y), Random.FRandRange(-Extent.Z, Extent.Z));
+}
+
+FNSGameTasks::FNSGameTasks()
+	: MaxShotOriginError(500.0f)
+{
+}
+
+int32 FNSGameTasks::GetNumWorkers()
+{
+	if (WorkersOverride > 0)
+	{
+		return WorkersOverride;
+	}
+
+	const int32 Workers = CVarTaskWorkers.GetValueOnGameThread();
+	return Workers > 0 ? Workers : FMath::Max(FTaskGraphInterface::Get().GetNumWorkerThreads(), 1);
+}
+
+void FNSGameTasks::SetWorkersOverride(int32 NumWorkers)
+{
+	WorkersOverride = NumWorkers;
+}
+
+void FNSGameTasks::QueueSpawn(ANSCharacter* Character)
+{
+	SpawnQueue.AddUnique(Character);
+}
+
+void FNSGameTasks::CancelSpawn(ANSCharacter* Character)
+{
+	SpawnQueue.Remove(Character);
+}
+
+void FNSGameTasks::QueueShot(ANSCharacter* Shooter, const FVector& Origin, const FVector& End)
+{
+	FShot& Shot = Shots[Shots.AddDefaulted()];
+	Shot.Shooter = Shooter;
+	Shot.Origin = Origin;
+	Shot.End = End;
+	Shot.bValid = false;
+}
+
+void FNSGameTasks::CancelShots(ANSCharacter* Shooter)
+{
+	Shots.RemoveAll([Shooter](const FShot& Shot) { return Shot.Shooter == Shooter; });
+}
+
+void FNSGameTasks::AddProjectile(ANSProjectile* Projectile)
+{
+	Projectiles.Add(Projectile);
+}
+
+void FNSGameTasks::RemoveProjectile(ANSProjectile* Projectile)
+{
+	Projectiles.RemoveSwap(Projectile);
+}
+
+void FNSGameTasks::QueueExplosion(ANSCharacter* Instigator, ETeam Team, const UNSWeaponDefinition* Weapon, const FVector& Location)
+{
+	FExplosion& Explosion = Explosions[Explosions.AddDefaulted()];
+	Explosion.Instigator = Instigator;
+	Explosion.InstigatorController = Instigator != nullptr ? Instigator->GetController() : nullptr;
+	Explosion.Weapon = Weapon;
+	Explosion.Location = Location;
+	Explosion.Team = Team;
+}
+
+void FNSGameTasks::ScoreSpawn(FSpawnCandidate& Candidate, const TArray<FCharacterSnapshot>& Snapshots)
+{
+	if (Candidate.bBlocked)
+	{
+		Candidate.Score = -1.0f;
+		return;
+	}
+
+	// The farther from the closest enemy, the better
+	Candidate.Score = MAX_flt;
+	for (const FCharacterSnapshot& Snapshot : Snapshots)
+	{
+		if (Snapshot.bAlive && Snapshot.Team != Candidate.Team)
+		{
+			Candidate.Score = FMath::Min(Candidate.Score, FVector::DistSquared(Snapshot.Location, Candidate.Location));
+		}
+	}
+}
+
+void FNSGameTasks::ValidateShot(FShot& Shot, float MaxOriginError)
+{
+	Shot.bValid = Shot.bShooterAlive
+		&& !Shot.Origin.ContainsNaN() && !Shot.End.ContainsNaN()
+		&& FVector::DistSquared(Shot.Origin, Shot.ShooterEyes) <= FMath::Square(MaxOriginError)
+		&& !(Shot.End - Shot.Origin).IsNearlyZero();
+}
+
+void FNSGameTasks::SweepProjectile(UWorld* World, FProjectileStep& Step, float DeltaSeconds)
+{
+	// Same integration as UProjectileMovementComponent: average of the old and new velocity
+	Step.NewVelocity = Step.Velocity + FVector(0.0f, 0.0f, Step.GravityZ * DeltaSeconds);
+	Step.End = Step.Start + (Step.Velocity + Step.NewVelocity) * 0.5f * DeltaSeconds;
+
+	// Scene queries only take the physics read lock, so they may run on any thread
+	Step.bHit = World->SweepSingleByChannel(Step.Hit, Step.Start, Step.End, FQuat::Identity, Step.Channel, Step.Shape, Step.QueryParams, Step.ResponseParams);
+}
+
+void FNSGameTasks::ResolveExplosion(UWorld* World, FExplosion& Explosion, const TArray<FExplosionTarget>& Targets)
+{
+	static const FCollisionQueryParams QueryParams(FName(TEXT("NSExplosion")), false);
+	static const FCollisionObjectQueryParams OcclusionQuery(ECC_TO_BITFIELD(ECC_WorldStatic) | ECC_TO_BITFIELD(ECC_WorldDynamic));
+
+	// Characters live on their team's object channel, so the scene only reports enemies in range
+	const ETeam EnemyTeam = Explosion.Team == ETeam::RED_TEAM ? ETeam::BLUE_TEAM : ETeam::RED_TEAM;
+	const FCollisionObjectQueryParams VictimQuery(ECC_TO_BITFIELD(FNSShotTrace::GetTeamChannel(EnemyTeam)));
+
+	TArray<FOverlapResult>& Overlaps = FNSOverlapBuffer::Get().Overlaps;
+	Overlaps.Reset();
+	World->OverlapMultiByObjectType(Overlaps, Explosion.Location, FQuat::Identity, VictimQuery, FCollisionShape::MakeSphere(Explosion.Weapon->ExplosionRadius), QueryParams);
+
+	Explosion.Victims.Reset();
+	for (const FOverlapResult& Overlap : Overlaps)
+	{
+		// Matched by index and serial number, the overlapping actor is never dereferenced here
+		const int32 TargetIndex = Targets.IndexOfByPredicate([&Overlap](const FExplosionTarget& Target) { return Target.Actor.HasSameIndexAndSerialNumber(Overlap.Actor); });
+
+		// The capsule and the mesh both overlap, one victim per character
+		if (TargetIndex == INDEX_NONE || Explosion.Victims.ContainsByPredicate([TargetIndex](const FExplosionVictim& Other) { return Other.Target == TargetIndex; }))
+		{
+			continue;
+		}
+
+		const FExplosionTarget& Target = Targets[TargetIndex];
+
+		FExplosionVictim& Victim = Explosion.Victims[Explosion.Victims.AddDefaulted()];
+		Victim.Target = TargetIndex;
+		Victim.Distance = FMath::Max(FVector::Dist(Explosion.Location, Target.Location) - Target.CapsuleRadius, 0.0f);
+
+		// Walls shield the victim, other characters do not
+		Victim.bOccluded = World->LineTraceTestByObjectType(Explosion.Location, Target.Location, OcclusionQuery, QueryParams);
+	}
+}
+
+void FNSGameTasks::SnapshotExplosionTargets(UWorld* World, TArray<FExplosionTarget>& OutTargets)
+{
+	OutTargets.Reset();
+	for (TActorIterator<ANSCharacter> Iter(World); Iter; ++Iter)
+	{
+		FExplosionTarget& Target = OutTargets[OutTargets.AddDefaulted()];
+		Target.Actor = *Iter;
+		Target.Character = *Iter;
+		Target.Location = Iter->GetActorLocation();
+		Target.CapsuleRadius = Iter->GetCapsuleComponent()->GetScaledCapsuleRadius();
+	}
+}
+
+void FNSGameTasks::Snapshot(UWorld* World, const TArray<ANSSPawnPoint*>& RedSpawns, const TArray<ANSSPawnPoint*>& BlueSpawns)
+{
+	SCOPE_CYCLE_COUNTER(STAT_NSTasksSnapshot);
+
+	CharacterSnapshots.Reset();
+	SpawnCandidates.Reset();
+	if (SpawnQueue.Num() > 0)
+	{
+		for (TActorIterator<ANSCharacter> Iter(World); Iter; ++Iter)
+		{
+			const ANSPlayerState* PS = Iter->GetNSPlayerState();
+
+			FCharacterSnapshot& Snapshot = CharacterSnapshots[CharacterSnapshots.AddUninitialized()];
+			Snapshot.Location = Iter->GetActorLocation();
+			Snapshot.Team = PS != nullptr ? PS->Team : ETeam::BLUE_TEAM;
+			Snapshot.bAlive = PS != nullptr && PS->Health > 0 && !Iter->IsPendingKill();
+		}
+
+		for (const TArray<ANSSPawnPoint*>* Spawns : { &RedSpawns, &BlueSpawns })
+		{
+			for (ANSSPawnPoint* SpawnPoint : *Spawns)
+			{
+				FSpawnCandidate& Candidate = SpawnCandidates[SpawnCandidates.AddUninitialized()];
+				Candidate.SpawnPoint = SpawnPoint;
+				Candidate.Location = SpawnPoint->GetActorLocation();
+				Candidate.Team = SpawnPoint->Team;
+				Candidate.bBlocked = SpawnPoint->GetBlocked();
+			}
+		}
+	}
+
+	// A shooter destroyed since it fired fails validation and is skipped when applying
+	for (FShot& Shot : Shots)
+	{
+		const ANSCharacter* Shooter = Shot.Shooter.Get();
+		const ANSPlayerState* PS = Shooter != nullptr ? Shooter->GetNSPlayerState() : nullptr;
+		Shot.ShooterEyes = Shooter != nullptr ? Shooter->GetPawnViewLocation() : FVector::ZeroVector;
+		Shot.bShooterAlive = PS != nullptr && PS->Health > 0 && !Shooter->IsPendingKill();
+	}
+
+	ExplosionTargets.Reset();
+	if (Explosions.Num() > 0)
+	{
+		SnapshotExplosionTargets(World, ExplosionTargets);
+	}
+
+	const float GravityZ = World->GetGravityZ();
+	ProjectileSteps.Reset();
+	for (ANSProjectile* Projectile : Projectiles)
+	{
+		USphereComponent* Collision = Projectile->GetCollisionComp();
+		UProjectileMovementComponent* Movement = Projectile->GetProjectileMovement();
+
+		FProjectileStep& Step = ProjectileSteps[ProjectileSteps.AddDefaulted()];
+		Step.Projectile = Projectile;
+		Step.Start = Projectile->GetActorLocation();
+		Step.Velocity = Movement->Velocity;
+		Step.GravityZ = GravityZ * Movement->ProjectileGravityScale;
+		Step.Shape = Collision->GetCollisionShape();
+		Step.Channel = Collision->GetCollisionObjectType();
+		Step.QueryParams = FCollisionQueryParams(NAME_None, false, Projectile);
+		Step.QueryParams.AddIgnoredActor(Projectile->Instigator);
+		Step.ResponseParams = FCollisionResponseParams(Collision->GetCollisionResponseToChannels());
+	}
+}
+
+void FNSGameTasks::Tick(UWorld* World, float DeltaSeconds, const TArray<ANSSPawnPoint*>& RedSpawns, const TArray<ANSSPawnPoint*>& BlueSpawns)
+{
+	if (SpawnQueue.Num() == 0 && Shots.Num() == 0 && Projectiles.Num() == 0 && Explosions.Num() == 0)
+	{
+		return;
+	}
+
+	NS_ALLOC_SCOPE(GameTasks);
+
+	// Game thread: copy what the jobs will work on out of the actors
+	Snapshot(World, RedSpawns, BlueSpawns);
+
+	// Workers: only the copies and scene queries from here to the sync point
+	FGraphEventArray Events;
+	DispatchRange(SpawnCandidates.Num(), nullptr, GET_STATID(STAT_NSSpawnScoring), Events, [this](int32 Index)
+	{
+		ScoreSpawn(SpawnCandidates[Index], CharacterSnapshots);
+	});
+
+	const float MaxOriginError = MaxShotOriginError;
+	DispatchRange(Shots.Num(), nullptr, GET_STATID(STAT_NSShotValidation), Events, [this, MaxOriginError](int32 Index)
+	{
+		ValidateShot(Shots[Index], MaxOriginError);
+	});
+
+	DispatchRange(ProjectileSteps.Num(), nullptr, GET_STATID(STAT_NSProjectileSweeps), Events, [this, World, DeltaSeconds](int32 Index)
+	{
+		SweepProjectile(World, ProjectileSteps[Index], DeltaSeconds);
+	});
+
+	// Every explosion of the step at once, whatever explodes while applying waits for the next one
+	const int32 NumExplosions = Explosions.Num();
+	DispatchRange(NumExplosions, nullptr, GET_STATID(STAT_NSExplosionQueries), Events, [this, World](int32 Index)
+	{
+		ResolveExplosion(World, Explosions[Index], ExplosionTargets);
+	});
+
+	// Sync point: nothing below runs until every job is done
+	{
+		SCOPE_CYCLE_COUNTER(STAT_NSTasksWait);
+		FTaskGraphInterface::Get().WaitUntilTasksComplete(Events, ENamedThreads::GameThread);
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_NSTasksApply);
+	ApplySpawns();
+	ApplyShots();
+	ApplyExplosions(NumExplosions);
+	ApplyProjectiles(DeltaSeconds);
+}
+
+void FNSGameTasks::ApplySpawns()
+{
+	if (SpawnQueue.Num() == 0)
+	{
+		return;
+	}
+
+	NS_PERF_SCOPE(SpawnSelection);
+
+	for (int32 i = 0; i < SpawnQueue.Num(); ++i)
+	{
+		ANSCharacter* Character = SpawnQueue[i].Get();
+		if (Character == nullptr || Character->IsPendingKill())
+		{
+			SpawnQueue.RemoveAt(i--);
+			continue;
+		}
+
+		const ANSPlayerState* PS = Character->GetNSPlayerState();
+		if (PS == nullptr)
+		{
+			continue;
+		}
+
+		FSpawnCandidate* Best = nullptr;
+		for (FSpawnCandidate& Candidate : SpawnCandidates)
+		{
+			if (Candidate.Team == PS->Team && Candidate.Score >= 0.0f && (Best == nullptr || Candidate.Score > Best->Score))
+			{
+				Best = &Candidate;
+			}
+		}
+
+		// Every spawn point of the team is blocked, try again next frame
+		if (Best == nullptr)
+		{
+			continue;
+		}
+
+		Character->SetActorLocation(Best->Location);
+		Best->SpawnPoint->UpdateOverlaps();
+		Best->Score = -1.0f;
+
+		FNSMatchStats::Record(ENSStatsEvent::Spawn, PS);
+
+		// The teleport is not a speed violation
+		ANSGameMode* GameMode = Character->GetWorld()->GetAuthGameMode<ANSGameMode>();
+		if (GameMode != nullptr)
+		{
+			GameMode->GetCheatDetector().ResetPlayer(PS->PlayerId);
+		}
+
+		SpawnQueue.RemoveAt(i--);
+	}
+}
+
+void FNSGameTasks::ApplyShots()
+{
+	int32 Rejected = 0;
+
+	for (const FShot& Shot : Shots)
+	{
+		if (!Shot.bValid)
+		{
+			Rejected++;
+			continue;
+		}
+
+		ANSCharacter* Shooter = Shot.Shooter.Get();
+		if (Shooter != nullptr && !Shooter->IsPendingKill())
+		{
+			Shooter->ProcessShot(Shot.Origin, Shot.End);
+		}
+	}
+
+	Shots.Reset();
+	SET_DWORD_STAT(STAT_NSRejectedShots, Rejected);
+}
+
+void FNSGameTasks::ApplyExplosions(int32 NumResolved)
+{
+	SET_DWORD_STAT(STAT_NSExplosions, NumResolved);
+	if (NumResolved == 0)
+	{
+		return;
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_NSExplosionDamage);
+
+	for (int32 i = 0; i < NumResolved; ++i)
+	{
+		const FExplosion& Explosion = Explosions[i];
+
+		FNSShotDamageList Damages;
+		for (const FExplosionVictim& Victim : Explosion.Victims)
+		{
+			// The victim may have left or been destroyed since the query, a ragdoll may still
+			// overlap, and an earlier explosion of the step may have killed the victim
+			ANSCharacter* Character = ExplosionTargets[Victim.Target].Character.Get();
+			if (Character == nullptr)
+			{
+				continue;
+			}
+			const ANSPlayerState* PS = Character->GetNSPlayerState();
+			if (PS == nullptr || PS->Health <= 0.0f)
+			{
+				continue;
+			}
+
+			const float Damage = Victim.bOccluded ? 0.0f : Explosion.Weapon->GetExplosionDamageAt(Victim.Distance);
+			if (Damage > 0.0f)
+			{
+				Damages.Add({ Character, Damage });
+			}
+		}
+
+		// Through the shooter like a shot, so stats, kill credit and team score follow the same rules
+		// If the shooter is gone, through the character its player controls now if it is still on the team
+		ANSCharacter* Instigator = Explosion.Instigator.Get();
+		AController* InstigatorController = Explosion.InstigatorController.Get();
+		if (Instigator == nullptr && InstigatorController != nullptr)
+		{
+			ANSCharacter* Current = Cast<ANSCharacter>(InstigatorController->GetPawn());
+			if (Current != nullptr && !Current->IsPendingKill() && Current->CurrentTeam == Explosion.Team)
+			{
+				Instigator = Current;
+			}
+		}
+		if (Instigator != nullptr)
+		{
+			Instigator->ApplyExplosionDamage(Damages);
+			continue;
+		}
+
+		for (const FNSShotDamage& Hit : Damages)
+		{
+			FDamageEvent DamageEvent(UDamageType::StaticClass());
+			Hit.Victim->TakeDamage(Hit.Damage, DamageEvent, InstigatorController, nullptr);
+		}
+	}
+
+	Explosions.RemoveAt(0, NumResolved, false);
+}
+
+void FNSGameTasks::ApplyProjectiles(float DeltaSeconds)
+{
+	for (FProjectileStep& Step : ProjectileSteps)
+	{
+		ANSProjectile* Projectile = Step.Projectile;
+		if (Projectile->IsPendingKill())
+		{
+			continue;
+		}
+
+		UProjectileMovementComponent* Movement = Projectile->GetProjectileMovement();
+		if (Movement->MaxSpeed > 0.0f)
+		{
+			Step.NewVelocity = Step.NewVelocity.GetClampedToMaxSize(Movement->MaxSpeed);
+		}
+
+		if (!Step.bHit)
+		{
+			Projectile->SetActorLocationAndRotation(Step.End, Step.NewVelocity.Rotation());
+			Movement->Velocity = Step.NewVelocity;
+			Movement->UpdateComponentVelocity();
+			continue;
+		}
+
+		// The rest of the step after the hit is dropped, at most one frame of travel
+		FVector HitLocation = Step.Hit.Location;
+		if (Step.Hit.bStartPenetrating)
+		{
+			HitLocation += Step.Hit.Normal * (Step.Hit.PenetrationDepth + 0.1f);
+		}
+		Projectile->SetActorLocation(HitLocation);
+		Movement->Velocity = Step.NewVelocity;
+		Movement->UpdateComponentVelocity();
+
+		Projectile->GetCollisionComp()->DispatchBlockingHit(*Projectile, Step.Hit);
+		if (Projectile->IsPendingKill())
+		{
+			continue;
+		}
+
+		const FVector Bounced = Movement->bShouldBounce ? Step.NewVelocity.MirrorByVector(Step.Hit.Normal) * Movement->Bounciness : FVector::ZeroVector;
+		if (Bounced.Size() < Movement->BounceVelocityStopSimulatingThreshold)
+		{
+			// At rest until its life span runs out
+			Movement->Velocity = FVector::ZeroVector;
+			Movement->UpdateComponentVelocity();
+			RemoveProjectile(Projectile);
+			continue;
+		}
+
+		Movement->Velocity = Bounced;
+		Movement->UpdateComponentVelocity();
+		Projectile->SetActorRotation(Bounced.Rotation());
+	}
+}
+
+static FAutoConsoleCommandWithWorldAndArgs TasksBenchCommand(
+	TEXT("ns.Tasks.Bench"),
+	TEXT("Runs a synthetic server frame of 64 characters, 256 spawn points, 1024 shots and 512 projectile sweeps with each job split into 1, 4 and 16 tasks, logs its time and fails if the split changes the results: ns.Tasks.Bench <Frames>"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (World == nullptr)
+		{
+			return;
+		}
+
+		const int32 Frames = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 100;
+		FRandomStream Random(1234);
+		const FVector Extent(10000.0f, 10000.0f, 500.0f);
+
+		TArray<FNSGameTasks::FCharacterSnapshot> Characters;
+		Characters.SetNumUninitialized(64);
+		for (int32 i = 0; i < Characters.Num(); ++i)
+		{
+			Characters[i].Location = RandomPointInExtent(Random, Extent);
+			Characters[i].Team = (i % 2) == 0 ? ETeam::RED_TEAM : ETeam::BLUE_TEAM;
+			Characters[i].bAlive = true;
+		}
+
+		TArray<FNSGameTasks::FSpawnCandidate> Spawns;
+		Spawns.SetNumUninitialized(256);
+		for (int32 i = 0; i < Spawns.Num(); ++i)
+		{
+			Spawns[i].SpawnPoint = nullptr;
+			Spawns[i].Location = RandomPointInExtent(Random, Extent);
+			Spawns[i].Team = (i % 2) == 0 ? ETeam::RED_TEAM : ETeam::BLUE_TEAM;
+			Spawns[i].bBlocked = (i % 7) == 0;
+		}
+
+		TArray<FNSGameTasks::FShot> Shots;
+		Shots.SetNum(1024);
+		for (FNSGameTasks::FShot& Shot : Shots)
+		{
+			Shot.ShooterEyes = RandomPointInExtent(Random, Extent);
+			Shot.Origin = Shot.ShooterEyes + Random.GetUnitVector() * 100.0f;
+			Shot.End = Shot.Origin + Random.GetUnitVector() * 10000000.0f;
+			Shot.bShooterAlive = true;
+		}
+
+		TArray<FNSGameTasks::FProjectileStep> Steps;
+		Steps.SetNum(512);
+		for (FNSGameTasks::FProjectileStep& Step : Steps)
+		{
+			Step.Start = RandomPointInExtent(Random, Extent);
+			Step.Velocity = Random.GetUnitVector() * 3000.0f;
+			Step.GravityZ = World->GetGravityZ();
+			Step.Shape = FCollisionShape::MakeSphere(5.0f);
+			Step.Channel = ECC_WorldDynamic;
+		}
+
+		const float DeltaSeconds = 1.0f / 30.0f;
+
+		// The split is only a task count, the task graph runs them on the threads it has
+		bool bFirstPass = true;
+		double FirstScores = 0.0;
+		int32 FirstValid = 0;
+		int32 FirstHits = 0;
+		for (int32 NumTasks : { 1, 4, 16 })
+		{
+			FNSGameTasks::SetWorkersOverride(NumTasks);
+
+			const double Start = FPlatformTime::Seconds();
+			for (int32 Frame = 0; Frame < Frames; ++Frame)
+			{
+				FGraphEventArray Events;
+				DispatchRange(Spawns.Num(), nullptr, GET_STATID(STAT_NSSpawnScoring), Events, [&Spawns, &Characters](int32 Index)
+				{
+					FNSGameTasks::ScoreSpawn(Spawns[Index], Characters);
+				});
+				DispatchRange(Shots.Num(), nullptr, GET_STATID(STAT_NSShotValidation), Events, [&Shots](int32 Index)
+				{
+					FNSGameTasks::ValidateShot(Shots[Index], 500.0f);
+				});
+				DispatchRange(Steps.Num(), nullptr, GET_STATID(STAT_NSProjectileSweeps), Events, [&Steps, World, DeltaSeconds](int32 Index)
+				{
+					FNSGameTasks::SweepProjectile(World, Steps[Index], DeltaSeconds);
+				});
+				FTaskGraphInterface::Get().WaitUntilTasksComplete(Events, ENamedThreads::GameThread);
+			}
+			const double Seconds = FPlatformTime::Seconds() - Start;
+
+			UE_LOG(LogNS, Log, TEXT("Tasks bench, %d tasks per job on %d task graph threads: %.3f ms per frame over %d frames"),
+				NumTasks, FTaskGraphInterface::Get().GetNumWorkerThreads(), Seconds * 1000.0 / Frames, Frames);
+
+			double Scores = 0.0;
+			for (const FNSGameTasks::FSpawnCandidate& Spawn : Spawns)
+			{
+				Scores += Spawn.Score;
+			}
+			int32 Valid = 0;
+			for (const FNSGameTasks::FShot& Shot : Shots)
+			{
+				Valid += Shot.bValid ? 1 : 0;
+			}
+			int32 Hits = 0;
+			for (const FNSGameTasks::FProjectileStep& Step : Steps)
+			{
+				Hits += Step.bHit ? 1 : 0;
+			}
+
+			if (bFirstPass)
+			{
+				bFirstPass = false;
+				FirstScores = Scores;
+				FirstValid = Valid;
+				FirstHits = Hits;
+				continue;
+			}
+
+			FNSPerfTracker::Expect(Scores == FirstScores && Valid == FirstValid && Hits == FirstHits, TEXT("ns.Tasks.Bench"),
+				FString::Printf(TEXT("%d tasks per job: score sum %.1f, %d valid shots, %d sweep hits; 1 task: %.1f, %d, %d"),
+					NumTasks, Scores, Valid, Hits, FirstScores, FirstValid, FirstHits));
+		}
+
+		FNSGameTasks::SetWorkersOverride(0);
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs ExplosionBenchCommand(
+	TEXT("ns.Fire.ExplosionBench"),
+	TEXT("Spawns N characters (default 64), half per team, and resolves E simultaneous explosions among them (default 100) over F frames (default 100), on one task and on every worker. No damage is applied: ns.Fire.ExplosionBench <E> <N> <F>"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		AGameModeBase* GameMode = World != nullptr ? World->GetAuthGameMode() : nullptr;
+		if (GameMode == nullptr)
+		{
+			UE_LOG(LogNS, Warning, TEXT("ns.Fire.ExplosionBench only runs on the server"));
+			return;
+		}
+
+		const int32 NumExplosions = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 100;
+		const int32 NumCharacters = Args.Num() > 1 ? FMath::Max(FCString::Atoi(*Args[1]), 1) : 64;
+		const int32 Frames = Args.Num() > 2 ? FMath::Max(FCString::Atoi(*Args[2]), 1) : 100;
+
+		UClass* CharacterClass = GameMode->DefaultPawnClass != nullptr && GameMode->DefaultPawnClass->IsChildOf(ANSCharacter::StaticClass())
+			? *GameMode->DefaultPawnClass : ANSCharacter::StaticClass();
+
+		// High above the level, 3 m apart, so each explosion reaches a few characters
+		const FVector Start(0.0f, 0.0f, 100000.0f);
+		const float Spacing = 300.0f;
+		FActorSpawnParameters SpawnParams;
+		SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+		TArray<ANSCharacter*> Crowd;
+		for (int32 i = 0; i < NumCharacters; ++i)
+		{
+			const FVector Location = Start + FVector(Spacing * (i % 8), Spacing * (i / 8), 0.0f);
+			ANSCharacter* Character = World->SpawnActor<ANSCharacter>(CharacterClass, Location, FRotator::ZeroRotator, SpawnParams);
+			if (Character != nullptr)
+			{
+				Character->SetTeam((i % 2) == 0 ? ETeam::RED_TEAM : ETeam::BLUE_TEAM);
+				Crowd.Add(Character);
+			}
+		}
+
+		if (Crowd.Num() == 0)
+		{
+			UE_LOG(LogNS, Warning, TEXT("ns.Fire.ExplosionBench could not spawn the characters"));
+			return;
+		}
+
+		// Lives for this command only, nothing collects it before we return
+		UNSWeaponDefinition* Weapon = NewObject<UNSWeaponDefinition>();
+		Weapon->ExplosionRadius = 500.0f;
+
+		// Anywhere over the grid of characters
+		const int32 Rows = FMath::DivideAndRoundUp(Crowd.Num(), 8);
+		const FVector Centre = Start + FVector(Spacing * 3.5f, Spacing * (Rows - 1) * 0.5f, 0.0f);
+		const FVector Extent(Spacing * 4.0f, Spacing * Rows * 0.5f, 100.0f);
+
+		TArray<FNSGameTasks::FExplosionTarget> Targets;
+		FNSGameTasks::SnapshotExplosionTargets(World, Targets);
+
+		FRandomStream Random(1234);
+		TArray<FNSGameTasks::FExplosion> Explosions;
+		Explosions.SetNum(NumExplosions);
+		for (int32 i = 0; i < Explosions.Num(); ++i)
+		{
+			Explosions[i].Weapon = Weapon;
+			Explosions[i].Location = Centre + RandomPointInExtent(Random, Extent);
+			Explosions[i].Team = (i % 2) == 0 ? ETeam::RED_TEAM : ETeam::BLUE_TEAM;
+		}
+
+		const int32 WorkerCounts[2] = { 1, FNSGameTasks::GetNumWorkers() };
+		double Seconds[2];
+		int32 Victims[2];
+		for (int32 Pass = 0; Pass < 2; ++Pass)
+		{
+			FNSGameTasks::SetWorkersOverride(WorkerCounts[Pass]);
+
+			const double StartTime = FPlatformTime::Seconds();
+			for (int32 Frame = 0; Frame < Frames; ++Frame)
+			{
+				FGraphEventArray Events;
+				DispatchRange(Explosions.Num(), nullptr, GET_STATID(STAT_NSExplosionQueries), Events, [&Explosions, &Targets, World](int32 Index)
+				{
+					FNSGameTasks::ResolveExplosion(World, Explosions[Index], Targets);
+				});
+				FTaskGraphInterface::Get().WaitUntilTasksComplete(Events, ENamedThreads::GameThread);
+			}
+			Seconds[Pass] = FPlatformTime::Seconds() - StartTime;
+
+			Victims[Pass] = 0;
+			for (const FNSGameTasks::FExplosion& Explosion : Explosions)
+			{
+				Victims[Pass] += Explosion.Victims.Num();
+			}
+		}
+		FNSGameTasks::SetWorkersOverride(0);
+
+		UE_LOG(LogNS, Log, TEXT("ns.Fire.ExplosionBench %d explosions among %d characters, %d victims: %.3f ms per frame on 1 task, %.3f ms on %d (%.1fx)"),
+			Explosions.Num(), Crowd.Num(), Victims[1], Seconds[0] * 1000.0 / Frames, Seconds[1] * 1000.0 / Frames, WorkerCounts[1],
+			Seconds[0] / FMath::Max(Seconds[1], 1e-9));
+
+		FNSPerfTracker::Expect(Victims[0] == Victims[1], TEXT("ns.Fire.ExplosionBench"),
+			FString::Printf(TEXT("one task and %d tasks found different victims, %d and %d"), WorkerCounts[1], Victims[0], Victims[1]));
+
+		for (ANSCharacter* Character : Crowd)
+		{
+			Character->Destroy();
+		}
+	}));
@@ -0,0 +1,173 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+enum class ETeam : uint8;
+
+/**
+ * Parallel phase of the server frame, run from the game mode tick.
+ *
+ * Spawn requests, fire requests, projectiles and explosions are collected
+ * during the frame and processed together. The game thread first copies
+ * everything the jobs read out of the actors, so the tasks never touch a
+ * UObject, except for the scene queries, whose results are only matched
+ * against those copies. It then waits for every task and
+ * only then moves actors, fires validated shots, applies explosion damage
+ * and projectile hits, so no job ever sees a half-applied frame. Each job is
+ * split into GetNumWorkers() task graph tasks.
+ *
+ * Queued requests wait for the next tick that runs, which with a fixed step
+ * clock may be several frames away. Characters are held weakly, a shooter or
+ * spawning character destroyed in between is dropped, and a player's queued
+ * shots are cancelled when it leaves.
+ */
+class FNSGameTasks
+{
+public:
+	FNSGameTasks();
+
+	/** Farthest, in cm, a fire request may start from the shooter's eyes. Covers latency and the camera offset */
+	float MaxShotOriginError;
+
+	/** Places the character on the best free spawn point of its team, waiting for one if they are all blocked */
+	void QueueSpawn(class ANSCharacter* Character);
+
+	void CancelSpawn(class ANSCharacter* Character);
+
+	/** Validates the shot with the rest of the frame's shots and fires it if it holds */
+	void QueueShot(class ANSCharacter* Shooter, const FVector& Origin, const FVector& End);
+
+	/** Drops the shots of Shooter still waiting for the next tick */
+	void CancelShots(class ANSCharacter* Shooter);
+
+	/** Takes over the movement of a server-side projectile */
+	void AddProjectile(class ANSProjectile* Projectile);
+
+	void RemoveProjectile(class ANSProjectile* Projectile);
+
+	/** Damages the enemies of Team around Location with Weapon's explosion, credited to Instigator */
+	void QueueExplosion(class ANSCharacter* Instigator, ETeam Team, const class UNSWeaponDefinition* Weapon, const FVector& Location);
+
+	void Tick(UWorld* World, float DeltaSeconds, const TArray<class ANSSPawnPoint*>& RedSpawns, const TArray<class ANSSPawnPoint*>& BlueSpawns);
+
+	/** Tasks each job is split into, from ns.Tasks.Workers */
+	static int32 GetNumWorkers();
+
+	/** Forces the task count, 0 goes back to ns.Tasks.Workers. Used by the benchmarks */
+	static void SetWorkersOverride(int32 NumWorkers);
+
+	struct FCharacterSnapshot
+	{
+		FVector Location;
+		ETeam Team;
+		bool bAlive;
+	};
+
+	struct FSpawnCandidate
+	{
+		class ANSSPawnPoint* SpawnPoint;
+		FVector Location;
+		ETeam Team;
+		bool bBlocked;
+
+		/** Squared distance to the closest living enemy, -1 when blocked */
+		float Score;
+	};
+
+	struct FShot
+	{
+		TWeakObjectPtr<class ANSCharacter> Shooter;
+		FVector Origin;
+		FVector End;
+		FVector ShooterEyes;
+		bool bShooterAlive;
+		bool bValid;
+	};
+
+	struct FProjectileStep
+	{
+		class ANSProjectile* Projectile;
+		FVector Start;
+		FVector Velocity;
+		float GravityZ;
+		FCollisionShape Shape;
+		ECollisionChannel Channel;
+		FCollisionQueryParams QueryParams;
+		FCollisionResponseParams ResponseParams;
+
+		FVector End;
+		FVector NewVelocity;
+		FHitResult Hit;
+		bool bHit;
+	};
+
+	/** A character explosions may reach, copied on the game thread */
+	struct FExplosionTarget
+	{
+		/** Only compared with the overlapping actors on the workers, never resolved there */
+		TWeakObjectPtr<AActor> Actor;
+
+		/** Resolved on the game thread when the damage is applied, the character may be gone by then */
+		TWeakObjectPtr<class ANSCharacter> Character;
+
+		FVector Location;
+		float CapsuleRadius;
+	};
+
+	struct FExplosionVictim
+	{
+		/** Index in the explosion targets of the frame */
+		int32 Target;
+
+		/** From the centre to the victim's capsule */
+		float Distance;
+
+		/** A wall between the centre and the victim */
+		bool bOccluded;
+	};
+
+	struct FExplosion
+	{
+		/** The shooter may be gone by the time its projectile explodes, its controller then gets the credit */
+		TWeakObjectPtr<class ANSCharacter> Instigator;
+		TWeakObjectPtr<class AController> InstigatorController;
+		const class UNSWeaponDefinition* Weapon;
+		FVector Location;
+		ETeam Team;
+
+		TArray<FExplosionVictim, TInlineAllocator<16>> Victims;
+	};
+
+	/** The jobs, on one element each. Safe to run on any thread */
+	static void ScoreSpawn(FSpawnCandidate& Candidate, const TArray<FCharacterSnapshot>& Characters);
+	static void ValidateShot(FShot& Shot, float MaxOriginError);
+	static void SweepProjectile(UWorld* World, FProjectileStep& Step, float DeltaSeconds);
+
+	/** One overlap query for the enemies in range, then one occlusion ray per enemy found among Targets */
+	static void ResolveExplosion(UWorld* World, FExplosion& Explosion, const TArray<FExplosionTarget>& Targets);
+
+	/** Game thread: every character of World an explosion may reach */
+	static void SnapshotExplosionTargets(UWorld* World, TArray<FExplosionTarget>& OutTargets);
+
+private:
+	/** Game thread: copies the state the jobs read out of the actors */
+	void Snapshot(UWorld* World, const TArray<class ANSSPawnPoint*>& RedSpawns, const TArray<class ANSSPawnPoint*>& BlueSpawns);
+
+	void ApplySpawns();
+	void ApplyShots();
+	void ApplyExplosions(int32 NumResolved);
+	void ApplyProjectiles(float DeltaSeconds);
+
+	TArray<TWeakObjectPtr<class ANSCharacter>> SpawnQueue;
+	TArray<class ANSProjectile*> Projectiles;
+
+	/** This frame's work */
+	TArray<FCharacterSnapshot> CharacterSnapshots;
+	TArray<FExplosionTarget> ExplosionTargets;
+	TArray<FSpawnCandidate> SpawnCandidates;
+	TArray<FShot> Shots;
+	TArray<FProjectileStep> ProjectileSteps;
+
+	/** Queued until the next tick, projectile hits add to it while the tick applies them */
+	TArray<FExplosion> Explosions;
+};
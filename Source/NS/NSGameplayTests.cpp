@@ -0,0 +1,411 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "NS.h"
+#include "NSGameMode.h"
+#include "NSGameTasks.h"
+#include "NSCharacter.h"
+#include "NSPlayerState.h"
+#include "NSBotController.h"
+#include "NSSPawnPoint.h"
+#include "Tests/AutomationCommon.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+/**
+ * Functional tests of the NS gameplay flows. They run headless on the default map:
+ *   UE4Editor NS -game -nullrhi -unattended -ExecCmds="Automation RunTests NS" -testexit="Automation Test Queue Empty"
+ * The flows go through the NS_PERF_SCOPE counters, so the same run also gates their timing against
+ * Config/NSPerfBaseline.ini when started with -nsperfquit and -ExecCmds="ns.Perf.Capture 120, Automation RunTests NS".
+ */
+
+static const int32 NSTestFlags = EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter;
+
+/** Auth game mode of the map opened by the test */
+static ANSGameMode* GetTestGameMode()
+{
+	for (const FWorldContext& Context : GEngine->GetWorldContexts())
+	{
+		UWorld* World = Context.World();
+		if (World != nullptr && (Context.WorldType == EWorldType::Game || Context.WorldType == EWorldType::PIE))
+		{
+			ANSGameMode* GameMode = World->GetAuthGameMode<ANSGameMode>();
+			if (GameMode != nullptr)
+			{
+				return GameMode;
+			}
+		}
+	}
+	return nullptr;
+}
+
+/** Every functional test starts from a freshly loaded default map */
+static bool OpenTestMap()
+{
+	FString Map;
+	GConfig->GetString(TEXT("/Script/EngineSettings.GameMapsSettings"), TEXT("GameDefaultMap"), Map, GEngineIni);
+	return AutomationOpenMap(Map);
+}
+
+/**
+ * One gameplay flow, stepped every frame on the opened map until Step returns true.
+ * Bots stand in for the players; the ones added by the test are removed when it ends.
+ */
+class FNSGameplayLatentCommand : public IAutomationLatentCommand
+{
+public:
+	FNSGameplayLatentCommand(FAutomationTestBase* InTest, float InTimeout)
+		: Test(InTest)
+		, Timeout(InTimeout)
+		, Stage(0)
+	{
+	}
+
+	virtual bool Update() override
+	{
+		ANSGameMode* GameMode = GetTestGameMode();
+		if (GameMode == nullptr)
+		{
+			Test->AddError(TEXT("The default map has no NS game mode"));
+			return true;
+		}
+
+		const bool bTimedOut = GetCurrentRunTime() > Timeout;
+		if (bTimedOut)
+		{
+			Test->AddError(FString::Printf(TEXT("Timed out after %.0f s at stage %d"), Timeout, Stage));
+		}
+
+		if (bTimedOut || Step(GameMode))
+		{
+			for (const TWeakObjectPtr<ANSBotController>& Bot : Bots)
+			{
+				if (Bot.IsValid())
+				{
+					if (Bot->GetPawn() != nullptr)
+					{
+						Bot->GetPawn()->Destroy();
+					}
+					Bot->Destroy();
+				}
+			}
+			return true;
+		}
+		return false;
+	}
+
+protected:
+	/** Advances the flow, returns true once it is over */
+	virtual bool Step(ANSGameMode* GameMode) = 0;
+
+	ANSCharacter* AddBot(ANSGameMode* GameMode)
+	{
+		ANSBotController* Bot = GameMode->AddBot();
+		if (Bot == nullptr)
+		{
+			return nullptr;
+		}
+		Bots.Add(Bot);
+		return Cast<ANSCharacter>(Bot->GetPawn());
+	}
+
+	FAutomationTestBase* Test;
+	float Timeout;
+	int32 Stage;
+	TArray<TWeakObjectPtr<ANSBotController>> Bots;
+};
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FNSSpawnScoringTest, "NS.SpawnSelection.Scoring", NSTestFlags)
+
+bool FNSSpawnScoringTest::RunTest(const FString& Parameters)
+{
+	TArray<FNSGameTasks::FCharacterSnapshot> Characters;
+	Characters.Add({ FVector(0.0f, 0.0f, 0.0f), ETeam::BLUE_TEAM, true });
+	Characters.Add({ FVector(5000.0f, 0.0f, 0.0f), ETeam::BLUE_TEAM, false });
+	Characters.Add({ FVector(4900.0f, 0.0f, 0.0f), ETeam::RED_TEAM, true });
+
+	FNSGameTasks::FSpawnCandidate Blocked = { nullptr, FVector(0.0f, 0.0f, 0.0f), ETeam::RED_TEAM, true, 0.0f };
+	FNSGameTasks::FSpawnCandidate Near = { nullptr, FVector(1000.0f, 0.0f, 0.0f), ETeam::RED_TEAM, false, 0.0f };
+	FNSGameTasks::FSpawnCandidate Far = { nullptr, FVector(5000.0f, 0.0f, 0.0f), ETeam::RED_TEAM, false, 0.0f };
+	FNSGameTasks::ScoreSpawn(Blocked, Characters);
+	FNSGameTasks::ScoreSpawn(Near, Characters);
+	FNSGameTasks::ScoreSpawn(Far, Characters);
+
+	TestEqual(TEXT("A blocked spawn point is never picked"), Blocked.Score, -1.0f);
+	TestEqual(TEXT("Score is the squared distance to the closest living enemy"), Near.Score, 1000.0f * 1000.0f);
+	TestEqual(TEXT("Dead enemies and teammates do not count"), Far.Score, 5000.0f * 5000.0f);
+	TestTrue(TEXT("The spawn point farther from the enemies wins"), Far.Score > Near.Score);
+
+	// The other team measures against the reds
+	FNSGameTasks::FSpawnCandidate Blue = { nullptr, FVector(0.0f, 0.0f, 0.0f), ETeam::BLUE_TEAM, false, 0.0f };
+	FNSGameTasks::ScoreSpawn(Blue, Characters);
+	TestEqual(TEXT("No enemy in range"), Blue.Score, 4900.0f * 4900.0f);
+
+	// With no living enemy every free spawn point is as good as the others
+	Characters.Reset();
+	FNSGameTasks::ScoreSpawn(Blue, Characters);
+	TestEqual(TEXT("No enemy at all"), Blue.Score, MAX_flt);
+
+	return true;
+}
+
+/** A new bot must appear on a spawn point of its own team */
+class FNSSpawnPlacementCommand : public FNSGameplayLatentCommand
+{
+public:
+	explicit FNSSpawnPlacementCommand(FAutomationTestBase* InTest)
+		: FNSGameplayLatentCommand(InTest, 10.0f)
+	{
+	}
+
+protected:
+	virtual bool Step(ANSGameMode* GameMode) override
+	{
+		if (Stage == 0)
+		{
+			ANSCharacter* NewChar = AddBot(GameMode);
+			if (NewChar == nullptr || NewChar->GetNSPlayerState() == nullptr)
+			{
+				Test->AddError(TEXT("Could not add a bot"));
+				return true;
+			}
+			Character = NewChar;
+
+			bool bHasSpawnPoint = false;
+			for (TActorIterator<ANSSPawnPoint> Iter(GameMode->GetWorld()); Iter; ++Iter)
+			{
+				bHasSpawnPoint |= Iter->Team == NewChar->GetNSPlayerState()->Team;
+			}
+			if (!bHasSpawnPoint)
+			{
+				Test->AddError(TEXT("The default map has no spawn point for the bot's team"));
+				return true;
+			}
+
+			Stage = 1;
+			return false;
+		}
+
+		if (!Character.IsValid())
+		{
+			Test->AddError(TEXT("The bot's character was destroyed before it spawned"));
+			return true;
+		}
+
+		// Spawns are applied in the next simulation step, the bot may start walking right after
+		for (TActorIterator<ANSSPawnPoint> Iter(GameMode->GetWorld()); Iter; ++Iter)
+		{
+			if (FVector::Dist2D(Iter->GetActorLocation(), Character->GetActorLocation()) < 10.0f)
+			{
+				Test->TestTrue(TEXT("The spawn point belongs to the bot's team"), Iter->Team == Character->GetNSPlayerState()->Team);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	TWeakObjectPtr<ANSCharacter> Character;
+};
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FNSSpawnPlacementTest, "NS.SpawnSelection.Placement", NSTestFlags)
+
+bool FNSSpawnPlacementTest::RunTest(const FString& Parameters)
+{
+	OpenTestMap();
+	ADD_LATENT_AUTOMATION_COMMAND(FNSSpawnPlacementCommand(this));
+	return true;
+}
+
+/** Bots added one after the other alternate teams, and every copy of the team agrees */
+class FNSTeamAssignmentCommand : public FNSGameplayLatentCommand
+{
+public:
+	explicit FNSTeamAssignmentCommand(FAutomationTestBase* InTest)
+		: FNSGameplayLatentCommand(InTest, 10.0f)
+	{
+	}
+
+protected:
+	virtual bool Step(ANSGameMode* GameMode) override
+	{
+		TArray<ANSCharacter*> Characters;
+		for (int32 i = 0; i < 5; ++i)
+		{
+			ANSCharacter* Character = AddBot(GameMode);
+			if (Character == nullptr || Character->GetNSPlayerState() == nullptr)
+			{
+				Test->AddError(TEXT("Could not add a bot"));
+				return true;
+			}
+			Characters.Add(Character);
+
+			const int32 NumRed = GameMode->GetTeamMembers(ETeam::RED_TEAM).Num();
+			const int32 NumBlue = GameMode->GetTeamMembers(ETeam::BLUE_TEAM).Num();
+			Test->TestTrue(FString::Printf(TEXT("Teams stay balanced, %d red and %d blue"), NumRed, NumBlue), FMath::Abs(NumRed - NumBlue) <= 1);
+		}
+
+		for (ANSCharacter* Character : Characters)
+		{
+			const ETeam Team = Character->GetNSPlayerState()->Team;
+			Test->TestTrue(TEXT("The replicated team matches the player state"), Character->CurrentTeam == Team);
+			Test->TestTrue(TEXT("The character is in its team array"), GameMode->GetTeamMembers(Team).Contains(Character));
+			Test->TestFalse(TEXT("The character is not in the other team array"),
+				GameMode->GetTeamMembers(Team == ETeam::RED_TEAM ? ETeam::BLUE_TEAM : ETeam::RED_TEAM).Contains(Character));
+		}
+		return true;
+	}
+};
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FNSTeamAssignmentTest, "NS.TeamAssignment", NSTestFlags)
+
+bool FNSTeamAssignmentTest::RunTest(const FString& Parameters)
+{
+	OpenTestMap();
+	ADD_LATENT_AUTOMATION_COMMAND(FNSTeamAssignmentCommand(this));
+	return true;
+}
+
+/** One bot kills another, which respawns after RespawnDelay with full health and spawn protection */
+class FNSDamageRespawnCommand : public FNSGameplayLatentCommand
+{
+public:
+	explicit FNSDamageRespawnCommand(FAutomationTestBase* InTest)
+		: FNSGameplayLatentCommand(InTest, 15.0f)
+		, KillTime(0.0f)
+	{
+	}
+
+protected:
+	virtual bool Step(ANSGameMode* GameMode) override
+	{
+		UWorld* World = GameMode->GetWorld();
+		FDamageEvent DamageEvent(UDamageType::StaticClass());
+
+		if (Stage == 0)
+		{
+			ANSCharacter* KillerChar = AddBot(GameMode);
+			ANSCharacter* VictimChar = AddBot(GameMode);
+			if (KillerChar == nullptr || VictimChar == nullptr)
+			{
+				Test->AddError(TEXT("Could not add the bots"));
+				return true;
+			}
+			if (KillerChar->CurrentTeam == VictimChar->CurrentTeam)
+			{
+				Test->AddError(TEXT("Two bots added in a row ended up in the same team"));
+				return true;
+			}
+
+			ANSPlayerState* KillerPS = KillerChar->GetNSPlayerState();
+			ANSPlayerState* VictimPS = VictimChar->GetNSPlayerState();
+			Killer = KillerChar;
+			Victim = VictimChar;
+			VictimController = VictimChar->GetController();
+
+			// Partial damage first, then the rest kills
+			const int32 Deaths = VictimPS->Deaths;
+			const float Score = KillerPS->Score;
+			VictimChar->TakeDamage(30.0f, DamageEvent, KillerChar->GetController(), KillerChar);
+			Test->TestEqual(TEXT("Damage lowers health"), VictimPS->Health, 70.0f);
+			Test->TestEqual(TEXT("Damage alone is not a death"), VictimPS->Deaths, Deaths);
+
+			VictimChar->TakeDamage(VictimPS->Health, DamageEvent, KillerChar->GetController(), KillerChar);
+			Test->TestTrue(TEXT("Lethal damage leaves no health"), VictimPS->Health <= 0.0f);
+			Test->TestEqual(TEXT("The victim gets a death"), VictimPS->Deaths, Deaths + 1);
+			Test->TestEqual(TEXT("The killer gets a point"), KillerPS->Score, Score + 1.0f);
+
+			// A dead character takes no more damage or deaths
+			VictimChar->TakeDamage(50.0f, DamageEvent, KillerChar->GetController(), KillerChar);
+			Test->TestEqual(TEXT("No second death"), VictimPS->Deaths, Deaths + 1);
+
+			KillTime = World->GetTimeSeconds();
+			Stage = 1;
+			return false;
+		}
+
+		AController* Controller = VictimController.Get();
+		if (Controller == nullptr)
+		{
+			Test->AddError(TEXT("The victim's controller is gone"));
+			return true;
+		}
+
+		ANSCharacter* NewChar = Cast<ANSCharacter>(Controller->GetPawn());
+		if (NewChar == nullptr || NewChar == Victim.Get())
+		{
+			return false;
+		}
+
+		ANSPlayerState* VictimPS = NewChar->GetNSPlayerState();
+		const ETeam Team = VictimPS != nullptr ? VictimPS->Team : ETeam::RED_TEAM;
+		Test->TestNotNull(TEXT("The new character has the player state"), VictimPS);
+		Test->TestTrue(TEXT("Respawn waits for RespawnDelay"), World->GetTimeSeconds() - KillTime >= GameMode->RespawnDelay - 0.1f);
+		Test->TestEqual(TEXT("Full health after respawn"), VictimPS != nullptr ? VictimPS->Health : 0.0f, 100.0f);
+		Test->TestTrue(TEXT("Same team after respawn"), NewChar->CurrentTeam == Team);
+		Test->TestTrue(TEXT("The new character replaces the old one in the team array"),
+			GameMode->GetTeamMembers(Team).Contains(NewChar) && !GameMode->GetTeamMembers(Team).Contains(Victim.Get()));
+
+		// Spawn protection
+		Test->TestTrue(TEXT("Spawn protected after respawn"), NewChar->bSpawnProtected);
+		if (VictimPS != nullptr && Killer.IsValid())
+		{
+			NewChar->TakeDamage(50.0f, DamageEvent, Killer->GetController(), Killer.Get());
+			Test->TestEqual(TEXT("Spawn protection ignores damage"), VictimPS->Health, 100.0f);
+		}
+		return true;
+	}
+
+	TWeakObjectPtr<ANSCharacter> Killer;
+	TWeakObjectPtr<ANSCharacter> Victim;
+	TWeakObjectPtr<AController> VictimController;
+	float KillTime;
+};
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FNSDamageRespawnTest, "NS.DamageDeathRespawn", NSTestFlags)
+
+bool FNSDamageRespawnTest::RunTest(const FString& Parameters)
+{
+	OpenTestMap();
+	ADD_LATENT_AUTOMATION_COMMAND(FNSDamageRespawnCommand(this));
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FNSFireValidationTest, "NS.FireValidation", NSTestFlags)
+
+bool FNSFireValidationTest::RunTest(const FString& Parameters)
+{
+	const float MaxOriginError = 100.0f;
+	const FVector Eyes(0.0f, 0.0f, 60.0f);
+
+	FNSGameTasks::FShot Shot;
+	Shot.ShooterEyes = Eyes;
+	Shot.bShooterAlive = true;
+
+	Shot.Origin = Eyes + FVector(10.0f, 0.0f, 0.0f);
+	Shot.End = Eyes + FVector(5000.0f, 0.0f, 0.0f);
+	FNSGameTasks::ValidateShot(Shot, MaxOriginError);
+	TestTrue(TEXT("A shot from the eyes is valid"), Shot.bValid);
+
+	Shot.Origin = Eyes + FVector(MaxOriginError + 1.0f, 0.0f, 0.0f);
+	FNSGameTasks::ValidateShot(Shot, MaxOriginError);
+	TestFalse(TEXT("A shot from farther than MaxOriginError is rejected"), Shot.bValid);
+
+	Shot.Origin = Eyes;
+	Shot.End = Eyes;
+	FNSGameTasks::ValidateShot(Shot, MaxOriginError);
+	TestFalse(TEXT("A shot without direction is rejected"), Shot.bValid);
+
+	Shot.End = FVector(NAN, 0.0f, 0.0f);
+	FNSGameTasks::ValidateShot(Shot, MaxOriginError);
+	TestFalse(TEXT("A shot with NaN is rejected"), Shot.bValid);
+
+	Shot.End = Eyes + FVector(5000.0f, 0.0f, 0.0f);
+	Shot.bShooterAlive = false;
+	FNSGameTasks::ValidateShot(Shot, MaxOriginError);
+	TestFalse(TEXT("A dead shooter cannot fire"), Shot.bValid);
+
+	TestTrue(TEXT("The game mode sets an origin tolerance"), GetDefault<ANSGameMode>()->MaxShotOriginError > 0.0f);
+
+	return true;
+}
+
+#endif
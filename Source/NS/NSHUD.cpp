@@ -2,15 +2,86 @@
 
 #include "NS.h"
 #include "NSHUD.h"
+#include "NSGameState.h"
+#include "NSPlayerState.h"
+#include "NSPlayerController.h"
+#include "NSFrameArena.h"
+#include "NSAllocTracker.h"
+#include "NSPerfTracker.h"
 #include "Engine/Canvas.h"
 #include "TextureResource.h"
+#include "RenderUtils.h"
 #include "CanvasItem.h"
 
+DECLARE_CYCLE_STAT(TEXT("HUD Draw"), STAT_NSHUDDraw, STATGROUP_NS);
+DECLARE_CYCLE_STAT(TEXT("HUD Rebuild"), STAT_NSHUDRebuild, STATGROUP_NS);
+DECLARE_DWORD_COUNTER_STAT(TEXT("HUD Items"), STAT_NSHUDItems, STATGROUP_NS);
+
+static TAutoConsoleVariable<int32> CVarHUDForceRebuild(
+	TEXT("ns.HUD.ForceRebuild"),
+	0,
+	TEXT("1 rebuilds every HUD element each frame, as a HUD without cached layout would."));
+
+static FAutoConsoleCommandWithWorldAndArgs HUDBenchCommand(
+	TEXT("ns.HUD.Bench"),
+	TEXT("Opens a scoreboard of N fake players (default 64) and logs the HUD draw time over F frames (default 300), cached and rebuilt every frame. Fails if the cached layout is slower: ns.HUD.Bench <N> <F>"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		APlayerController* PC = World ? World->GetFirstPlayerController() : nullptr;
+		ANSHUD* HUD = PC ? Cast<ANSHUD>(PC->GetHUD()) : nullptr;
+		if (HUD != nullptr)
+		{
+			const int32 Rows = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 64;
+			const int32 Frames = Args.Num() > 1 ? FMath::Max(FCString::Atoi(*Args[1]), 1) : 300;
+			HUD->StartBenchmark(Rows, Frames);
+		}
+	}));
+
+namespace NSHUDLayout
+{
+	const float Margin = 20.0f;
+	const float RowHeight = 16.0f;
+	const float ColumnWidth = 320.0f;
+	const float ColumnGap = 20.0f;
+	const int32 MaxRowsPerColumn = 32;
+
+	FLinearColor GetTeamColor(ETeam Team)
+	{
+		return Team == ETeam::RED_TEAM ? FLinearColor(1.0f, 0.25f, 0.2f) : FLinearColor(0.3f, 0.5f, 1.0f);
+	}
+
+	template<typename ItemType>
+	void DrawItems(UCanvas* Canvas, TArray<ItemType>& Items)
+	{
+		for (ItemType& Item : Items)
+		{
+			Canvas->DrawItem(Item);
+		}
+	}
+}
+
 ANSHUD::ANSHUD()
 {
 	// Set the crosshair texture
 	static ConstructorHelpers::FObjectFinder<UTexture2D> CrosshiarTexObj(TEXT("/Game/FirstPerson/Textures/FirstPersonCrosshair"));
 	CrosshairTex = CrosshiarTexObj.Object;
+
+	Font = nullptr;
+	LayoutSize = FVector2D::ZeroVector;
+	CachedHealth = -1.0f;
+	CachedRedScore = INDEX_NONE;
+	CachedBlueScore = INDEX_NONE;
+	CachedKillFeedVersion = INDEX_NONE;
+	CachedScoreboardVersion = INDEX_NONE;
+
+	bScoreboardVisible = false;
+	bScoreboardDirty = true;
+
+	BenchPhase = 0;
+	BenchFrames = 0;
+	BenchFrame = 0;
+	BenchCycles[0] = BenchCycles[1] = 0;
+	bBenchWasVisible = false;
 }
 
 
@@ -18,10 +89,133 @@ void ANSHUD::DrawHUD()
 {
 	Super::DrawHUD();
 
+	SCOPE_CYCLE_COUNTER(STAT_NSHUDDraw);
+	NS_ALLOC_SCOPE(HUDDraw);
+	const uint32 StartCycles = FPlatformTime::Cycles();
+
+	UpdateElements();
+
+	// Tiles first so every texture goes out in one batch, text on top of them
+	if (bScoreboardVisible)
+	{
+		NSHUDLayout::DrawItems(Canvas, ScoreboardTiles);
+	}
+	NSHUDLayout::DrawItems(Canvas, Tiles);
+
+	NSHUDLayout::DrawItems(Canvas, StatusTexts);
+	NSHUDLayout::DrawItems(Canvas, KillFeedTexts);
+	if (bScoreboardVisible)
+	{
+		NSHUDLayout::DrawItems(Canvas, ScoreboardTexts);
+	}
+
+	const int32 NumItems = Tiles.Num() + StatusTexts.Num() + KillFeedTexts.Num() + (bScoreboardVisible ? ScoreboardTiles.Num() + ScoreboardTexts.Num() : 0);
+	SET_DWORD_STAT(STAT_NSHUDItems, NumItems);
+
+	if (BenchPhase != 0)
+	{
+		TickBenchmark(FPlatformTime::Cycles() - StartCycles);
+	}
+}
+
+void ANSHUD::SetScoreboardVisible(bool bVisible)
+{
+	bScoreboardVisible = bVisible;
+}
+
+void ANSHUD::UpdateElements()
+{
+	if (Font == nullptr)
+	{
+		Font = GEngine->GetSmallFont();
+	}
+
+	const FVector2D CanvasSize(Canvas->ClipX, Canvas->ClipY);
+	const bool bRebuildAll = CanvasSize != LayoutSize || BenchPhase == 2 || CVarHUDForceRebuild.GetValueOnGameThread() != 0;
+	LayoutSize = CanvasSize;
+
+	const ANSGameState* GameState = GetWorld()->GetGameState<ANSGameState>();
+	const ANSPlayerState* PS = PlayerOwner != nullptr ? Cast<ANSPlayerState>(PlayerOwner->PlayerState) : nullptr;
+
+	const float Health = PS != nullptr ? PS->Health : 0.0f;
+	const int32 RedScore = GameState != nullptr ? GameState->RedScore : 0;
+	const int32 BlueScore = GameState != nullptr ? GameState->BlueScore : 0;
+
+	if (bRebuildAll || Health != CachedHealth || RedScore != CachedRedScore || BlueScore != CachedBlueScore)
+	{
+		BuildStatus(Health, RedScore, BlueScore);
+	}
+
+	if (GameState != nullptr && (bRebuildAll || GameState->GetKillFeedVersion() != CachedKillFeedVersion))
+	{
+		BuildKillFeed(GameState);
+	}
+
+	// A hidden scoreboard waits until it is opened again
+	const int32 ScoreboardVersion = GameState != nullptr ? GameState->GetScoreboardVersion() : 0;
+	if (bScoreboardVisible && (bRebuildAll || bScoreboardDirty || ScoreboardVersion != CachedScoreboardVersion))
+	{
+		BuildScoreboard(GameState);
+	}
+}
+
+float ANSHUD::AddText(TArray<FCanvasTextItem>& Items, const FVector2D& Position, const FString& Text, const FLinearColor& Color)
+{
+	FCanvasTextItem Item(Position, FText::FromString(Text), Font, Color);
+	Item.EnableShadow(FLinearColor::Black);
+	Items.Add(Item);
+
+	float Width = 0.0f;
+	float Height = 0.0f;
+	Canvas->StrLen(Font, Text, Width, Height);
+	return Width;
+}
+
+void ANSHUD::BuildStatus(float Health, int32 RedScore, int32 BlueScore)
+{
+	SCOPE_CYCLE_COUNTER(STAT_NSHUDRebuild);
+
+	CachedHealth = Health;
+	CachedRedScore = RedScore;
+	CachedBlueScore = BlueScore;
+
+	StatusTexts.Reset();
+	Tiles.Reset();
+
+	const float Margin = NSHUDLayout::Margin;
+	const float RowHeight = NSHUDLayout::RowHeight;
+
+	// Health, bottom left
+	const FString HealthText = FString::Printf(TEXT("Health %d"), FMath::CeilToInt(FMath::Max(Health, 0.0f)));
+	const FVector2D HealthPosition(Margin, LayoutSize.Y - Margin - RowHeight);
+	const float HealthWidth = AddText(StatusTexts, HealthPosition, HealthText, Health > 30.0f ? FLinearColor::White : FLinearColor::Red);
+
+	// Team scores, top centre
+	const FString RedText = FString::Printf(TEXT("RED %d"), RedScore);
+	const FString BlueText = FString::Printf(TEXT("%d BLUE"), BlueScore);
+	float RedWidth = 0.0f;
+	float TextHeight = 0.0f;
+	Canvas->StrLen(Font, RedText, RedWidth, TextHeight);
+
+	const float CentreX = LayoutSize.X * 0.5f;
+	AddText(StatusTexts, FVector2D(CentreX - RedWidth - 10.0f, Margin), RedText, NSHUDLayout::GetTeamColor(ETeam::RED_TEAM));
+	AddText(StatusTexts, FVector2D(CentreX - 3.0f, Margin), TEXT("-"), FLinearColor::White);
+	const float BlueWidth = AddText(StatusTexts, FVector2D(CentreX + 10.0f, Margin), BlueText, NSHUDLayout::GetTeamColor(ETeam::BLUE_TEAM));
+
+	// Panels behind both
+	const FLinearColor PanelColor(0.0f, 0.0f, 0.0f, 0.4f);
+	FCanvasTileItem HealthPanel(HealthPosition - FVector2D(4.0f, 2.0f), GWhiteTexture, FVector2D(HealthWidth + 8.0f, RowHeight + 4.0f), PanelColor);
+	HealthPanel.BlendMode = SE_BLEND_Translucent;
+	Tiles.Add(HealthPanel);
+
+	FCanvasTileItem ScorePanel(FVector2D(CentreX - RedWidth - 14.0f, Margin - 2.0f), GWhiteTexture, FVector2D(RedWidth + BlueWidth + 28.0f, RowHeight + 4.0f), PanelColor);
+	ScorePanel.BlendMode = SE_BLEND_Translucent;
+	Tiles.Add(ScorePanel);
+
 	// Draw very simple crosshair
 
 	// find center of the Canvas
-	const FVector2D Center(Canvas->ClipX * 0.5f, Canvas->ClipY * 0.5f);
+	const FVector2D Center(LayoutSize.X * 0.5f, LayoutSize.Y * 0.5f);
 
 	// offset by half the texture's dimensions so that the center of the texture aligns with the center of the Canvas
 	const FVector2D CrosshairDrawPosition( (Center.X),
@@ -30,6 +224,199 @@ void ANSHUD::DrawHUD()
 	// draw the crosshair
 	FCanvasTileItem TileItem( CrosshairDrawPosition, CrosshairTex->Resource, FLinearColor::White);
 	TileItem.BlendMode = SE_BLEND_Translucent;
-	Canvas->DrawItem( TileItem );
+	Tiles.Add( TileItem );
+
+	// Same textures next to each other so the canvas merges them into one batch
+	Tiles.Sort([](const FCanvasTileItem& A, const FCanvasTileItem& B) { return A.Texture < B.Texture; });
 }
 
+void ANSHUD::BuildKillFeed(const ANSGameState* GameState)
+{
+	SCOPE_CYCLE_COUNTER(STAT_NSHUDRebuild);
+
+	CachedKillFeedVersion = GameState->GetKillFeedVersion();
+	KillFeedTexts.Reset();
+
+	// Newest kill on top, right aligned
+	const FString Separator(TEXT(" > "));
+	float Y = NSHUDLayout::Margin;
+	for (int32 i = GameState->KillFeed.Num() - 1; i >= 0; --i)
+	{
+		const FNSKillEvent& Kill = GameState->KillFeed[i];
+
+		float KillerWidth = 0.0f, SeparatorWidth = 0.0f, VictimWidth = 0.0f, Height = 0.0f;
+		Canvas->StrLen(Font, Kill.KillerName, KillerWidth, Height);
+		Canvas->StrLen(Font, Separator, SeparatorWidth, Height);
+		Canvas->StrLen(Font, Kill.VictimName, VictimWidth, Height);
+
+		float X = LayoutSize.X - NSHUDLayout::Margin - KillerWidth - SeparatorWidth - VictimWidth;
+		AddText(KillFeedTexts, FVector2D(X, Y), Kill.KillerName, NSHUDLayout::GetTeamColor(Kill.KillerTeam));
+		X += KillerWidth;
+		AddText(KillFeedTexts, FVector2D(X, Y), Separator, FLinearColor::White);
+		X += SeparatorWidth;
+		AddText(KillFeedTexts, FVector2D(X, Y), Kill.VictimName, NSHUDLayout::GetTeamColor(Kill.VictimTeam));
+
+		Y += NSHUDLayout::RowHeight;
+	}
+}
+
+void ANSHUD::BuildScoreboard(const ANSGameState* GameState)
+{
+	SCOPE_CYCLE_COUNTER(STAT_NSHUDRebuild);
+
+	CachedScoreboardVersion = GameState != nullptr ? GameState->GetScoreboardVersion() : 0;
+	bScoreboardDirty = false;
+
+	ScoreboardTiles.Reset();
+	ScoreboardTexts.Reset();
+
+	// Rows only live for this rebuild, the names stay with their player states
+	struct FRow
+	{
+		const FString* Name;
+		int32 Score;
+		int32 Deaths;
+		ETeam Team;
+	};
+
+	TArray<FRow, FNSFrameAllocator> Rows;
+	if (FakeNames.Num() > 0)
+	{
+		Rows.Reserve(FakeNames.Num());
+		for (int32 i = 0; i < FakeNames.Num(); ++i)
+		{
+			FRow& Row = Rows[Rows.AddUninitialized()];
+			Row.Name = &FakeNames[i];
+			Row.Score = (i * 7) % 23;
+			Row.Deaths = (i * 5) % 11;
+			Row.Team = (i % 2) == 0 ? ETeam::RED_TEAM : ETeam::BLUE_TEAM;
+		}
+	}
+	else if (GameState != nullptr)
+	{
+		// Players the join snapshot announced, until their player states replicate
+		const ANSPlayerController* Controller = Cast<ANSPlayerController>(PlayerOwner);
+		const TArray<FNSSnapshotPlayer>* PendingPlayers = Controller != nullptr ? &Controller->GetJoinSync().GetPendingPlayers() : nullptr;
+
+		Rows.Reserve(GameState->PlayerArray.Num() + (PendingPlayers != nullptr ? PendingPlayers->Num() : 0));
+		for (APlayerState* PlayerState : GameState->PlayerArray)
+		{
+			const ANSPlayerState* PS = Cast<ANSPlayerState>(PlayerState);
+			if (PS != nullptr)
+			{
+				FRow& Row = Rows[Rows.AddUninitialized()];
+				Row.Name = &PS->PlayerName;
+				Row.Score = FMath::RoundToInt(PS->Score);
+				Row.Deaths = PS->Deaths;
+				Row.Team = PS->Team;
+			}
+		}
+
+		if (PendingPlayers != nullptr)
+		{
+			for (const FNSSnapshotPlayer& Player : *PendingPlayers)
+			{
+				FRow& Row = Rows[Rows.AddUninitialized()];
+				Row.Name = &Player.Name;
+				Row.Score = Player.Score;
+				Row.Deaths = Player.Deaths;
+				Row.Team = Player.Team;
+			}
+		}
+	}
+
+	Rows.Sort([](const FRow& A, const FRow& B) { return A.Score > B.Score; });
+
+	// One column per team, red on the left
+	const float RowHeight = NSHUDLayout::RowHeight;
+	const float ColumnWidth = NSHUDLayout::ColumnWidth;
+	const float Top = FMath::Max(NSHUDLayout::Margin * 3.0f, (LayoutSize.Y - (NSHUDLayout::MaxRowsPerColumn + 1) * RowHeight) * 0.5f);
+	const float ColumnX[2] =
+	{
+		LayoutSize.X * 0.5f - ColumnWidth - NSHUDLayout::ColumnGap * 0.5f,
+		LayoutSize.X * 0.5f + NSHUDLayout::ColumnGap * 0.5f
+	};
+	int32 ColumnRows[2] = { 0, 0 };
+
+	for (int32 Column = 0; Column < 2; ++Column)
+	{
+		const ETeam Team = Column == 0 ? ETeam::RED_TEAM : ETeam::BLUE_TEAM;
+		const FLinearColor Color = NSHUDLayout::GetTeamColor(Team);
+
+		FCanvasTileItem Header(FVector2D(ColumnX[Column], Top), GWhiteTexture, FVector2D(ColumnWidth, RowHeight - 1.0f), FLinearColor(Color.R, Color.G, Color.B, 0.6f));
+		Header.BlendMode = SE_BLEND_Translucent;
+		ScoreboardTiles.Add(Header);
+
+		AddText(ScoreboardTexts, FVector2D(ColumnX[Column] + 4.0f, Top), Column == 0 ? TEXT("RED") : TEXT("BLUE"), FLinearColor::White);
+		AddText(ScoreboardTexts, FVector2D(ColumnX[Column] + ColumnWidth - 100.0f, Top), TEXT("Score"), FLinearColor::White);
+		AddText(ScoreboardTexts, FVector2D(ColumnX[Column] + ColumnWidth - 50.0f, Top), TEXT("Deaths"), FLinearColor::White);
+	}
+
+	for (const FRow& Row : Rows)
+	{
+		const int32 Column = Row.Team == ETeam::RED_TEAM ? 0 : 1;
+		if (ColumnRows[Column] >= NSHUDLayout::MaxRowsPerColumn)
+		{
+			continue;
+		}
+
+		const float X = ColumnX[Column];
+		const float Y = Top + (++ColumnRows[Column]) * RowHeight;
+
+		FCanvasTileItem Background(FVector2D(X, Y), GWhiteTexture, FVector2D(ColumnWidth, RowHeight - 1.0f), FLinearColor(0.0f, 0.0f, 0.0f, 0.4f));
+		Background.BlendMode = SE_BLEND_Translucent;
+		ScoreboardTiles.Add(Background);
+
+		AddText(ScoreboardTexts, FVector2D(X + 4.0f, Y), *Row.Name, FLinearColor::White);
+		AddText(ScoreboardTexts, FVector2D(X + ColumnWidth - 100.0f, Y), FString::FromInt(Row.Score), FLinearColor::White);
+		AddText(ScoreboardTexts, FVector2D(X + ColumnWidth - 50.0f, Y), FString::FromInt(Row.Deaths), FLinearColor::White);
+	}
+}
+
+void ANSHUD::StartBenchmark(int32 NumRows, int32 NumFrames)
+{
+	bBenchWasVisible = bScoreboardVisible;
+	FakeNames.Reset(NumRows);
+	for (int32 i = 0; i < NumRows; ++i)
+	{
+		FakeNames.Add(FString::Printf(TEXT("Player %d"), i));
+	}
+	bScoreboardVisible = true;
+	bScoreboardDirty = true;
+
+	BenchPhase = 1;
+	BenchFrames = NumFrames;
+	BenchFrame = 0;
+	BenchCycles[0] = BenchCycles[1] = 0;
+}
+
+void ANSHUD::TickBenchmark(uint32 Cycles)
+{
+	BenchCycles[BenchPhase - 1] += Cycles;
+
+	if (++BenchFrame < BenchFrames)
+	{
+		return;
+	}
+
+	BenchFrame = 0;
+	if (BenchPhase == 1)
+	{
+		BenchPhase = 2;
+		return;
+	}
+
+	const double CachedMs = FPlatformTime::GetSecondsPerCycle() * BenchCycles[0] * 1000.0 / BenchFrames;
+	const double RebuiltMs = FPlatformTime::GetSecondsPerCycle() * BenchCycles[1] * 1000.0 / BenchFrames;
+	UE_LOG(LogNS, Log, TEXT("HUD bench, %d scoreboard rows over %d frames: cached %.4f ms, rebuilt every frame %.4f ms"),
+		FakeNames.Num(), BenchFrames, CachedMs, RebuiltMs);
+
+	// The cached layout is the point of the HUD, it must not cost more than rebuilding
+	FNSPerfTracker::Expect(CachedMs <= RebuiltMs, TEXT("ns.HUD.Bench"),
+		FString::Printf(TEXT("cached layout took %.4f ms per frame, rebuilding %.4f ms"), CachedMs, RebuiltMs));
+
+	BenchPhase = 0;
+	FakeNames.Empty();
+	bScoreboardVisible = bBenchWasVisible;
+	bScoreboardDirty = true;
+}
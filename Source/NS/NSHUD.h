@@ -1,8 +1,13 @@
 // Copyright 1998-2016 Epic Games, Inc. All Rights Reserved.
-#pragma once 
+#pragma once
 #include "GameFramework/HUD.h"
+#include "CanvasItem.h"
 #include "NSHUD.generated.h"
 
+/**
+ * Health, team scores, kill feed and scoreboard. Every element is laid out once into cached canvas
+ * items and only rebuilt when its replicated source value changes or the canvas is resized.
+ */
 UCLASS()
 class ANSHUD : public AHUD
 {
@@ -14,9 +19,61 @@ public:
 	/** Primary draw call for the HUD */
 	virtual void DrawHUD() override;
 
+	void SetScoreboardVisible(bool bVisible);
+
+	/** Opens a scoreboard of NumRows fake players and logs the draw time, cached and rebuilt every frame */
+	void StartBenchmark(int32 NumRows, int32 NumFrames);
+
 private:
+	/** Rebuilds the elements whose source values changed since the last frame */
+	void UpdateElements();
+
+	void BuildStatus(float Health, int32 RedScore, int32 BlueScore);
+	void BuildKillFeed(const class ANSGameState* GameState);
+	void BuildScoreboard(const class ANSGameState* GameState);
+
+	/** Adds a shadowed text item and returns its width */
+	float AddText(TArray<FCanvasTextItem>& Items, const FVector2D& Position, const FString& Text, const FLinearColor& Color);
+
+	void TickBenchmark(uint32 Cycles);
+
 	/** Crosshair asset pointer */
 	class UTexture2D* CrosshairTex;
 
+	UPROPERTY()
+	class UFont* Font;
+
+	/** Canvas size the cached layout was built for */
+	FVector2D LayoutSize;
+
+	/** Source values of the cached elements */
+	float CachedHealth;
+	int32 CachedRedScore;
+	int32 CachedBlueScore;
+	int32 CachedKillFeedVersion;
+	int32 CachedScoreboardVersion;
+
+	/** Crosshair and panels, sorted by texture so the canvas draws each texture as one batch */
+	TArray<FCanvasTileItem> Tiles;
+
+	/** Scoreboard row backgrounds, all on the white texture */
+	TArray<FCanvasTileItem> ScoreboardTiles;
+
+	TArray<FCanvasTextItem> StatusTexts;
+	TArray<FCanvasTextItem> KillFeedTexts;
+	TArray<FCanvasTextItem> ScoreboardTexts;
+
+	bool bScoreboardVisible;
+	bool bScoreboardDirty;
+
+	/** Names of the fake players shown instead of the real scoreboard, empty when not benchmarking */
+	TArray<FString> FakeNames;
+
+	/** Benchmark state: 1 measures the cached HUD, 2 rebuilds every frame */
+	int32 BenchPhase;
+	int32 BenchFrames;
+	int32 BenchFrame;
+	uint64 BenchCycles[2];
+	bool bBenchWasVisible;
 };
 
@@ -0,0 +1,306 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "NS.h"
+#include "NSHitboxes.h"
+#include "NSCharacter.h"
+#include "NSPerfTracker.h"
+
+DECLARE_CYCLE_STAT(TEXT("Hitbox Update"), STAT_NSHitboxUpdate, STATGROUP_NS);
+
+static TAutoConsoleVariable<int32> CVarHitboxCache(
+	TEXT("ns.Fire.HitboxCache"),
+	1,
+	TEXT("1 evaluates the hitboxes of a character once per frame and reuses them for every shot. 0 evaluates the bones on every shot."));
+
+/** Built for the bones of the UE4 mannequin skeleton */
+static const FNSHitboxDef HitboxDefs[] =
+{
+	{ TEXT("head"),       nullptr,           ENSHitZone::Head,  12.0f, 1.2f },
+	{ TEXT("neck_01"),    TEXT("head"),      ENSHitZone::Torso,  8.0f, 0.0f },
+	{ TEXT("spine_03"),   TEXT("neck_01"),   ENSHitZone::Torso, 20.0f, 0.0f },
+	{ TEXT("spine_01"),   TEXT("spine_03"),  ENSHitZone::Torso, 20.0f, 0.0f },
+	{ TEXT("pelvis"),     TEXT("spine_01"),  ENSHitZone::Torso, 18.0f, 0.0f },
+	{ TEXT("upperarm_l"), TEXT("lowerarm_l"), ENSHitZone::Arm,   7.0f, 0.0f },
+	{ TEXT("lowerarm_l"), TEXT("hand_l"),    ENSHitZone::Arm,    6.0f, 0.0f },
+	{ TEXT("upperarm_r"), TEXT("lowerarm_r"), ENSHitZone::Arm,   7.0f, 0.0f },
+	{ TEXT("lowerarm_r"), TEXT("hand_r"),    ENSHitZone::Arm,    6.0f, 0.0f },
+	{ TEXT("thigh_l"),    TEXT("calf_l"),    ENSHitZone::Leg,   10.0f, 0.0f },
+	{ TEXT("calf_l"),     TEXT("foot_l"),    ENSHitZone::Leg,    8.0f, 0.0f },
+	{ TEXT("thigh_r"),    TEXT("calf_r"),    ENSHitZone::Leg,   10.0f, 0.0f },
+	{ TEXT("calf_r"),     TEXT("foot_r"),    ENSHitZone::Leg,    8.0f, 0.0f },
+};
+static_assert(ARRAY_COUNT(HitboxDefs) <= FNSHitboxSet::MaxHitboxes, "Too many hitboxes");
+
+/** Names of the bones of HitboxDefs, built on first use once the name table exists */
+struct FNSHitboxNames
+{
+	FName Bones[ARRAY_COUNT(HitboxDefs)];
+	FName EndBones[ARRAY_COUNT(HitboxDefs)];
+
+	FNSHitboxNames()
+	{
+		for (int32 i = 0; i < ARRAY_COUNT(HitboxDefs); ++i)
+		{
+			Bones[i] = FName(HitboxDefs[i].Bone);
+			EndBones[i] = HitboxDefs[i].EndBone != nullptr ? FName(HitboxDefs[i].EndBone) : NAME_None;
+		}
+	}
+
+	static const FNSHitboxNames& Get()
+	{
+		static const FNSHitboxNames Names;
+		return Names;
+	}
+};
+
+FNSHitboxSet::FNSHitboxSet()
+	: BoundMesh(nullptr)
+	, NumCapsules(0)
+	, UpdatedFrame(MAX_uint64)
+{
+}
+
+bool FNSHitboxSet::IsCacheEnabled()
+{
+	return CVarHitboxCache.GetValueOnAnyThread() != 0;
+}
+
+void FNSHitboxSet::Update(const USkeletalMeshComponent* Mesh)
+{
+	if (Mesh == nullptr || Mesh->SkeletalMesh == nullptr)
+	{
+		NumCapsules = 0;
+		return;
+	}
+
+	if (!IsCacheEnabled())
+	{
+		EvaluateByName(Mesh);
+		return;
+	}
+
+	if (UpdatedFrame == GFrameCounter && BoundMesh == Mesh->SkeletalMesh)
+	{
+		return;
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_NSHitboxUpdate);
+
+	if (BoundMesh != Mesh->SkeletalMesh)
+	{
+		Bind(Mesh);
+	}
+	EvaluateCached(Mesh);
+	UpdatedFrame = GFrameCounter;
+}
+
+void FNSHitboxSet::Bind(const USkeletalMeshComponent* Mesh)
+{
+	BoundMesh = Mesh->SkeletalMesh;
+	const FReferenceSkeleton& RefSkeleton = BoundMesh->RefSkeleton;
+	const FNSHitboxNames& Names = FNSHitboxNames::Get();
+
+	for (int32 i = 0; i < ARRAY_COUNT(HitboxDefs); ++i)
+	{
+		BoneIndices[i] = RefSkeleton.FindBoneIndex(Names.Bones[i]);
+
+		if (BoneIndices[i] == INDEX_NONE)
+		{
+			EndBoneIndices[i] = INDEX_NONE;
+		}
+		else if (Names.EndBones[i].IsNone())
+		{
+			EndBoneIndices[i] = RefSkeleton.GetParentIndex(BoneIndices[i]);
+		}
+		else
+		{
+			EndBoneIndices[i] = RefSkeleton.FindBoneIndex(Names.EndBones[i]);
+		}
+	}
+}
+
+void FNSHitboxSet::EvaluateCached(const USkeletalMeshComponent* Mesh)
+{
+	const TArray<FTransform>& ComponentSpace = Mesh->GetComponentSpaceTransforms();
+	const FTransform& ComponentToWorld = Mesh->GetComponentToWorld();
+
+	NumCapsules = 0;
+	for (int32 i = 0; i < ARRAY_COUNT(HitboxDefs); ++i)
+	{
+		if (BoneIndices[i] == INDEX_NONE || EndBoneIndices[i] == INDEX_NONE
+			|| !ComponentSpace.IsValidIndex(BoneIndices[i]) || !ComponentSpace.IsValidIndex(EndBoneIndices[i]))
+		{
+			continue;
+		}
+
+		const FNSHitboxDef& Def = HitboxDefs[i];
+		const FVector Bone = ComponentToWorld.TransformPosition(ComponentSpace[BoneIndices[i]].GetLocation());
+		const FVector Other = ComponentToWorld.TransformPosition(ComponentSpace[EndBoneIndices[i]].GetLocation());
+
+		FCapsule& Capsule = Capsules[NumCapsules++];
+		Capsule.Start = Bone;
+		Capsule.End = Def.EndBone == nullptr ? Bone + (Bone - Other) * Def.Extend : Other;
+		Capsule.Radius = Def.Radius;
+		Capsule.Zone = Def.Zone;
+	}
+}
+
+void FNSHitboxSet::EvaluateByName(const USkeletalMeshComponent* Mesh)
+{
+	SCOPE_CYCLE_COUNTER(STAT_NSHitboxUpdate);
+
+	// What every shot would pay without the cache: name lookups and a world transform per bone
+	const FNSHitboxNames& Names = FNSHitboxNames::Get();
+
+	NumCapsules = 0;
+	for (int32 i = 0; i < ARRAY_COUNT(HitboxDefs); ++i)
+	{
+		const FNSHitboxDef& Def = HitboxDefs[i];
+		if (Mesh->GetBoneIndex(Names.Bones[i]) == INDEX_NONE)
+		{
+			continue;
+		}
+
+		const FVector Bone = Mesh->GetBoneLocation(Names.Bones[i]);
+		const FName OtherName = Def.EndBone == nullptr ? Mesh->GetParentBone(Names.Bones[i]) : Names.EndBones[i];
+		if (OtherName.IsNone() || Mesh->GetBoneIndex(OtherName) == INDEX_NONE)
+		{
+			continue;
+		}
+		const FVector Other = Mesh->GetBoneLocation(OtherName);
+
+		FCapsule& Capsule = Capsules[NumCapsules++];
+		Capsule.Start = Bone;
+		Capsule.End = Def.EndBone == nullptr ? Bone + (Bone - Other) * Def.Extend : Other;
+		Capsule.Radius = Def.Radius;
+		Capsule.Zone = Def.Zone;
+	}
+}
+
+bool FNSHitboxSet::Raycast(const FVector& Start, const FVector& End, ENSHitZone& OutZone, float& OutDistance) const
+{
+	bool bHit = false;
+	OutDistance = MAX_flt;
+
+	for (int32 i = 0; i < NumCapsules; ++i)
+	{
+		const FCapsule& Capsule = Capsules[i];
+
+		FVector OnRay, OnCapsule;
+		FMath::SegmentDistToSegmentSafe(Start, End, Capsule.Start, Capsule.End, OnRay, OnCapsule);
+
+		const float DistSquared = FVector::DistSquared(OnRay, OnCapsule);
+		if (DistSquared > FMath::Square(Capsule.Radius))
+		{
+			continue;
+		}
+
+		// Entry point, back from the closest approach by the half chord
+		const float Distance = FMath::Max(FVector::Dist(Start, OnRay) - FMath::Sqrt(FMath::Square(Capsule.Radius) - DistSquared), 0.0f);
+		if (Distance < OutDistance)
+		{
+			OutDistance = Distance;
+			OutZone = Capsule.Zone;
+			bHit = true;
+		}
+	}
+
+	return bHit;
+}
+
+static FAutoConsoleCommandWithWorldAndArgs HitboxBenchCommand(
+	TEXT("ns.Fire.HitboxBench"),
+	TEXT("Spawns N characters (default 64) and resolves S shots per tick (default 64) against random ones over T ticks (default 200), with and without the hitbox cache. Fails if both disagree: ns.Fire.HitboxBench <N> <S> <T>"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		AGameModeBase* GameMode = World != nullptr ? World->GetAuthGameMode() : nullptr;
+		if (GameMode == nullptr)
+		{
+			UE_LOG(LogNS, Warning, TEXT("ns.Fire.HitboxBench only runs on the server"));
+			return;
+		}
+
+		const int32 NumCharacters = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 64;
+		const int32 ShotsPerTick = Args.Num() > 1 ? FMath::Max(FCString::Atoi(*Args[1]), 1) : 64;
+		const int32 Ticks = Args.Num() > 2 ? FMath::Max(FCString::Atoi(*Args[2]), 1) : 200;
+
+		UClass* CharacterClass = GameMode->DefaultPawnClass != nullptr && GameMode->DefaultPawnClass->IsChildOf(ANSCharacter::StaticClass())
+			? *GameMode->DefaultPawnClass : ANSCharacter::StaticClass();
+
+		// High above the level, each character animating its own pose
+		const FVector Start(0.0f, 0.0f, 100000.0f);
+		FActorSpawnParameters SpawnParams;
+		SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+		TArray<ANSCharacter*> Crowd;
+		for (int32 i = 0; i < NumCharacters; ++i)
+		{
+			const FVector Location = Start + FVector(200.0f * (i % 8), 200.0f * (i / 8), 0.0f);
+			ANSCharacter* Character = World->SpawnActor<ANSCharacter>(CharacterClass, Location, FRotator(0.0f, 45.0f * i, 0.0f), SpawnParams);
+			if (Character != nullptr)
+			{
+				Character->GetMesh()->MeshComponentUpdateFlag = EMeshComponentUpdateFlag::AlwaysTickPoseAndRefreshBones;
+				Character->GetMesh()->TickAnimation(0.1f * i, false);
+				Character->GetMesh()->RefreshBoneTransforms();
+				Crowd.Add(Character);
+			}
+		}
+
+		if (Crowd.Num() == 0)
+		{
+			UE_LOG(LogNS, Warning, TEXT("ns.Fire.HitboxBench could not spawn the characters"));
+			return;
+		}
+
+		const int32 PreviousCache = CVarHitboxCache.GetValueOnGameThread();
+
+		double Seconds[2];
+		int32 Hits[2];
+		int32 Headshots[2];
+		for (int32 Pass = 0; Pass < 2; ++Pass)
+		{
+			CVarHitboxCache->Set(Pass == 0 ? 0 : 1, ECVF_SetByCode);
+			Hits[Pass] = Headshots[Pass] = 0;
+
+			// Same shots in both passes
+			FRandomStream Random(1234);
+			const double StartTime = FPlatformTime::Seconds();
+			for (int32 Tick = 0; Tick < Ticks; ++Tick)
+			{
+				// A new server tick, with new poses
+				for (ANSCharacter* Character : Crowd)
+				{
+					Character->InvalidateHitboxes();
+				}
+
+				for (int32 Shot = 0; Shot < ShotsPerTick; ++Shot)
+				{
+					ANSCharacter* Target = Crowd[Random.RandHelper(Crowd.Num())];
+					const FVector Aim = Target->GetActorLocation() + FVector(0.0f, 0.0f, Random.FRandRange(-90.0f, 90.0f));
+					const FVector From = Aim + Random.GetUnitVector().GetSafeNormal2D() * 1000.0f;
+
+					ENSHitZone Zone;
+					float Distance;
+					if (Target->ResolveHitZone(From, Aim + (Aim - From), Zone, Distance))
+					{
+						Hits[Pass]++;
+						Headshots[Pass] += Zone == ENSHitZone::Head ? 1 : 0;
+					}
+				}
+			}
+			Seconds[Pass] = FPlatformTime::Seconds() - StartTime;
+		}
+		CVarHitboxCache->Set(PreviousCache, ECVF_SetByCode);
+
+		const int32 Shots = ShotsPerTick * Ticks;
+		UE_LOG(LogNS, Log, TEXT("ns.Fire.HitboxBench %d characters, %d shots per tick: uncached %.0f ns per shot, cached %.0f ns per shot (%.1fx). %d hits, %d to the head"),
+			Crowd.Num(), ShotsPerTick, Seconds[0] * 1e9 / Shots, Seconds[1] * 1e9 / Shots, Seconds[0] / FMath::Max(Seconds[1], 1e-9), Hits[1], Headshots[1]);
+
+		FNSPerfTracker::Expect(Hits[0] == Hits[1] && Headshots[0] == Headshots[1], TEXT("ns.Fire.HitboxBench"),
+			FString::Printf(TEXT("cached and uncached hitboxes disagree, %d/%d hits, %d/%d headshots"), Hits[0], Hits[1], Headshots[0], Headshots[1]));
+
+		for (ANSCharacter* Character : Crowd)
+		{
+			Character->Destroy();
+		}
+	}));
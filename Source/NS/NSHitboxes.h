@@ -0,0 +1,85 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+/** Body part a hitbox belongs to, scales the damage through the weapon */
+enum class ENSHitZone : uint8
+{
+	Head,
+	Torso,
+	Arm,
+	Leg,
+	Count
+};
+
+/**
+ * Simplified hitbox of one bone: a capsule from the bone to EndBone, or
+ * without EndBone, from the bone along its parent-to-bone direction
+ * scaled by Extend (the head, which has no child).
+ */
+struct FNSHitboxDef
+{
+	const TCHAR* Bone;
+	const TCHAR* EndBone;
+	ENSHitZone Zone;
+	float Radius;
+	float Extend;
+};
+
+/**
+ * Hitbox capsules of one character.
+ *
+ * The character's capsule is the broad phase: a shot that reaches it is then
+ * resolved against about a dozen bone capsules. Their world positions are
+ * evaluated from the skeletal mesh at most once per frame, on the first shot
+ * that reaches the character, and reused by every other shot of the frame, so
+ * crowded fights do not re-evaluate the skeleton per pellet. Bone indices are
+ * looked up once per mesh asset. ns.Fire.HitboxCache 0 evaluates the bones by
+ * name on every shot instead, for comparison with ns.Fire.HitboxBench.
+ */
+class FNSHitboxSet
+{
+public:
+	static const int32 MaxHitboxes = 16;
+
+	FNSHitboxSet();
+
+	static bool IsCacheEnabled();
+
+	/** Brings the capsules up to date with the pose of Mesh, once per frame while caching */
+	void Update(const USkeletalMeshComponent* Mesh);
+
+	/** The next Update evaluates the pose again, even within the same frame */
+	void Invalidate() { UpdatedFrame = MAX_uint64; }
+
+	/** No bone of the mesh matched the hitbox table, or there is no mesh */
+	bool IsEmpty() const { return NumCapsules == 0; }
+
+	/** Closest hitbox the segment goes through. False when it misses them all */
+	bool Raycast(const FVector& Start, const FVector& End, ENSHitZone& OutZone, float& OutDistance) const;
+
+private:
+	struct FCapsule
+	{
+		FVector Start;
+		FVector End;
+		float Radius;
+		ENSHitZone Zone;
+	};
+
+	void Bind(const USkeletalMeshComponent* Mesh);
+	void EvaluateCached(const USkeletalMeshComponent* Mesh);
+	void EvaluateByName(const USkeletalMeshComponent* Mesh);
+
+	/** Mesh asset the bone indices belong to */
+	const USkeletalMesh* BoundMesh;
+
+	/** Bone, end bone (or parent, when extending) per hitbox. INDEX_NONE when missing from the skeleton */
+	int32 BoneIndices[MaxHitboxes];
+	int32 EndBoneIndices[MaxHitboxes];
+
+	FCapsule Capsules[MaxHitboxes];
+	int32 NumCapsules;
+
+	uint64 UpdatedFrame;
+};
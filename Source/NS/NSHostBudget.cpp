@@ -0,0 +1,226 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "NS.h"
+#include "NSHostBudget.h"
+#include "NSCharacter.h"
+#include "NSPerfTracker.h"
+#include "RenderCore.h"
+#include "RHI.h"
+
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Host Simulation (ms)"), STAT_NSHostSimulation, STATGROUP_NS);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Host Screen Percentage"), STAT_NSHostScreenPercentage, STATGROUP_NS);
+
+/** Screen percentage change per review, down fast and up slowly */
+static const int32 ScreenPercentageDownStep = 10;
+static const int32 ScreenPercentageUpStep = 5;
+
+/** Render time under this fraction of its budget gives resolution back */
+static const float RenderHeadroom = 0.8f;
+
+FNSHostBudget::FNSHostBudget()
+	: bActive(false)
+	, FrameBudgetMs(1000.0f / 60.0f)
+	, SimBudgetMs(4.0f)
+	, MinScreenPercentage(50)
+	, SimulationStart(0.0)
+	, LastSimulationMs(0.0f)
+	, ScreenPercentage(100)
+	, WindowTime(0.0f)
+	, WindowRenderMs(0.0f)
+	, WindowFrames(0)
+{
+}
+
+void FNSHostBudget::Configure(float InFrameBudgetMs, float InSimBudgetMs, int32 InMinScreenPercentage)
+{
+	FrameBudgetMs = FMath::Max(InFrameBudgetMs, 1.0f);
+	SimBudgetMs = FMath::Clamp(InSimBudgetMs, 0.1f, FrameBudgetMs);
+	MinScreenPercentage = FMath::Clamp(InMinScreenPercentage, 10, 100);
+}
+
+void FNSHostBudget::SetActive(bool bInActive)
+{
+	if (bActive && !bInActive)
+	{
+		SetScreenPercentage(100);
+	}
+	bActive = bInActive;
+}
+
+void FNSHostBudget::BeginSimulation()
+{
+	SimulationStart = FPlatformTime::Seconds();
+}
+
+bool FNSHostBudget::HasSimulationTime() const
+{
+	return !bActive || (FPlatformTime::Seconds() - SimulationStart) * 1000.0 < SimBudgetMs;
+}
+
+void FNSHostBudget::EndSimulation(float DeltaSeconds)
+{
+	LastSimulationMs = (float)((FPlatformTime::Seconds() - SimulationStart) * 1000.0);
+	SET_FLOAT_STAT(STAT_NSHostSimulation, LastSimulationMs);
+
+	if (!bActive)
+	{
+		return;
+	}
+
+	// The render thread and the GPU run beside the game thread, the slower one bounds the frame
+	WindowRenderMs += FMath::Max(FPlatformTime::ToMilliseconds(GRenderThreadTime), FPlatformTime::ToMilliseconds(GGPUFrameTime));
+	WindowFrames++;
+	WindowTime += DeltaSeconds;
+	if (WindowTime < 0.5f)
+	{
+		return;
+	}
+
+	const float RenderMs = WindowRenderMs / WindowFrames;
+	const float RenderBudgetMs = FrameBudgetMs - SimBudgetMs;
+	if (RenderMs > RenderBudgetMs)
+	{
+		SetScreenPercentage(FMath::Max(ScreenPercentage - ScreenPercentageDownStep, MinScreenPercentage));
+	}
+	else if (RenderMs < RenderBudgetMs * RenderHeadroom)
+	{
+		SetScreenPercentage(FMath::Min(ScreenPercentage + ScreenPercentageUpStep, 100));
+	}
+
+	WindowTime = 0.0f;
+	WindowRenderMs = 0.0f;
+	WindowFrames = 0;
+}
+
+void FNSHostBudget::SetScreenPercentage(int32 Percentage)
+{
+	if (Percentage == ScreenPercentage)
+	{
+		return;
+	}
+	ScreenPercentage = Percentage;
+	SET_DWORD_STAT(STAT_NSHostScreenPercentage, ScreenPercentage);
+
+	static IConsoleVariable* CVarScreenPercentage = IConsoleManager::Get().FindConsoleVariable(TEXT("r.ScreenPercentage"));
+	if (CVarScreenPercentage != nullptr)
+	{
+		CVarScreenPercentage->Set((float)ScreenPercentage, ECVF_SetByCode);
+	}
+}
+
+/** Frame times gathered by ns.Host.Bench for one local player count */
+struct FNSHostBenchSample
+{
+	double FrameMs;
+	double GameMs;
+	double SimulationMs;
+	double RenderMs;
+	double GPUMs;
+	int32 Frames;
+};
+
+static FAutoConsoleCommandWithWorldAndArgs HostBenchCommand(
+	TEXT("ns.Host.Bench"),
+	TEXT("On a listen server, measures the host frame with 1 to 4 split-screen players and 16 remote players for the given seconds each. Bots stand in for the remote players not connected. Fails if a render over its budget does not lower the resolution: ns.Host.Bench <Seconds> <Remote>"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		ANSGameMode* GameMode = World != nullptr ? World->GetAuthGameMode<ANSGameMode>() : nullptr;
+		UGameInstance* GameInstance = World != nullptr ? World->GetGameInstance() : nullptr;
+		if (GameMode == nullptr || GameInstance == nullptr || World->GetNetMode() != NM_ListenServer)
+		{
+			UE_LOG(LogNS, Warning, TEXT("ns.Host.Bench needs a listen server"));
+			return;
+		}
+
+		const float Seconds = Args.Num() > 0 ? FMath::Max(FCString::Atof(*Args[0]), 1.0f) : 10.0f;
+		const int32 Remote = Args.Num() > 1 ? FMath::Max(FCString::Atoi(*Args[1]), 0) : 16;
+
+		const int32 Connected = World->GetNetDriver() != nullptr ? World->GetNetDriver()->ClientConnections.Num() : 0;
+		for (int32 i = Connected; i < Remote; ++i)
+		{
+			GameMode->AddBot();
+		}
+
+		UE_LOG(LogNS, Log, TEXT("ns.Host.Bench: %d remote clients and %d bots, %.0f s per split-screen layout"), Connected, FMath::Max(Remote - Connected, 0), Seconds);
+
+		const int32 InitialLocalPlayers = GameInstance->GetNumLocalPlayers();
+		TSharedRef<int32> LocalPlayers = MakeShareable(new int32(0));
+		TSharedRef<float> Elapsed = MakeShareable(new float(Seconds));
+		TSharedRef<FNSHostBenchSample> Sample = MakeShareable(new FNSHostBenchSample());
+		TWeakObjectPtr<UWorld> WeakWorld(World);
+
+		FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([=](float DeltaTime)
+		{
+			UWorld* BenchWorld = WeakWorld.Get();
+			ANSGameMode* BenchGameMode = BenchWorld != nullptr ? BenchWorld->GetAuthGameMode<ANSGameMode>() : nullptr;
+			if (BenchGameMode == nullptr)
+			{
+				return false;
+			}
+
+			FNSHostBenchSample& Current = *Sample;
+			if (*Elapsed < 0.0f)
+			{
+				*Elapsed += DeltaTime;
+				return true;
+			}
+
+			if (*Elapsed < Seconds)
+			{
+				Current.FrameMs += DeltaTime * 1000.0;
+				Current.GameMs += FPlatformTime::ToMilliseconds(GGameThreadTime);
+				Current.SimulationMs += BenchGameMode->GetHostBudget().GetLastSimulationMs();
+				Current.RenderMs += FPlatformTime::ToMilliseconds(GRenderThreadTime);
+				Current.GPUMs += FPlatformTime::ToMilliseconds(GGPUFrameTime);
+				Current.Frames++;
+				*Elapsed += DeltaTime;
+				return true;
+			}
+
+			if (*LocalPlayers > 0)
+			{
+				const double Frames = FMath::Max(Current.Frames, 1);
+				UE_LOG(LogNS, Log, TEXT("ns.Host.Bench: %d local players: frame %.2f ms, game %.2f ms (simulation %.2f ms), render %.2f ms, GPU %.2f ms, screen %d%%"),
+					*LocalPlayers, Current.FrameMs / Frames, Current.GameMs / Frames, Current.SimulationMs / Frames,
+					Current.RenderMs / Frames, Current.GPUMs / Frames, BenchGameMode->GetHostBudget().GetScreenPercentage());
+
+				// The first step of a frame always runs, so a slow machine can overrun the simulation
+				// budget without anything being wrong: only report it. A render over its share must
+				// have lowered the resolution though
+				const FNSHostBudget& Budget = BenchGameMode->GetHostBudget();
+				const double RenderMs = FMath::Max(Current.RenderMs, Current.GPUMs) / Frames;
+				if (Current.SimulationMs / Frames > Budget.GetSimBudgetMs())
+				{
+					UE_LOG(LogNS, Warning, TEXT("ns.Host.Bench: %d local players: simulation %.2f ms for a budget of %.2f ms"), *LocalPlayers, Current.SimulationMs / Frames, Budget.GetSimBudgetMs());
+				}
+				FNSPerfTracker::Expect(RenderMs <= Budget.GetRenderBudgetMs() || Budget.GetScreenPercentage() < 100, TEXT("ns.Host.Bench"),
+					FString::Printf(TEXT("%d local players: render %.2f ms for a budget of %.2f ms at full resolution"), *LocalPlayers, RenderMs, Budget.GetRenderBudgetMs()));
+			}
+
+			UGameInstance* BenchGameInstance = BenchWorld->GetGameInstance();
+			if (++*LocalPlayers > 4)
+			{
+				// Back to the players we started with
+				while (BenchGameInstance->GetNumLocalPlayers() > InitialLocalPlayers)
+				{
+					BenchGameInstance->RemoveLocalPlayer(BenchGameInstance->GetLocalPlayers().Last());
+				}
+				return false;
+			}
+
+			FString Error;
+			while (BenchGameInstance->GetNumLocalPlayers() < *LocalPlayers)
+			{
+				if (BenchGameInstance->CreateLocalPlayer(-1, Error, true) == nullptr)
+				{
+					UE_LOG(LogNS, Warning, TEXT("ns.Host.Bench could not add a local player: %s"), *Error);
+					return false;
+				}
+			}
+
+			// The first second after a layout change is spent spawning and streaming, leave it out
+			FMemory::Memzero(Current);
+			*Elapsed = -1.0f;
+			return true;
+		}));
+	}));
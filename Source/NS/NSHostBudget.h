@@ -0,0 +1,65 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+/**
+ * Splits the frame of a listen-server host between the authoritative
+ * simulation and the rendering of its local, possibly split-screen, players.
+ *
+ * The simulation gets SimBudgetMs per frame: once spent, the remaining
+ * fixed steps go back to the server clock for the next frame instead of
+ * delaying the local views. Rendering gets the rest of FrameBudgetMs; twice
+ * a second the render thread and GPU times are checked against it and the
+ * screen percentage of the local views lowered or raised accordingly, so a
+ * heavy local scene does not slow the simulation the remote clients see.
+ * Inactive, every call is a no-op, as on dedicated servers and clients.
+ */
+class FNSHostBudget
+{
+public:
+	FNSHostBudget();
+
+	void Configure(float FrameBudgetMs, float SimBudgetMs, int32 MinScreenPercentage);
+
+	/** Only listen servers render and simulate in the same frame */
+	void SetActive(bool bInActive);
+	bool IsActive() const { return bActive; }
+
+	/** Call when the simulation of the frame starts */
+	void BeginSimulation();
+
+	/** Whether another simulation step still fits the budget of this frame */
+	bool HasSimulationTime() const;
+
+	/** Call when the simulation of the frame ends, reviews the render budget */
+	void EndSimulation(float DeltaSeconds);
+
+	/** Simulation time of the last frame, in milliseconds */
+	float GetLastSimulationMs() const { return LastSimulationMs; }
+
+	int32 GetScreenPercentage() const { return ScreenPercentage; }
+
+	float GetSimBudgetMs() const { return SimBudgetMs; }
+
+	/** What the frame budget leaves to the render thread and the GPU */
+	float GetRenderBudgetMs() const { return FrameBudgetMs - SimBudgetMs; }
+
+private:
+	void SetScreenPercentage(int32 Percentage);
+
+	bool bActive;
+
+	float FrameBudgetMs;
+	float SimBudgetMs;
+	int32 MinScreenPercentage;
+
+	double SimulationStart;
+	float LastSimulationMs;
+
+	int32 ScreenPercentage;
+
+	/** Current half second window of render and GPU times */
+	float WindowTime;
+	float WindowRenderMs;
+	int32 WindowFrames;
+};
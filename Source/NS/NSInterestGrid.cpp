@@ -0,0 +1,88 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "NS.h"
+#include "NSInterestGrid.h"
+#include "NSPlayerController.h"
+#include "NSPlayerState.h"
+
+static TAutoConsoleVariable<int32> CVarInterest(
+	TEXT("ns.Net.Interest"),
+	1,
+	TEXT("Sends shot effects and ragdolls only to the players that can see or hear them. 0 multicasts them to everyone."));
+
+FNSInterestGrid::FNSInterestGrid()
+	: BuiltFrame(0)
+{
+	Settings.AudibleRange = 4000.0f;
+	Settings.VisibleRange = 10000.0f;
+	Settings.LowFidelityRange = 15000.0f;
+	Settings.ViewConeDegrees = 120.0f;
+}
+
+bool FNSInterestGrid::IsEnabled()
+{
+	return CVarInterest.GetValueOnGameThread() != 0;
+}
+
+ENSInterest FNSInterestGrid::GetInterest(const FNSInterestSettings& Settings, const FVector& ViewLocation, const FVector& ViewDirection, bool bSameTeam, const FVector& EventLocation)
+{
+	const FVector ToEvent = EventLocation - ViewLocation;
+	const float DistSquared = ToEvent.SizeSquared();
+
+	if (DistSquared <= FMath::Square(Settings.AudibleRange))
+	{
+		return ENSInterest::Full;
+	}
+
+	if (DistSquared <= FMath::Square(Settings.VisibleRange))
+	{
+		const float CosHalfCone = FMath::Cos(FMath::DegreesToRadians(Settings.ViewConeDegrees * 0.5f));
+		if (bSameTeam || (ToEvent | ViewDirection) >= CosHalfCone * FMath::Sqrt(DistSquared))
+		{
+			return ENSInterest::Full;
+		}
+	}
+
+	return DistSquared <= FMath::Square(Settings.LowFidelityRange) ? ENSInterest::Low : ENSInterest::None;
+}
+
+FIntPoint FNSInterestGrid::GetCell(const FVector& Location) const
+{
+	return FIntPoint(FMath::FloorToInt(Location.X / Settings.LowFidelityRange), FMath::FloorToInt(Location.Y / Settings.LowFidelityRange));
+}
+
+void FNSInterestGrid::Rebuild(UWorld* World)
+{
+	BuiltFrame = GFrameCounter;
+	Viewers.Reset();
+
+	// Keep the arrays of the cells, most of them are reused next frame
+	for (auto& Cell : Cells)
+	{
+		Cell.Value.Reset();
+	}
+
+	for (FConstPlayerControllerIterator Iter = World->GetPlayerControllerIterator(); Iter; ++Iter)
+	{
+		ANSPlayerController* Controller = Cast<ANSPlayerController>(*Iter);
+		const ANSPlayerState* PS = Controller != nullptr ? Cast<ANSPlayerState>(Controller->PlayerState) : nullptr;
+
+		// The listen server plays its own effects, bots have nobody to send them to
+		if (PS == nullptr || Controller->IsLocalController())
+		{
+			continue;
+		}
+
+		FVector ViewLocation;
+		FRotator ViewRotation;
+		Controller->GetPlayerViewPoint(ViewLocation, ViewRotation);
+
+		const int32 Index = Viewers.AddUninitialized();
+		Viewers[Index].Controller = Controller;
+		Viewers[Index].Location = ViewLocation;
+		Viewers[Index].Direction = ViewRotation.Vector();
+		Viewers[Index].Team = PS->Team;
+
+		Cells.FindOrAdd(GetCell(ViewLocation)).Add(Index);
+	}
+}
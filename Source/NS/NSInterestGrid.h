@@ -0,0 +1,110 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+enum class ETeam : uint8;
+
+/** How much of a cosmetic event a player gets */
+enum class ENSInterest : uint8
+{
+	None,
+	/** Far away, a cheap version of the event */
+	Low,
+	/** Heard or possibly seen, the whole event */
+	Full
+};
+
+struct FNSInterestSettings
+{
+	/** Events closer than this are always sent in full */
+	float AudibleRange;
+
+	/** Events closer than this are sent in full when inside the view cone or shot by a teammate */
+	float VisibleRange;
+
+	/** Events closer than this get the low fidelity version. Also the grid cell size */
+	float LowFidelityRange;
+
+	/** Full angle of the view cone, wider than the camera to allow for turning */
+	float ViewConeDegrees;
+};
+
+/**
+ * Server-side interest filter for cosmetic events.
+ *
+ * Remote players are bucketed by view location into coarse 2D cells the
+ * size of LowFidelityRange, rebuilt lazily once per frame, so an event
+ * only checks the players in its own and the 8 neighbouring cells.
+ * Disabled with ns.Net.Interest 0, which goes back to multicasts.
+ */
+class FNSInterestGrid
+{
+public:
+	FNSInterestGrid();
+
+	FNSInterestSettings Settings;
+
+	static bool IsEnabled();
+
+	/** Interest of a viewer in an event, the same test the grid runs for each candidate */
+	static ENSInterest GetInterest(const FNSInterestSettings& Settings, const FVector& ViewLocation, const FVector& ViewDirection, bool bSameTeam, const FVector& EventLocation);
+
+	/** Calls Visit(Controller, Interest) for every remote player with some interest in an event at Location */
+	template<typename VisitorType>
+	void ForEachInterested(UWorld* World, const FVector& Location, ETeam Team, VisitorType Visit);
+
+	/** Rebuilds the cells on the next event, for controllers leaving mid frame */
+	void Invalidate() { BuiltFrame = 0; }
+
+private:
+	struct FViewer
+	{
+		class ANSPlayerController* Controller;
+		FVector Location;
+		FVector Direction;
+		ETeam Team;
+	};
+
+	void Rebuild(UWorld* World);
+
+	FIntPoint GetCell(const FVector& Location) const;
+
+	TArray<FViewer> Viewers;
+
+	TMap<FIntPoint, TArray<int32, TInlineAllocator<8>>> Cells;
+
+	/** Frame the cells were built in */
+	uint64 BuiltFrame;
+};
+
+template<typename VisitorType>
+void FNSInterestGrid::ForEachInterested(UWorld* World, const FVector& Location, ETeam Team, VisitorType Visit)
+{
+	if (BuiltFrame != GFrameCounter)
+	{
+		Rebuild(World);
+	}
+
+	const FIntPoint Center = GetCell(Location);
+	for (int32 Y = -1; Y <= 1; ++Y)
+	{
+		for (int32 X = -1; X <= 1; ++X)
+		{
+			const TArray<int32, TInlineAllocator<8>>* Cell = Cells.Find(FIntPoint(Center.X + X, Center.Y + Y));
+			if (Cell == nullptr)
+			{
+				continue;
+			}
+
+			for (int32 Index : *Cell)
+			{
+				const FViewer& Viewer = Viewers[Index];
+				const ENSInterest Interest = GetInterest(Settings, Viewer.Location, Viewer.Direction, Viewer.Team == Team, Location);
+				if (Interest != ENSInterest::None)
+				{
+					Visit(Viewer.Controller, Interest);
+				}
+			}
+		}
+	}
+}
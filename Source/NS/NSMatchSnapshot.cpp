@@ -0,0 +1,255 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "NS.h"
+#include "NSMatchSnapshot.h"
+#include "NSGameState.h"
+#include "NSPlayerState.h"
+#include "NSCharacter.h"
+
+DECLARE_CYCLE_STAT(TEXT("Match Snapshot"), STAT_NSMatchSnapshot, STATGROUP_NS);
+
+static TAutoConsoleVariable<int32> CVarJoinSnapshot(
+	TEXT("ns.Net.JoinSnapshot"),
+	1,
+	TEXT("1 sends a joining player the roster, teams and scores in one stream. 0 sends only the header, so the client log shows how long replication alone takes to sync. To measure, add 63 bots with ns.Bots.Add and join."));
+
+/** A join still not synced after this many seconds is logged as timed out */
+static const double JoinSyncTimeout = 30.0;
+
+enum ENSSnapshotPlayerFlags : uint8
+{
+	SnapshotFlag_Bot = 1 << 0,
+	SnapshotFlag_Alive = 1 << 1
+};
+
+bool FNSMatchSnapshot::IsEnabled()
+{
+	return CVarJoinSnapshot.GetValueOnGameThread() != 0;
+}
+
+void FNSMatchSnapshot::Write(UWorld* World, TArray<uint8>& OutData)
+{
+	SCOPE_CYCLE_COUNTER(STAT_NSMatchSnapshot);
+
+	OutData.Reset();
+	FMemoryWriter Writer(OutData);
+
+	const AGameStateBase* GameState = World->GetGameState();
+	int32 NumPlayers = 0;
+	if (GameState != nullptr)
+	{
+		for (const APlayerState* PlayerState : GameState->PlayerArray)
+		{
+			NumPlayers += Cast<ANSPlayerState>(PlayerState) != nullptr ? 1 : 0;
+		}
+	}
+
+	uint8 Version = FormatVersion;
+	uint8 bRoster = IsEnabled() ? 1 : 0;
+	Writer << Version << NumPlayers << bRoster;
+
+	if (!bRoster || NumPlayers == 0)
+	{
+		return;
+	}
+
+	for (APlayerState* PlayerState : GameState->PlayerArray)
+	{
+		ANSPlayerState* PS = Cast<ANSPlayerState>(PlayerState);
+		if (PS == nullptr)
+		{
+			continue;
+		}
+
+		// The controller owns the player state, its pawn is the living character
+		const AController* Controller = Cast<AController>(PS->GetOwner());
+		const ANSCharacter* Character = Controller != nullptr ? Cast<ANSCharacter>(Controller->GetPawn()) : nullptr;
+		const bool bAlive = Character != nullptr && PS->Health > 0.0f;
+
+		int32 PlayerId = PS->PlayerId;
+		uint8 Team = (uint8)PS->Team;
+		int32 Score = FMath::RoundToInt(PS->Score);
+		uint8 Flags = (PS->bIsABot ? SnapshotFlag_Bot : 0) | (bAlive ? SnapshotFlag_Alive : 0);
+
+		Writer << PlayerId << PS->PlayerName << Team << Score << PS->Deaths << Flags;
+	}
+}
+
+bool FNSMatchSnapshot::Read(const TArray<uint8>& Data, int32& OutNumPlayers, TArray<FNSSnapshotPlayer>& OutPlayers)
+{
+	FMemoryReader Reader(Data);
+
+	uint8 Version = 0;
+	uint8 bRoster = 0;
+	OutNumPlayers = 0;
+	Reader << Version;
+	if (Reader.IsError() || Version != FormatVersion)
+	{
+		return false;
+	}
+
+	Reader << OutNumPlayers << bRoster;
+	if (Reader.IsError() || OutNumPlayers < 0)
+	{
+		return false;
+	}
+
+	OutPlayers.Reset();
+	if (!bRoster)
+	{
+		return true;
+	}
+
+	// A player takes at least 15 bytes, more players than that is a corrupt stream
+	if (OutNumPlayers > Data.Num() / 15)
+	{
+		return false;
+	}
+
+	OutPlayers.Reserve(OutNumPlayers);
+	for (int32 i = 0; i < OutNumPlayers; ++i)
+	{
+		FNSSnapshotPlayer& Player = OutPlayers[OutPlayers.AddDefaulted()];
+
+		uint8 Team = 0;
+		uint8 Flags = 0;
+		Reader << Player.PlayerId << Player.Name << Team << Player.Score << Player.Deaths << Flags;
+
+		Player.Team = Team == (uint8)ETeam::RED_TEAM ? ETeam::RED_TEAM : ETeam::BLUE_TEAM;
+		Player.bBot = (Flags & SnapshotFlag_Bot) != 0;
+		Player.bAlive = (Flags & SnapshotFlag_Alive) != 0;
+
+		if (Reader.IsError())
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+FNSJoinSync::FNSJoinSync()
+	: ExpectedPlayers(0)
+	, SnapshotBytes(0)
+	, StartTime(0.0)
+	, SnapshotTime(0.0)
+	, ScoreboardTime(0.0)
+	, PlayerStatesTime(0.0)
+	, bTracking(false)
+{
+}
+
+void FNSJoinSync::Begin()
+{
+	PendingPlayers.Reset();
+	ExpectedPlayers = 0;
+	SnapshotBytes = 0;
+	StartTime = FPlatformTime::Seconds();
+	SnapshotTime = ScoreboardTime = PlayerStatesTime = 0.0;
+	bTracking = true;
+}
+
+void FNSJoinSync::Apply(UWorld* World, const TArray<uint8>& Data)
+{
+	// The controller may replicate its RPC before it begins play
+	if (!bTracking)
+	{
+		Begin();
+	}
+
+	TArray<FNSSnapshotPlayer> Players;
+	if (!FNSMatchSnapshot::Read(Data, ExpectedPlayers, Players))
+	{
+		UE_LOG(LogNS, Warning, TEXT("Join snapshot of %d bytes ignored, malformed or not version %d"), Data.Num(), FNSMatchSnapshot::FormatVersion);
+		bTracking = false;
+		return;
+	}
+
+	SnapshotTime = FPlatformTime::Seconds();
+	SnapshotBytes = Data.Num();
+	PendingPlayers = MoveTemp(Players);
+
+	// One scoreboard rebuild for every player of the snapshot
+	ANSGameState* GameState = World->GetGameState<ANSGameState>();
+	if (GameState != nullptr)
+	{
+		GameState->NotifyScoreboardChanged();
+	}
+}
+
+void FNSJoinSync::Tick(const APlayerController* Controller)
+{
+	if (!bTracking || SnapshotTime == 0.0)
+	{
+		return;
+	}
+
+	ANSGameState* GameState = Controller->GetWorld()->GetGameState<ANSGameState>();
+	if (GameState == nullptr)
+	{
+		return;
+	}
+
+	const double Now = FPlatformTime::Seconds();
+
+	// Players whose state arrived with the team of the snapshot leave the pending list
+	int32 NumStates = 0;
+	for (const APlayerState* PlayerState : GameState->PlayerArray)
+	{
+		const ANSPlayerState* PS = Cast<ANSPlayerState>(PlayerState);
+		if (PS == nullptr)
+		{
+			continue;
+		}
+		NumStates++;
+
+		const int32 Pending = PendingPlayers.IndexOfByPredicate([PS](const FNSSnapshotPlayer& Player) { return Player.PlayerId == PS->PlayerId; });
+		if (Pending != INDEX_NONE && PendingPlayers[Pending].Team == PS->Team)
+		{
+			PendingPlayers.RemoveAtSwap(Pending);
+			GameState->NotifyScoreboardChanged();
+		}
+	}
+
+	if (ScoreboardTime == 0.0 && NumStates + PendingPlayers.Num() >= ExpectedPlayers)
+	{
+		ScoreboardTime = Now;
+	}
+	if (PlayerStatesTime == 0.0 && PendingPlayers.Num() == 0 && NumStates >= ExpectedPlayers)
+	{
+		PlayerStatesTime = Now;
+	}
+
+	// Only the pawns the server considers relevant to us arrive, each living one must know its
+	// player. Corpses have no player state and no capsule collision
+	int32 ArrivedPawns = 0;
+	int32 LinkedPawns = 0;
+	for (TActorIterator<ANSCharacter> Iter(Controller->GetWorld()); Iter; ++Iter)
+	{
+		if (Iter->GetCapsuleComponent()->IsCollisionEnabled())
+		{
+			ArrivedPawns++;
+			LinkedPawns += Iter->PlayerState != nullptr ? 1 : 0;
+		}
+	}
+
+	const bool bSynced = PlayerStatesTime > 0.0 && LinkedPawns == ArrivedPawns;
+	const bool bTimedOut = Now - StartTime > JoinSyncTimeout;
+	if (!bSynced && !bTimedOut)
+	{
+		return;
+	}
+
+	const auto Elapsed = [this](double Time) { return Time > 0.0 ? (Time - StartTime) * 1000.0 : -1.0; };
+
+	UE_LOG(LogNS, Log, TEXT("Join %s in %.0f ms: snapshot of %d bytes after %.0f ms, scoreboard of %d players after %.0f ms, player states after %.0f ms, %d of %d pawns with their player state"),
+		bSynced ? TEXT("synced") : TEXT("timed out"), (Now - StartTime) * 1000.0, SnapshotBytes, Elapsed(SnapshotTime),
+		ExpectedPlayers, Elapsed(ScoreboardTime), Elapsed(PlayerStatesTime), LinkedPawns, ArrivedPawns);
+
+	bTracking = false;
+	if (PendingPlayers.Num() > 0)
+	{
+		PendingPlayers.Empty();
+		GameState->NotifyScoreboardChanged();
+	}
+}
@@ -0,0 +1,87 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+enum class ETeam : uint8;
+
+/** One player of the match as the snapshot carries it */
+struct FNSSnapshotPlayer
+{
+	int32 PlayerId;
+	FString Name;
+	ETeam Team;
+	int32 Score;
+	uint8 Deaths;
+	bool bBot;
+	bool bAlive;
+};
+
+/**
+ * Match state sent to a joining player in one reliable RPC.
+ *
+ * Without it a client builds its roster from the player states and
+ * characters replication opens one channel at a time, and player states
+ * update once per second, so with a full server the scoreboard fills over
+ * several seconds. The snapshot packs rosters, teams and scores into a byte
+ * stream the client applies at once; the HUD shows those players until their
+ * replicated player states arrive. Pawns are left to replication, which
+ * sends each one with its location and team when it becomes relevant.
+ *
+ * The stream starts with FormatVersion, a client that reads another version
+ * ignores it. ns.Net.JoinSnapshot 0 on the server sends only the header, so
+ * the client still measures how long replication alone takes to sync.
+ */
+class FNSMatchSnapshot
+{
+public:
+	/** Bumped whenever the stream layout changes */
+	static const uint8 FormatVersion = 2;
+
+	static bool IsEnabled();
+
+	/** Server: writes every player of World */
+	static void Write(UWorld* World, TArray<uint8>& OutData);
+
+	/** Client: reads a stream written by Write. False when it is malformed or of another version */
+	static bool Read(const TArray<uint8>& Data, int32& OutNumPlayers, TArray<FNSSnapshotPlayer>& OutPlayers);
+};
+
+/**
+ * Client side of a join: holds the players of the snapshot until their player
+ * states replicate and measures the time from BeginPlay of the local controller
+ * to the snapshot, to a complete scoreboard, and to fully synced, which is
+ * every snapshot player's state with its team and every replicated pawn
+ * linked to its player state. Logged once, see ns.Net.JoinSnapshot.
+ */
+class FNSJoinSync
+{
+public:
+	FNSJoinSync();
+
+	void Begin();
+
+	/** Takes the players of a received snapshot */
+	void Apply(UWorld* World, const TArray<uint8>& Data);
+
+	/** Checks the replicated state against the snapshot, until synced or timed out */
+	void Tick(const APlayerController* Controller);
+
+	/** Snapshot players whose player state has not replicated yet, for the scoreboard */
+	const TArray<FNSSnapshotPlayer>& GetPendingPlayers() const { return PendingPlayers; }
+
+private:
+	TArray<FNSSnapshotPlayer> PendingPlayers;
+
+	/** Players in the snapshot */
+	int32 ExpectedPlayers;
+
+	int32 SnapshotBytes;
+
+	/** FPlatformTime::Seconds at each step, 0 until reached */
+	double StartTime;
+	double SnapshotTime;
+	double ScoreboardTime;
+	double PlayerStatesTime;
+
+	bool bTracking;
+};
@@ -0,0 +1,269 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "NS.h"
+#include "NSMatchStats.h"
+#include "NSPlayerState.h"
+#include "Hash/CityHash.h"
+
+static TAutoConsoleVariable<int32> CVarStatsEnable(
+	TEXT("ns.Stats.Enable"),
+	1,
+	TEXT("Appends the kills, deaths, spawns, shots and hits of every match to Saved/Stats/NSStats.dat on the server. Read when a match begins."));
+
+/** Records gathered before a flush is forced, even inside the second */
+static const int32 FlushRecords = 4096;
+
+static bool bMatchOpen = false;
+static uint32 MatchId = 0;
+static double MatchStartSeconds = 0.0;
+static double StatsNextFlushTime = 0.0;
+
+/** Index in the data file of the first record of the match and of the next record queued */
+static uint64 FirstMatchRecord = 0;
+static uint64 NextRecord = 0;
+
+static TArray<FNSStatsRecord> PendingRecords;
+static FString PendingNames;
+
+/** Ids of the players seen this match, and the ones already written to the names file this session */
+static TMap<TWeakObjectPtr<const ANSPlayerState>, uint64> PlayerIds;
+static TSet<uint64> NamedPlayers;
+
+/** Only touched by the write tasks while a match is open */
+static IFileHandle* DataFile = nullptr;
+static IFileHandle* IndexFile = nullptr;
+
+/** Last write dispatched, every write waits for the previous one so the file stays in order */
+static FGraphEventRef LastWrite;
+
+static void DispatchWrite(TFunction<void()> Write)
+{
+	FGraphEventArray Prerequisites;
+	if (LastWrite.IsValid())
+	{
+		Prerequisites.Add(LastWrite);
+	}
+	LastWrite = FFunctionGraphTask::CreateAndDispatchWhenReady(MoveTemp(Write), TStatId(), &Prerequisites);
+}
+
+static void FlushStats()
+{
+	if (PendingRecords.Num() == 0 && PendingNames.IsEmpty())
+	{
+		return;
+	}
+
+	TArray<FNSStatsRecord> Records = MoveTemp(PendingRecords);
+	FString Names = MoveTemp(PendingNames);
+	PendingRecords.Reserve(FlushRecords);
+
+	DispatchWrite([Records = MoveTemp(Records), Names = MoveTemp(Names)]()
+	{
+		if (Records.Num() > 0)
+		{
+			DataFile->Write((const uint8*)Records.GetData(), Records.Num() * sizeof(FNSStatsRecord));
+		}
+		if (!Names.IsEmpty())
+		{
+			FFileHelper::SaveStringToFile(Names, *FNSMatchStats::GetNamesPath(), FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM, &IFileManager::Get(), FILEWRITE_Append);
+		}
+	});
+}
+
+static uint64 GetPlayerId(const ANSPlayerState* Player)
+{
+	if (Player == nullptr)
+	{
+		return 0;
+	}
+
+	if (const uint64* Id = PlayerIds.Find(Player))
+	{
+		return *Id;
+	}
+
+	const uint64 Id = FNSMatchStats::HashPlayerKey(Player->UniqueId.IsValid() ? Player->UniqueId.ToString() : Player->PlayerName);
+	PlayerIds.Add(Player, Id);
+
+	if (!NamedPlayers.Contains(Id))
+	{
+		NamedPlayers.Add(Id);
+		PendingNames += FString::Printf(TEXT("%llu,%s\n"), Id, *Player->PlayerName);
+	}
+	return Id;
+}
+
+static void AddRecord(ENSStatsEvent Event, uint64 PlayerId, uint64 OtherId, float Value, uint8 Team)
+{
+	FNSStatsRecord& Entry = PendingRecords[PendingRecords.AddUninitialized()];
+	Entry.MatchId = MatchId;
+	Entry.Time = (float)(FPlatformTime::Seconds() - MatchStartSeconds);
+	Entry.PlayerId = PlayerId;
+	Entry.OtherId = OtherId;
+	Entry.Value = Value;
+	Entry.Event = (uint8)Event;
+	Entry.Team = Team;
+	Entry.Reserved[0] = Entry.Reserved[1] = 0;
+
+	++NextRecord;
+}
+
+bool FNSMatchStats::IsEnabled()
+{
+	return bMatchOpen;
+}
+
+void FNSMatchStats::BeginMatch()
+{
+	check(IsInGameThread());
+
+	if (bMatchOpen || CVarStatsEnable.GetValueOnGameThread() == 0)
+	{
+		return;
+	}
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	PlatformFile.CreateDirectoryTree(*FPaths::GetPath(GetDataPath()));
+
+	const uint32 LastMatchId = ReadLastMatchId(GetDataPath());
+
+	DataFile = PlatformFile.OpenWrite(*GetDataPath(), true, false);
+	IndexFile = PlatformFile.OpenWrite(*GetIndexPath(), true, false);
+
+	const int64 Size = DataFile != nullptr ? DataFile->Size() : 0;
+	if (DataFile == nullptr || IndexFile == nullptr || (Size > 0 && Size < (int64)sizeof(FNSStatsFileHeader)))
+	{
+		UE_LOG(LogNS, Warning, TEXT("Match stats disabled, could not open %s"), *GetDataPath());
+		delete DataFile;
+		delete IndexFile;
+		DataFile = IndexFile = nullptr;
+		return;
+	}
+
+	int64 RecordBytes = Size - (int64)sizeof(FNSStatsFileHeader);
+	if (Size == 0)
+	{
+		const FNSStatsFileHeader Header = { FileMagic, FileVersion, sizeof(FNSStatsRecord), 0 };
+		DataFile->Write((const uint8*)&Header, sizeof(Header));
+		RecordBytes = 0;
+	}
+	else if (RecordBytes % (int64)sizeof(FNSStatsRecord) != 0)
+	{
+		// A server that died mid-write left half a record, pad it so ours stay aligned
+		const uint8 Zeros[sizeof(FNSStatsRecord)] = {};
+		const int64 Padding = (int64)sizeof(FNSStatsRecord) - RecordBytes % (int64)sizeof(FNSStatsRecord);
+		DataFile->Write(Zeros, Padding);
+		RecordBytes += Padding;
+	}
+
+	NextRecord = RecordBytes / (int64)sizeof(FNSStatsRecord);
+	FirstMatchRecord = NextRecord;
+	MatchId = LastMatchId + 1;
+	MatchStartSeconds = FPlatformTime::Seconds();
+	StatsNextFlushTime = MatchStartSeconds + 1.0;
+	PendingRecords.Reserve(FlushRecords);
+	bMatchOpen = true;
+
+	AddRecord(ENSStatsEvent::MatchBegin, 0, 0, 0.0f, 0);
+}
+
+void FNSMatchStats::EndMatch(int32 RedScore, int32 BlueScore)
+{
+	check(IsInGameThread());
+
+	if (!bMatchOpen)
+	{
+		return;
+	}
+
+	AddRecord(ENSStatsEvent::TeamScore, 0, 0, (float)RedScore, (uint8)ETeam::RED_TEAM);
+	AddRecord(ENSStatsEvent::TeamScore, 0, 0, (float)BlueScore, (uint8)ETeam::BLUE_TEAM);
+	AddRecord(ENSStatsEvent::MatchEnd, 0, 0, (float)(FPlatformTime::Seconds() - MatchStartSeconds), 0);
+	FlushStats();
+
+	const FNSStatsIndexEntry Entry = { MatchId, 0, FirstMatchRecord, NextRecord - FirstMatchRecord };
+	DispatchWrite([Entry]()
+	{
+		IndexFile->Write((const uint8*)&Entry, sizeof(Entry));
+	});
+
+	FTaskGraphInterface::Get().WaitUntilTaskCompletes(LastWrite);
+	LastWrite = nullptr;
+
+	delete DataFile;
+	delete IndexFile;
+	DataFile = IndexFile = nullptr;
+
+	PlayerIds.Reset();
+	bMatchOpen = false;
+
+	UE_LOG(LogNS, Log, TEXT("Match %u: %llu stats records written to %s"), Entry.MatchId, Entry.NumRecords, *GetDataPath());
+}
+
+void FNSMatchStats::Record(ENSStatsEvent Event, const ANSPlayerState* Player, const ANSPlayerState* Other, float Value)
+{
+	if (!bMatchOpen)
+	{
+		return;
+	}
+
+	AddRecord(Event, GetPlayerId(Player), GetPlayerId(Other), Value, Player != nullptr ? (uint8)Player->Team : 0);
+}
+
+void FNSMatchStats::Tick()
+{
+	if (!bMatchOpen)
+	{
+		return;
+	}
+
+	const double Now = FPlatformTime::Seconds();
+	if (Now >= StatsNextFlushTime || PendingRecords.Num() >= FlushRecords)
+	{
+		StatsNextFlushTime = Now + 1.0;
+		FlushStats();
+	}
+}
+
+uint32 FNSMatchStats::ReadLastMatchId(const FString& DataPath)
+{
+	TUniquePtr<IFileHandle> File(FPlatformFileManager::Get().GetPlatformFile().OpenRead(*DataPath));
+	if (!File.IsValid())
+	{
+		return 0;
+	}
+
+	// A half written record at the end is skipped, the padding after it is written later
+	const int64 NumRecords = (File->Size() - (int64)sizeof(FNSStatsFileHeader)) / (int64)sizeof(FNSStatsRecord);
+	FNSStatsRecord Last;
+	if (NumRecords <= 0
+		|| !File->Seek(sizeof(FNSStatsFileHeader) + (NumRecords - 1) * sizeof(FNSStatsRecord))
+		|| !File->Read((uint8*)&Last, sizeof(Last)))
+	{
+		return 0;
+	}
+	return Last.MatchId;
+}
+
+uint64 FNSMatchStats::HashPlayerKey(const FString& Key)
+{
+	// 0 stands for no player in the records
+	const FTCHARToUTF8 Utf8(*Key);
+	const uint64 Hash = CityHash64(Utf8.Get(), Utf8.Length());
+	return Hash != 0 ? Hash : 1;
+}
+
+FString FNSMatchStats::GetDataPath()
+{
+	return FPaths::GameSavedDir() / TEXT("Stats") / TEXT("NSStats.dat");
+}
+
+FString FNSMatchStats::GetIndexPath()
+{
+	return FPaths::GameSavedDir() / TEXT("Stats") / TEXT("NSStats.idx");
+}
+
+FString FNSMatchStats::GetNamesPath()
+{
+	return FPaths::GameSavedDir() / TEXT("Stats") / TEXT("NSStats.names");
+}
@@ -0,0 +1,104 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+/** What a stats record stands for */
+enum class ENSStatsEvent : uint8
+{
+	/** Player and Other are unused */
+	MatchBegin,
+	/** Value is the match length in seconds */
+	MatchEnd,
+	/** Team and its final score in Value */
+	TeamScore,
+	Spawn,
+	Shot,
+	/** One per aimed shot that hurt someone. Other is the first victim, Value the damage to every victim */
+	Hit,
+	/** Other is the victim */
+	Kill,
+	/** Other is the killer, 0 when unknown */
+	Death,
+	Count
+};
+
+/** One event. Fixed size and naturally aligned, so the data file can be mapped and walked as an array */
+struct FNSStatsRecord
+{
+	uint32 MatchId;
+
+	/** Seconds since the match began */
+	float Time;
+
+	uint64 PlayerId;
+	uint64 OtherId;
+	float Value;
+	uint8 Event;
+	uint8 Team;
+	uint8 Reserved[2];
+};
+static_assert(sizeof(FNSStatsRecord) == 32, "FNSStatsRecord is part of the file format");
+
+/** Start of the data file, records follow right after it */
+struct FNSStatsFileHeader
+{
+	uint32 Magic;
+	uint32 Version;
+	uint32 RecordSize;
+	uint32 Reserved;
+};
+static_assert(sizeof(FNSStatsFileHeader) == 16, "FNSStatsFileHeader is part of the file format");
+
+/** Written to the index file when a match ends, locates its records in the data file */
+struct FNSStatsIndexEntry
+{
+	uint32 MatchId;
+	uint32 Reserved;
+	uint64 FirstRecord;
+	uint64 NumRecords;
+};
+static_assert(sizeof(FNSStatsIndexEntry) == 24, "FNSStatsIndexEntry is part of the file format");
+
+/**
+ * Server-side match statistics, kept across matches and server travels.
+ *
+ * Every kill, death, spawn, shot and hit is appended as one fixed-size
+ * record to Saved/Stats/NSStats.dat. Records are gathered on the game
+ * thread and written once per second by a chain of background tasks, so
+ * the game never waits on the disk. Each match ending appends the range of
+ * its records to NSStats.idx, and the names behind the player ids go to
+ * NSStats.names, in UTF-8. Nothing is ever rewritten. Match ids follow the
+ * last one in the data file, so they stay unique however fast matches end.
+ * Aggregated with -run=NSStatsQuery.
+ * Disabled with ns.Stats.Enable 0.
+ */
+class FNSMatchStats
+{
+public:
+	static bool IsEnabled();
+
+	/** Opens the files and starts a match. Called by the game mode on the server */
+	static void BeginMatch();
+
+	/** Writes the final scores, the match index entry and waits for every pending write */
+	static void EndMatch(int32 RedScore, int32 BlueScore);
+
+	/** Queues one record, written on the next flush */
+	static void Record(ENSStatsEvent Event, const class ANSPlayerState* Player, const class ANSPlayerState* Other = nullptr, float Value = 0.0f);
+
+	/** Flushes the last second of records, called from the game mode tick */
+	static void Tick();
+
+	/** Id of the last complete record of a data file, 0 if it has none. Match ids count up from it */
+	static uint32 ReadLastMatchId(const FString& DataPath);
+
+	/** Stable id of a player across matches: online id if any, name otherwise */
+	static uint64 HashPlayerKey(const FString& Key);
+
+	static FString GetDataPath();
+	static FString GetIndexPath();
+	static FString GetNamesPath();
+
+	static const uint32 FileMagic = 0x5453534E;
+	static const uint32 FileVersion = 1;
+};
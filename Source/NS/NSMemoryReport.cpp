@@ -0,0 +1,275 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "NS.h"
+#include "NSMemoryReport.h"
+#include "NSGameMode.h"
+#include "NSCharacter.h"
+#include "NSSPawnPoint.h"
+#include "NSProjectile.h"
+#include "NSPlayerState.h"
+#include "NSPlayerController.h"
+#include "NSBotController.h"
+#include "Serialization/ArchiveCountMem.h"
+
+DECLARE_CYCLE_STAT(TEXT("Memory Report"), STAT_NSMemoryReport, STATGROUP_NS);
+
+static const TCHAR* MemorySection = TEXT("NSMemory");
+
+typedef UClass* (*FNSStaticClassFunc)();
+
+/** An actor counts for the first of these classes it is */
+static const FNSStaticClassFunc MemoryClasses[] =
+{
+	&ANSCharacter::StaticClass,
+	&ANSSPawnPoint::StaticClass,
+	&ANSProjectile::StaticClass,
+	&ANSPlayerState::StaticClass,
+	&ANSPlayerController::StaticClass,
+	&ANSBotController::StaticClass
+};
+static_assert(ARRAY_COUNT(MemoryClasses) == (int32)ENSMemoryClass::Count, "Every ENSMemoryClass needs a class");
+
+struct FNSMemoryBudget
+{
+	int32 MaxCount;
+	int32 MaxKB;
+};
+
+/** 0 means no budget */
+static FNSMemoryBudget GetMemoryBudget(ENSMemoryClass Class)
+{
+	const FString Name = MemoryClasses[(int32)Class]()->GetName();
+
+	FNSMemoryBudget Budget = { 0, 0 };
+	GConfig->GetInt(MemorySection, *(Name + TEXT(".MaxCount")), Budget.MaxCount, GGameIni);
+	GConfig->GetInt(MemorySection, *(Name + TEXT(".MaxKB")), Budget.MaxKB, GGameIni);
+	return Budget;
+}
+
+/** Properties, owned containers and exclusive render or simulation resources of one object */
+static uint64 GetObjectBytes(UObject* Object)
+{
+	FArchiveCountMem Count(Object);
+	return Count.GetMax() + Object->GetResourceSizeBytes(EResourceSizeMode::Exclusive);
+}
+
+FNSMemoryCheckState::FNSMemoryCheckState()
+	: NextCheckTime(0.0)
+	, StaleTeamEntries(0)
+{
+	FMemory::Memzero(bOverBudget);
+}
+
+static const TCHAR* GetNetModeName(UWorld* World)
+{
+	switch (World->GetNetMode())
+	{
+	case NM_DedicatedServer:	return TEXT("dedicated server");
+	case NM_ListenServer:		return TEXT("listen server");
+	case NM_Client:				return TEXT("client");
+	default:					return TEXT("standalone");
+	}
+}
+
+void FNSMemoryReport::Measure(UWorld* World, FNSMemoryClassUsage (&OutUsage)[(int32)ENSMemoryClass::Count], bool bCountOnly)
+{
+	SCOPE_CYCLE_COUNTER(STAT_NSMemoryReport);
+
+	for (FNSMemoryClassUsage& Usage : OutUsage)
+	{
+		Usage.Count = 0;
+		Usage.ActorBytes = 0;
+		Usage.SubobjectBytes = 0;
+		Usage.Subobjects.Reset();
+	}
+
+	TArray<UObject*> Subobjects;
+	for (TActorIterator<AActor> Iter(World); Iter; ++Iter)
+	{
+		AActor* Actor = *Iter;
+
+		int32 Class = 0;
+		while (Class < ARRAY_COUNT(MemoryClasses) && !Actor->IsA(MemoryClasses[Class]()))
+		{
+			Class++;
+		}
+		if (Class == ARRAY_COUNT(MemoryClasses))
+		{
+			continue;
+		}
+
+		FNSMemoryClassUsage& Usage = OutUsage[Class];
+		Usage.Count++;
+		if (bCountOnly)
+		{
+			continue;
+		}
+		Usage.ActorBytes += GetObjectBytes(Actor);
+
+		// Components, their materials and the dynamic materials created on the actor
+		Subobjects.Reset();
+		GetObjectsWithOuter(Actor, Subobjects, true);
+		for (UObject* Subobject : Subobjects)
+		{
+			const uint64 Bytes = GetObjectBytes(Subobject);
+			Usage.SubobjectBytes += Bytes;
+
+			FNSMemoryClassUsage::FSubobjectUsage& SubobjectUsage = Usage.Subobjects.FindOrAdd(Subobject->GetClass());
+			SubobjectUsage.Count++;
+			SubobjectUsage.Bytes += Bytes;
+		}
+	}
+}
+
+void FNSMemoryReport::Report(UWorld* World, bool bDetailed)
+{
+	FNSMemoryClassUsage Usage[(int32)ENSMemoryClass::Count];
+	Measure(World, Usage);
+
+	UE_LOG(LogNS, Log, TEXT("NS memory on %s, instances and resident KB per class, shared assets excluded:"), GetNetModeName(World));
+
+	uint64 TotalBytes = 0;
+	for (int32 i = 0; i < (int32)ENSMemoryClass::Count; ++i)
+	{
+		const FNSMemoryClassUsage& ClassUsage = Usage[i];
+		const FNSMemoryBudget Budget = GetMemoryBudget((ENSMemoryClass)i);
+		TotalBytes += ClassUsage.GetTotalBytes();
+
+		UE_LOG(LogNS, Log, TEXT("  %-20s %5d  %8.1f KB (actors %.1f, subobjects %.1f, %.1f each)  budget %d / %d KB"),
+			*MemoryClasses[i]()->GetName(), ClassUsage.Count, ClassUsage.GetTotalBytes() / 1024.0,
+			ClassUsage.ActorBytes / 1024.0, ClassUsage.SubobjectBytes / 1024.0,
+			ClassUsage.Count > 0 ? ClassUsage.GetTotalBytes() / 1024.0 / ClassUsage.Count : 0.0,
+			Budget.MaxCount, Budget.MaxKB);
+
+		if (!bDetailed)
+		{
+			continue;
+		}
+
+		// Largest first
+		TArray<TPair<UClass*, FNSMemoryClassUsage::FSubobjectUsage>> Subobjects;
+		for (const auto& Pair : ClassUsage.Subobjects)
+		{
+			Subobjects.Emplace(Pair.Key, Pair.Value);
+		}
+		Subobjects.Sort([](const TPair<UClass*, FNSMemoryClassUsage::FSubobjectUsage>& A, const TPair<UClass*, FNSMemoryClassUsage::FSubobjectUsage>& B)
+		{
+			return A.Value.Bytes > B.Value.Bytes;
+		});
+
+		for (const auto& Pair : Subobjects)
+		{
+			UE_LOG(LogNS, Log, TEXT("      %-32s %5d  %8.1f KB"), *Pair.Key->GetName(), Pair.Value.Count, Pair.Value.Bytes / 1024.0);
+		}
+	}
+
+	UE_LOG(LogNS, Log, TEXT("  Total %.1f KB"), TotalBytes / 1024.0);
+
+	ANSGameMode* GameMode = World->GetAuthGameMode<ANSGameMode>();
+	if (GameMode != nullptr)
+	{
+		const int32 NumRed = GameMode->GetTeamMembers(ETeam::RED_TEAM).Num();
+		const int32 NumBlue = GameMode->GetTeamMembers(ETeam::BLUE_TEAM).Num();
+		UE_LOG(LogNS, Log, TEXT("  Team arrays: %d red, %d blue, %d stale, for %d characters"),
+			NumRed, NumBlue, CountStaleTeamEntries(World), Usage[(int32)ENSMemoryClass::Character].Count);
+	}
+
+	// Every class over budget is reported, not only the ones that went over since the last check
+	bool OverBudget[(int32)ENSMemoryClass::Count] = {};
+	CheckBudgets(World, Usage, OverBudget);
+}
+
+void FNSMemoryReport::Tick(UWorld* World, FNSMemoryCheckState& State)
+{
+	float CheckSeconds = 30.0f;
+	GConfig->GetFloat(MemorySection, TEXT("CheckSeconds"), CheckSeconds, GGameIni);
+	if (CheckSeconds <= 0.0f)
+	{
+		return;
+	}
+
+	const double Now = FPlatformTime::Seconds();
+	if (Now < State.NextCheckTime)
+	{
+		return;
+	}
+	State.NextCheckTime = Now + CheckSeconds;
+
+	FNSMemoryClassUsage Usage[(int32)ENSMemoryClass::Count];
+	Measure(World, Usage, true);
+	CheckBudgets(World, Usage, State.bOverBudget);
+
+	if (World->GetAuthGameMode<ANSGameMode>() != nullptr)
+	{
+		const int32 Stale = CountStaleTeamEntries(World);
+		if (Stale > State.StaleTeamEntries)
+		{
+			UE_LOG(LogNS, Warning, TEXT("NS memory: %d stale entries in the team arrays, characters destroyed or counted twice"), Stale);
+		}
+		State.StaleTeamEntries = Stale;
+	}
+}
+
+bool FNSMemoryReport::CheckBudgets(UWorld* World, const FNSMemoryClassUsage (&Usage)[(int32)ENSMemoryClass::Count], bool (&OverBudget)[(int32)ENSMemoryClass::Count])
+{
+	bool bWithinBudget = true;
+	for (int32 i = 0; i < (int32)ENSMemoryClass::Count; ++i)
+	{
+		const FNSMemoryBudget Budget = GetMemoryBudget((ENSMemoryClass)i);
+		const int32 KB = (int32)(Usage[i].GetTotalBytes() / 1024);
+
+		const bool bOverCount = Budget.MaxCount > 0 && Usage[i].Count > Budget.MaxCount;
+		const bool bOverKB = Budget.MaxKB > 0 && KB > Budget.MaxKB;
+		const bool bOver = bOverCount || bOverKB;
+
+		if (bOver && !OverBudget[i])
+		{
+			UE_LOG(LogNS, Warning, TEXT("NS memory budget exceeded on %s: %s has %d instances (max %d) and %d KB (max %d KB)"),
+				GetNetModeName(World), *MemoryClasses[i]()->GetName(), Usage[i].Count, Budget.MaxCount, KB, Budget.MaxKB);
+		}
+
+		OverBudget[i] = bOver;
+		bWithinBudget &= !bOver;
+	}
+
+	return bWithinBudget;
+}
+
+int32 FNSMemoryReport::CountStaleTeamEntries(UWorld* World)
+{
+	ANSGameMode* GameMode = World->GetAuthGameMode<ANSGameMode>();
+	if (GameMode == nullptr)
+	{
+		return 0;
+	}
+
+	// A character leaves its team when it respawns or its player logs out. The arrays hold
+	// raw pointers, so entries are looked up among the live characters, never dereferenced
+	TSet<ANSCharacter*> Live;
+	for (TActorIterator<ANSCharacter> Iter(World); Iter; ++Iter)
+	{
+		Live.Add(*Iter);
+	}
+
+	TSet<ANSCharacter*> Seen;
+	int32 Stale = 0;
+	for (ETeam Team : { ETeam::RED_TEAM, ETeam::BLUE_TEAM })
+	{
+		for (ANSCharacter* Character : GameMode->GetTeamMembers(Team))
+		{
+			bool bAlreadySeen = false;
+			Seen.Add(Character, &bAlreadySeen);
+			Stale += !Live.Contains(Character) || bAlreadySeen ? 1 : 0;
+		}
+	}
+
+	return Stale;
+}
+
+static FAutoConsoleCommandWithWorldAndArgs MemReportCommand(
+	TEXT("ns.Mem.Report"),
+	TEXT("Logs the instances and resident memory of every NS actor class against its [NSMemory] budget, with the subobject breakdown unless 0 is passed: ns.Mem.Report <0/1>"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		FNSMemoryReport::Report(World, Args.Num() == 0 || FCString::Atoi(*Args[0]) != 0);
+	}));
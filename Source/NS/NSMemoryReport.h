@@ -0,0 +1,91 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+/** NS actor classes whose memory is accounted */
+enum class ENSMemoryClass : uint8
+{
+	Character,
+	SpawnPoint,
+	Projectile,
+	PlayerState,
+	PlayerController,
+	BotController,
+	Count
+};
+
+/** Memory of the instances of one class, with their subobjects */
+struct FNSMemoryClassUsage
+{
+	int32 Count;
+
+	/** The actors themselves: properties and the containers they own */
+	uint64 ActorBytes;
+
+	/** Components, dynamic materials and every other object nested in the actors, with their exclusive resources */
+	uint64 SubobjectBytes;
+
+	struct FSubobjectUsage
+	{
+		int32 Count;
+		uint64 Bytes;
+	};
+
+	/** Subobject memory by class */
+	TMap<UClass*, FSubobjectUsage> Subobjects;
+
+	uint64 GetTotalBytes() const { return ActorBytes + SubobjectBytes; }
+};
+
+/** What the periodic check of one world remembers between checks. PIE worlds each keep their own */
+struct FNSMemoryCheckState
+{
+	FNSMemoryCheckState();
+
+	double NextCheckTime;
+
+	/** Classes over their count budget at the last check, warned only when they go over again */
+	bool bOverBudget[(int32)ENSMemoryClass::Count];
+
+	int32 StaleTeamEntries;
+};
+
+/**
+ * Resident memory of the NS actors of a world, per class.
+ *
+ * Each actor and each object nested in it is measured with FArchiveCountMem
+ * plus its exclusive resource size (bone buffers, particle emitter data), so
+ * the same command gives comparable numbers on the server and on a client.
+ * Shared assets such as meshes and textures are not counted. ns.Mem.Report
+ * logs the totals and the subobject breakdown.
+ *
+ * Budgets live in the [NSMemory] section of Game.ini, as <Class>.MaxCount
+ * and <Class>.MaxKB for the whole class, e.g. NSCharacter.MaxKB. Every
+ * CheckSeconds of a match the instance counts are compared against them
+ * and a warning is logged when a class goes over, once until it is back
+ * under. Measuring the bytes walks every property of every object and
+ * hitches, so the KB budgets are only checked by ns.Mem.Report. On the
+ * server the check also looks for stale entries in the game mode's team
+ * arrays, characters destroyed without being removed or added to both teams.
+ */
+class FNSMemoryReport
+{
+public:
+	/** Counts, and unless bCountOnly measures, every instance of the accounted classes in World */
+	static void Measure(UWorld* World, FNSMemoryClassUsage (&OutUsage)[(int32)ENSMemoryClass::Count], bool bCountOnly = false);
+
+	/** Logs the usage of every class against its budget, with the subobject breakdown when bDetailed */
+	static void Report(UWorld* World, bool bDetailed);
+
+	/** Checks the count budgets every CheckSeconds. Called by the game state of World on servers and clients */
+	static void Tick(UWorld* World, FNSMemoryCheckState& State);
+
+	/**
+	 * Compares the usage with the budgets and warns about the classes that went over since OverBudget
+	 * was updated. Sizes of 0 pass the KB budgets. Returns false if any is over
+	 */
+	static bool CheckBudgets(UWorld* World, const FNSMemoryClassUsage (&Usage)[(int32)ENSMemoryClass::Count], bool (&OverBudget)[(int32)ENSMemoryClass::Count]);
+
+	/** Server: entries of the team arrays that no longer belong to a player, logged as a leak */
+	static int32 CountStaleTeamEntries(UWorld* World);
+};
@@ -0,0 +1,99 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "NS.h"
+#include "NSNetCompareCommandlet.h"
+
+/** Totals of one capture */
+struct FNSNetCapture
+{
+	TMap<FString, int64> Counts;
+	TMap<FString, int64> Bytes;
+
+	/** Distinct (second, connection) pairs seen in the capture */
+	TSet<FString> ConnectionSeconds;
+
+	bool Load(const FString& Path)
+	{
+		TArray<FString> Lines;
+		if (!FFileHelper::LoadANSITextFileToStrings(*Path, nullptr, Lines))
+		{
+			return false;
+		}
+
+		TArray<FString> Fields;
+		for (int32 i = 1; i < Lines.Num(); ++i)
+		{
+			Fields.Reset();
+			if (Lines[i].ParseIntoArray(Fields, TEXT(","), false) != 5)
+			{
+				continue;
+			}
+
+			ConnectionSeconds.Add(Fields[0] + Fields[1]);
+			Counts.FindOrAdd(Fields[2]) += FCString::Atoi64(*Fields[3]);
+			Bytes.FindOrAdd(Fields[2]) += FCString::Atoi64(*Fields[4]);
+		}
+		return true;
+	}
+
+	double PerConnectionSecond(const TMap<FString, int64>& Totals, const FString& Event) const
+	{
+		const int64* Total = Totals.Find(Event);
+		return Total != nullptr && ConnectionSeconds.Num() > 0 ? (double)*Total / ConnectionSeconds.Num() : 0.0;
+	}
+};
+
+UNSNetCompareCommandlet::UNSNetCompareCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UNSNetCompareCommandlet::Main(const FString& Params)
+{
+	TArray<FString> Tokens;
+	TArray<FString> Switches;
+	ParseCommandLine(*Params, Tokens, Switches);
+
+	if (Tokens.Num() < 2)
+	{
+		UE_LOG(LogNS, Error, TEXT("Usage: -run=NSNetCompare <Before.csv> <After.csv>"));
+		return 1;
+	}
+
+	FNSNetCapture Before;
+	FNSNetCapture After;
+	if (!Before.Load(Tokens[0]) || !After.Load(Tokens[1]))
+	{
+		UE_LOG(LogNS, Error, TEXT("Could not read %s or %s"), *Tokens[0], *Tokens[1]);
+		return 1;
+	}
+
+	TSet<FString> Events;
+	for (const auto& Pair : Before.Bytes)
+	{
+		Events.Add(Pair.Key);
+	}
+	for (const auto& Pair : After.Bytes)
+	{
+		Events.Add(Pair.Key);
+	}
+	Events.Sort([](const FString& A, const FString& B) { return A < B; });
+
+	UE_LOG(LogNS, Display, TEXT("Per connection per second, %d vs %d connection-seconds"), Before.ConnectionSeconds.Num(), After.ConnectionSeconds.Num());
+	UE_LOG(LogNS, Display, TEXT("%-24s %12s %12s %12s %12s %8s"), TEXT("Event"), TEXT("Count A"), TEXT("Count B"), TEXT("Est. bytes A"), TEXT("Est. bytes B"), TEXT("Bytes %"));
+
+	for (const FString& Event : Events)
+	{
+		const double BytesA = Before.PerConnectionSecond(Before.Bytes, Event);
+		const double BytesB = After.PerConnectionSecond(After.Bytes, Event);
+		const double Change = BytesA > 0.0 ? (BytesB - BytesA) * 100.0 / BytesA : 0.0;
+
+		UE_LOG(LogNS, Display, TEXT("%-24s %12.2f %12.2f %12.1f %12.1f %+7.1f%%"), *Event,
+			Before.PerConnectionSecond(Before.Counts, Event), After.PerConnectionSecond(After.Counts, Event), BytesA, BytesB, Change);
+	}
+
+	return 0;
+}
@@ -0,0 +1,24 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "Commandlets/Commandlet.h"
+#include "NSNetCompareCommandlet.generated.h"
+
+/**
+ * Compares two NSNet.csv captures written by FNSNetStats and prints, per
+ * event, the average count and estimated bytes per connection per second of
+ * each session and the relative change. The Out line has the measured bytes.
+ *
+ * Usage: NS -run=NSNetCompare <Before.csv> <After.csv>
+ */
+UCLASS()
+class UNSNetCompareCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UNSNetCompareCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
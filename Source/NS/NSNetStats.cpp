@@ -0,0 +1,204 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "NS.h"
+#include "NSNetStats.h"
+
+static TAutoConsoleVariable<int32> CVarNetStats(
+	TEXT("ns.Net.Stats"),
+	0,
+	TEXT("Accounts NS RPCs and replicated properties per connection into Saved/Logs/NSNet.csv. Also enabled by -nsnetstats."));
+
+static const int64 MaxLogBytes = 16 * 1024 * 1024;
+
+static const TCHAR* EventNames[] =
+{
+	TEXT("ServerFire"),
+	TEXT("MultiCastShootEffects"),
+	TEXT("MultiCastRagdoll"),
+	TEXT("PlayPain"),
+	TEXT("ClientShootEffects"),
+	TEXT("ClientDistantShot"),
+	TEXT("ClientRagdoll"),
+	TEXT("ServerMove"),
+	TEXT("ServerMoveDual"),
+	TEXT("ClientMatchSnapshot"),
+	TEXT("CurrentTeam"),
+	TEXT("Health"),
+	TEXT("Deaths"),
+	TEXT("Team"),
+	TEXT("Score")
+};
+static_assert(ARRAY_COUNT(EventNames) == (int32)ENSNetEvent::Count, "Every ENSNetEvent needs a name");
+
+struct FNSConnectionNetStats
+{
+	FString Address;
+	int32 Counts[(int32)ENSNetEvent::Count];
+	int32 Bytes[(int32)ENSNetEvent::Count];
+	int32 LastOutPacketsLost;
+	int64 LastReliableBunches;
+
+	FNSConnectionNetStats()
+		: LastOutPacketsLost(0)
+		, LastReliableBunches(0)
+	{
+		FMemory::Memzero(Counts);
+		FMemory::Memzero(Bytes);
+	}
+};
+
+static TMap<TWeakObjectPtr<UNetConnection>, FNSConnectionNetStats> ConnectionStats;
+static FArchive* LogWriter = nullptr;
+static double NextFlushTime = 0.0;
+
+static FString GetLogPath(const TCHAR* Suffix)
+{
+	return FPaths::GameLogDir() / FString::Printf(TEXT("NSNet%s.csv"), Suffix);
+}
+
+static void WriteLine(const FString& Line)
+{
+	if (LogWriter != nullptr && LogWriter->TotalSize() > MaxLogBytes)
+	{
+		delete LogWriter;
+		LogWriter = nullptr;
+		IFileManager::Get().Move(*GetLogPath(TEXT(".1")), *GetLogPath(TEXT("")), true);
+	}
+
+	if (LogWriter == nullptr)
+	{
+		LogWriter = IFileManager::Get().CreateFileWriter(*GetLogPath(TEXT("")), FILEWRITE_Append | FILEWRITE_AllowRead);
+		if (LogWriter == nullptr)
+		{
+			return;
+		}
+
+		if (LogWriter->TotalSize() == 0)
+		{
+			// Bytes are estimates for the NS events, measured for the Out line only
+			const FTCHARToUTF8 Header(TEXT("time,connection,event,count,estimated_bytes\n"));
+			LogWriter->Serialize((void*)Header.Get(), Header.Length());
+		}
+	}
+
+	const FTCHARToUTF8 Converted(*Line);
+	LogWriter->Serialize((void*)Converted.Get(), Converted.Length());
+}
+
+bool FNSNetStats::IsEnabled()
+{
+	static const bool bCommandLine = FParse::Param(FCommandLine::Get(), TEXT("nsnetstats"));
+	return bCommandLine || CVarNetStats.GetValueOnGameThread() != 0;
+}
+
+const TCHAR* FNSNetStats::GetEventName(ENSNetEvent Event)
+{
+	return EventNames[(int32)Event];
+}
+
+int64 FNSNetStats::GetReliableBunchesSent(UNetConnection* Connection)
+{
+	// Every reliable bunch takes the next sequence number of its channel
+	int64 Bunches = 0;
+	for (int32 Sequence : Connection->OutReliable)
+	{
+		Bunches += Sequence;
+	}
+	return Bunches;
+}
+
+void FNSNetStats::Record(ENSNetEvent Event, UNetConnection* Connection, int32 Bytes)
+{
+	if (Connection == nullptr || !IsEnabled())
+	{
+		return;
+	}
+
+	FNSConnectionNetStats* Stats = ConnectionStats.Find(Connection);
+	if (Stats == nullptr)
+	{
+		Stats = &ConnectionStats.Add(Connection);
+		Stats->Address = Connection->LowLevelGetRemoteAddress();
+		Stats->LastOutPacketsLost = Connection->OutPacketsLost;
+		Stats->LastReliableBunches = GetReliableBunchesSent(Connection);
+	}
+
+	Stats->Counts[(int32)Event]++;
+	Stats->Bytes[(int32)Event] += Bytes;
+}
+
+void FNSNetStats::RecordMulticast(ENSNetEvent Event, AActor* Actor, int32 Bytes)
+{
+	UNetDriver* NetDriver = Actor != nullptr ? Actor->GetNetDriver() : nullptr;
+	if (NetDriver == nullptr || !IsEnabled())
+	{
+		return;
+	}
+
+	// Dormant or culled actors have no channel on the connection and send it nothing
+	for (UNetConnection* Connection : NetDriver->ClientConnections)
+	{
+		if (Connection != nullptr && Connection->ActorChannels.FindRef(Actor) != nullptr)
+		{
+			Record(Event, Connection, Bytes);
+		}
+	}
+}
+
+void FNSNetStats::Tick()
+{
+	const double Now = FPlatformTime::Seconds();
+	if (Now < NextFlushTime || ConnectionStats.Num() == 0)
+	{
+		return;
+	}
+	NextFlushTime = Now + 1.0;
+
+	const FString TimeStamp = FDateTime::Now().ToString();
+
+	for (auto It = ConnectionStats.CreateIterator(); It; ++It)
+	{
+		FNSConnectionNetStats& Stats = It.Value();
+
+		for (int32 i = 0; i < (int32)ENSNetEvent::Count; ++i)
+		{
+			if (Stats.Counts[i] > 0)
+			{
+				WriteLine(FString::Printf(TEXT("%s,%s,%s,%d,%d\n"), *TimeStamp, *Stats.Address, EventNames[i], Stats.Counts[i], Stats.Bytes[i]));
+			}
+		}
+
+		UNetConnection* Connection = It.Key().Get();
+		if (Connection == nullptr)
+		{
+			It.RemoveCurrent();
+			continue;
+		}
+
+		// Every lost packet carrying reliable bunches is resent, so the loss count bounds the retransmits
+		const int32 Lost = Connection->OutPacketsLost - Stats.LastOutPacketsLost;
+		if (Lost > 0)
+		{
+			WriteLine(FString::Printf(TEXT("%s,%s,OutPacketsLost,%d,0\n"), *TimeStamp, *Stats.Address, Lost));
+		}
+
+		const int64 ReliableBunches = GetReliableBunchesSent(Connection);
+		if (ReliableBunches != Stats.LastReliableBunches)
+		{
+			WriteLine(FString::Printf(TEXT("%s,%s,ReliableBunches,%lld,0\n"), *TimeStamp, *Stats.Address, ReliableBunches - Stats.LastReliableBunches));
+		}
+		Stats.LastReliableBunches = ReliableBunches;
+
+		// Everything the connection sent, so filters on single events show up in the totals
+		WriteLine(FString::Printf(TEXT("%s,%s,Out,%d,%d\n"), *TimeStamp, *Stats.Address, Connection->OutPacketsPerSecond, Connection->OutBytesPerSecond));
+
+		Stats.LastOutPacketsLost = Connection->OutPacketsLost;
+		FMemory::Memzero(Stats.Counts);
+		FMemory::Memzero(Stats.Bytes);
+	}
+
+	if (LogWriter != nullptr)
+	{
+		LogWriter->Flush();
+	}
+}
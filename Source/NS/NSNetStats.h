@@ -0,0 +1,66 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+/** Replicated functions and properties accounted by FNSNetStats */
+enum class ENSNetEvent : uint8
+{
+	ServerFire,
+	MultiCastShootEffects,
+	MultiCastRagdoll,
+	PlayPain,
+	ClientShootEffects,
+	ClientDistantShot,
+	ClientRagdoll,
+	ServerMove,
+	ServerMoveDual,
+	ClientMatchSnapshot,
+	Prop_CurrentTeam,
+	Prop_Health,
+	Prop_Deaths,
+	Prop_Team,
+	Prop_Score,
+	Count
+};
+
+/**
+ * Server-side accounting of NS replication traffic.
+ *
+ * Call sites report each RPC and each replicated property change with an
+ * estimate of its payload, from the parameter sizes and a fixed header; the
+ * real bunch size depends on the net serialization. Multicasts and property
+ * changes are only charged to the connections with an open channel for the
+ * actor, as the others never receive them. Counts and estimated bytes are
+ * aggregated per connection and flushed once per second, with the
+ * connection's packet loss for that second as a proxy for reliable
+ * retransmits, the reliable bunches it sent (the ReliableBunches line, read
+ * from the channel sequence numbers) and its measured outgoing packets and
+ * bytes per second (the Out line), to Saved/Logs/NSNet.csv (rotated to NSNet.1.csv past
+ * MaxLogBytes). Enabled with -nsnetstats or ns.Net.Stats 1. Two captures are
+ * compared with -run=NSNetCompare.
+ */
+class FNSNetStats
+{
+public:
+	static bool IsEnabled();
+
+	/** Accounts one event sent to (or received from) Connection */
+	static void Record(ENSNetEvent Event, class UNetConnection* Connection, int32 Bytes);
+
+	/** Accounts one event sent to every client connection with an open channel for Actor: not dormant and relevant */
+	static void RecordMulticast(ENSNetEvent Event, AActor* Actor, int32 Bytes);
+
+	/** Flushes the last second to the log, called from the game mode tick */
+	static void Tick();
+
+	static const TCHAR* GetEventName(ENSNetEvent Event);
+
+	/** Sum of the reliable sequence numbers of every channel of Connection. The difference between two reads is the reliable bunches sent */
+	static int64 GetReliableBunchesSent(class UNetConnection* Connection);
+
+	/** Estimated RPC overhead on top of the parameters: actor channel, function index and bunch header */
+	static const int32 RPCHeaderBytes = 6;
+
+	/** Estimated property overhead on top of the value: handle and bunch header */
+	static const int32 PropertyHeaderBytes = 3;
+};
@@ -0,0 +1,203 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "NS.h"
+#include "NSPerfTracker.h"
+
+static TAutoConsoleVariable<int32> CVarPerfEnable(
+	TEXT("ns.Perf.Enable"),
+	0,
+	TEXT("Times the NS hot paths for ns.Perf.Capture reports. Also enabled by -nsperf."));
+
+static const TCHAR* PerfSection = TEXT("NSPerf");
+
+/** Checked in with the rest of the config, unlike Game.ini overrides that end up in Saved */
+static FString GetBaselinePath()
+{
+	return FPaths::GameConfigDir() / TEXT("NSPerfBaseline.ini");
+}
+
+/** Benchmark and self-test checks failed since startup */
+static int32 FailedChecks = 0;
+
+static const TCHAR* CounterNames[] =
+{
+	TEXT("SpawnSelection"),
+	TEXT("TeamAssignment"),
+	TEXT("Damage"),
+	TEXT("Respawn"),
+	TEXT("FireValidation"),
+	TEXT("Fire")
+};
+static_assert(ARRAY_COUNT(CounterNames) == (int32)ENSPerfCounter::Count, "Every ENSPerfCounter needs a name");
+
+struct FNSPerfCounterData
+{
+	uint64 Calls;
+	uint64 TotalCycles;
+	uint32 MaxCycles;
+};
+
+static FNSPerfCounterData Counters[(int32)ENSPerfCounter::Count];
+
+bool FNSPerfTracker::IsEnabled()
+{
+	static const bool bCommandLine = FParse::Param(FCommandLine::Get(), TEXT("nsperf"));
+	return bCommandLine || CVarPerfEnable.GetValueOnAnyThread() != 0;
+}
+
+void FNSPerfTracker::Add(ENSPerfCounter Counter, uint32 Cycles)
+{
+	check(IsInGameThread());
+
+	FNSPerfCounterData& Data = Counters[(int32)Counter];
+	Data.Calls++;
+	Data.TotalCycles += Cycles;
+	Data.MaxCycles = FMath::Max(Data.MaxCycles, Cycles);
+}
+
+void FNSPerfTracker::Reset()
+{
+	FMemory::Memzero(Counters);
+}
+
+static double AverageMicroseconds(const FNSPerfCounterData& Data)
+{
+	return Data.Calls > 0 ? Data.TotalCycles * FPlatformTime::GetSecondsPerCycle() * 1000000.0 / Data.Calls : 0.0;
+}
+
+/** Value of Key in the committed baseline, Default when missing */
+static float GetBaselineValue(const FConfigFile& Baseline, const TCHAR* Key, float Default)
+{
+	const FConfigSection* Section = Baseline.Find(PerfSection);
+	const FConfigValue* Value = Section != nullptr ? Section->Find(Key) : nullptr;
+	return Value != nullptr ? FCString::Atof(*Value->GetValue()) : Default;
+}
+
+bool FNSPerfTracker::WriteReport(const FString& Path)
+{
+	FConfigFile Baseline;
+	Baseline.Read(GetBaselinePath());
+
+	const float Tolerance = GetBaselineValue(Baseline, TEXT("RegressionTolerance"), 0.2f);
+
+	bool bPassed = FailedChecks == 0;
+	FString CountersJson;
+
+	for (int32 i = 0; i < (int32)ENSPerfCounter::Count; ++i)
+	{
+		const FNSPerfCounterData& Data = Counters[i];
+		const double AvgUs = AverageMicroseconds(Data);
+		const double MaxUs = Data.MaxCycles * FPlatformTime::GetSecondsPerCycle() * 1000000.0;
+
+		const float BaselineUs = GetBaselineValue(Baseline, CounterNames[i], 0.0f);
+
+		// A counter that ran without a baseline fails too, or a missing entry would pass forever
+		const bool bMissingBaseline = Data.Calls > 0 && BaselineUs <= 0.0f;
+		const bool bRegressed = Data.Calls > 0 && (bMissingBaseline || AvgUs > BaselineUs * (1.0f + Tolerance));
+		if (bMissingBaseline)
+		{
+			bPassed = false;
+			UE_LOG(LogNS, Error, TEXT("%s has no baseline in %s: %.2f us average, store one with ns.Perf.SaveBaseline"), CounterNames[i], *GetBaselinePath(), AvgUs);
+		}
+		else if (bRegressed)
+		{
+			bPassed = false;
+			UE_LOG(LogNS, Error, TEXT("%s regressed: %.2f us average, baseline %.2f us"), CounterNames[i], AvgUs, BaselineUs);
+		}
+
+		CountersJson += FString::Printf(TEXT("%s\n\t\t{ \"name\": \"%s\", \"calls\": %llu, \"avg_us\": %.3f, \"max_us\": %.3f, \"baseline_us\": %.3f, \"regressed\": %s }"),
+			i > 0 ? TEXT(",") : TEXT(""), CounterNames[i], Data.Calls, AvgUs, MaxUs, BaselineUs, bRegressed ? TEXT("true") : TEXT("false"));
+	}
+
+	const FString Report = FString::Printf(TEXT("{\n\t\"build\": \"%s\",\n\t\"tolerance\": %.3f,\n\t\"passed\": %s,\n\t\"failed_checks\": %d,\n\t\"counters\": [%s\n\t]\n}\n"),
+		FApp::GetBuildVersion(), Tolerance, bPassed ? TEXT("true") : TEXT("false"), FailedChecks, *CountersJson);
+
+	if (!FFileHelper::SaveStringToFile(Report, *Path))
+	{
+		UE_LOG(LogNS, Error, TEXT("Could not write perf report to %s"), *Path);
+		return false;
+	}
+
+	UE_LOG(LogNS, Log, TEXT("Perf report written to %s: %s"), *Path, bPassed ? TEXT("PASSED") : TEXT("FAILED"));
+	return bPassed;
+}
+
+void FNSPerfTracker::SaveBaseline()
+{
+	const FString Path = GetBaselinePath();
+	FConfigFile Baseline;
+	Baseline.Read(Path);
+
+	// Counters that did not run this time keep their previous baseline
+	FString Text = FString::Printf(TEXT("[%s]\nRegressionTolerance=%.2f\n"), PerfSection, GetBaselineValue(Baseline, TEXT("RegressionTolerance"), 0.2f));
+	for (int32 i = 0; i < (int32)ENSPerfCounter::Count; ++i)
+	{
+		const float BaselineUs = Counters[i].Calls > 0 ? AverageMicroseconds(Counters[i]) : GetBaselineValue(Baseline, CounterNames[i], 0.0f);
+		if (BaselineUs > 0.0f)
+		{
+			Text += FString::Printf(TEXT("%s=%.3f\n"), CounterNames[i], BaselineUs);
+		}
+	}
+
+	if (FFileHelper::SaveStringToFile(Text, *Path))
+	{
+		UE_LOG(LogNS, Log, TEXT("Perf baseline written to %s, commit it to make it the reference"), *Path);
+	}
+	else
+	{
+		UE_LOG(LogNS, Error, TEXT("Could not write perf baseline to %s"), *Path);
+	}
+}
+
+bool FNSPerfTracker::Expect(bool bPassed, const TCHAR* Name, const FString& Details)
+{
+	if (!bPassed)
+	{
+		FailedChecks++;
+		UE_LOG(LogNS, Error, TEXT("%s failed: %s"), Name, *Details);
+	}
+	return bPassed;
+}
+
+void FNSPerfTracker::Quit(bool bPassed)
+{
+	if (bPassed)
+	{
+		FPlatformMisc::RequestExit(false);
+		return;
+	}
+
+	// A clean exit always returns 0. A forced exit after a critical error is the only way
+	// out with a failing code, for CI to gate on
+	GLog->Flush();
+	GIsCriticalError = true;
+	FPlatformMisc::RequestExit(true);
+}
+
+static FAutoConsoleCommand PerfCaptureCommand(
+	TEXT("ns.Perf.Capture"),
+	TEXT("Resets the NS perf counters and writes a report after the given seconds: ns.Perf.Capture <Seconds> [Path]. Quits afterwards with -nsperfquit, with a failing exit code on a regression or a failed check."),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		const float Seconds = Args.Num() > 0 ? FCString::Atof(*Args[0]) : 30.0f;
+		const FString Path = Args.Num() > 1 ? Args[1] : FPaths::GameSavedDir() / TEXT("Profiling") / TEXT("NSPerf.json");
+
+		FNSPerfTracker::Reset();
+		CVarPerfEnable->Set(1);
+
+		FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([Path](float DeltaTime)
+		{
+			const bool bPassed = FNSPerfTracker::WriteReport(Path);
+
+			if (FParse::Param(FCommandLine::Get(), TEXT("nsperfquit")))
+			{
+				FNSPerfTracker::Quit(bPassed);
+			}
+			return false;
+		}), Seconds);
+	}));
+
+static FAutoConsoleCommand PerfSaveBaselineCommand(
+	TEXT("ns.Perf.SaveBaseline"),
+	TEXT("Stores the current NS perf averages as the baseline in Config/NSPerfBaseline.ini."),
+	FConsoleCommandDelegate::CreateStatic(&FNSPerfTracker::SaveBaseline));
@@ -0,0 +1,80 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+/** Gameplay hot paths tracked build to build */
+enum class ENSPerfCounter : uint8
+{
+	SpawnSelection,
+	TeamAssignment,
+	Damage,
+	Respawn,
+	FireValidation,
+	Fire,
+	Count
+};
+
+/**
+ * Timing of the NS hot paths, compared against a stored baseline.
+ *
+ * Enabled with -nsperf or ns.Perf.Enable 1. ns.Perf.Capture <Seconds> writes
+ * a JSON report to Saved/Profiling/NSPerf.json once the capture ends, and
+ * marks every counter whose average went over its baseline by more than
+ * RegressionTolerance, or that ran without a baseline. Baselines live in
+ * Config/NSPerfBaseline.ini, which is checked in; ns.Perf.SaveBaseline
+ * rewrites it from the current averages.
+ *
+ * The counters are fed by the NS.* automation tests, so a headless run of
+ * the tests with -nsperf and ns.Perf.Capture gates both correctness and
+ * timing, see NSGameplayTests.cpp.
+ *
+ * Benchmarks and self-tests report their checks through Expect. With
+ * -nsperfquit the run quits after the capture with a failing exit code if a
+ * counter regressed or any check failed.
+ */
+class FNSPerfTracker
+{
+public:
+	static bool IsEnabled();
+
+	static void Add(ENSPerfCounter Counter, uint32 Cycles);
+
+	static void Reset();
+
+	/** Writes the JSON report to Path, returns whether every counter is within its baseline */
+	static bool WriteReport(const FString& Path);
+
+	/** Stores the current averages as the new baseline */
+	static void SaveBaseline();
+
+	/** Logs a failed check as an error and fails the report. Returns bPassed */
+	static bool Expect(bool bPassed, const TCHAR* Name, const FString& Details);
+
+	/** Ends a headless run, with a failing exit code unless bPassed */
+	static void Quit(bool bPassed);
+};
+
+/** Times the enclosing scope into one counter */
+class FNSPerfScope
+{
+public:
+	explicit FNSPerfScope(ENSPerfCounter InCounter)
+		: Counter(InCounter)
+		, StartCycles(FNSPerfTracker::IsEnabled() ? FPlatformTime::Cycles() : 0)
+	{
+	}
+
+	~FNSPerfScope()
+	{
+		if (StartCycles != 0)
+		{
+			FNSPerfTracker::Add(Counter, FPlatformTime::Cycles() - StartCycles);
+		}
+	}
+
+private:
+	ENSPerfCounter Counter;
+	uint32 StartCycles;
+};
+
+#define NS_PERF_SCOPE(Counter) FNSPerfScope ANONYMOUS_VARIABLE(NSPerfScope_)(ENSPerfCounter::Counter)
@@ -0,0 +1,70 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "NS.h"
+#include "NSPlayerController.h"
+#include "NSCharacter.h"
+
+void ANSPlayerController::BeginPlay()
+{
+	Super::BeginPlay();
+
+	// The join starts here for a remote player, the snapshot is on its way
+	if (IsLocalController() && GetNetMode() == NM_Client)
+	{
+		JoinSync.Begin();
+	}
+}
+
+void ANSPlayerController::PlayerTick(float DeltaTime)
+{
+	Super::PlayerTick(DeltaTime);
+
+	JoinSync.Tick(this);
+}
+
+void ANSPlayerController::SetupInputComponent()
+{
+	Super::SetupInputComponent();
+
+	InputComponent->BindAction("RestartMatch", IE_Pressed, this, &ANSPlayerController::OnRestartMatch);
+}
+
+void ANSPlayerController::OnRestartMatch()
+{
+	ANSGameMode* GameMode = GetWorld()->GetAuthGameMode<ANSGameMode>();
+	if (GameMode != nullptr && IsLocalController())
+	{
+		GameMode->RestartMatch();
+	}
+}
+
+void ANSPlayerController::ClientMatchSnapshot_Implementation(const TArray<uint8>& Data)
+{
+	JoinSync.Apply(GetWorld(), Data);
+}
+
+void ANSPlayerController::ClientShootEffects_Implementation(ANSCharacter* Shooter)
+{
+	if (Shooter != nullptr)
+	{
+		Shooter->PlayShotEffects();
+	}
+}
+
+void ANSPlayerController::ClientDistantShot_Implementation(FVector_NetQuantize Location)
+{
+	// Every character shares the fire sound, use our own
+	const ANSCharacter* Character = Cast<ANSCharacter>(GetPawn());
+	if (Character != nullptr && Character->FireSound != nullptr)
+	{
+		UGameplayStatics::PlaySoundAtLocation(this, Character->FireSound, Location, 0.5f);
+	}
+}
+
+void ANSPlayerController::ClientRagdoll_Implementation(ANSCharacter* Victim, bool bSimulatePhysics)
+{
+	if (Victim != nullptr)
+	{
+		Victim->BecomeCorpse(bSimulatePhysics);
+	}
+}
@@ -0,0 +1,47 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "GameFramework/PlayerController.h"
+#include "NSMatchSnapshot.h"
+#include "NSPlayerController.generated.h"
+
+/**
+ * Receives the cosmetic events the server's interest filter routes to this player
+ * instead of multicasting them to everyone.
+ */
+UCLASS()
+class NS_API ANSPlayerController : public APlayerController
+{
+	GENERATED_BODY()
+
+public:
+	virtual void BeginPlay() override;
+	virtual void PlayerTick(float DeltaTime) override;
+	virtual void SetupInputComponent() override;
+
+	/** State of the match when this player joined, see FNSMatchSnapshot */
+	UFUNCTION(Client, Reliable)
+	void ClientMatchSnapshot(const TArray<uint8>& Data);
+
+	/** Players of the join snapshot still on their way, and the join time measurement */
+	const FNSJoinSync& GetJoinSync() const { return JoinSync; }
+
+	/** Shot effects of a shooter this player can see or hear */
+	UFUNCTION(Client, Unreliable)
+	void ClientShootEffects(class ANSCharacter* Shooter);
+
+	/** Only the sound of a far shot. The shooter may not be relevant to this player, so it goes by location */
+	UFUNCTION(Client, Unreliable)
+	void ClientDistantShot(FVector_NetQuantize Location);
+
+	/** Death of a character, simulated as ragdoll only when close enough to be seen */
+	UFUNCTION(Client, Unreliable)
+	void ClientRagdoll(class ANSCharacter* Victim, bool bSimulatePhysics);
+
+private:
+	/** Only does something for the local players of a listen server */
+	void OnRestartMatch();
+
+	FNSJoinSync JoinSync;
+};
@@ -3,6 +3,8 @@
 #include "NS.h"
 #include "Net/UnrealNetwork.h"
 #include "NSPlayerState.h"
+#include "NSNetStats.h"
+#include "NSGameState.h"
 
 
 ANSPlayerState::ANSPlayerState()  
@@ -10,6 +12,58 @@ ANSPlayerState::ANSPlayerState()
 	Health = 100.0f; 
 	Deaths = 0; 
 	Team = ETeam::BLUE_TEAM; 
+
+	LastReplicatedHealth = Health;
+	LastReplicatedDeaths = Deaths;
+	LastReplicatedTeam = Team;
+	LastReplicatedScore = Score;
+}
+
+void ANSPlayerState::PreReplication(IRepChangedPropertyTracker& ChangedPropertyTracker)
+{
+	Super::PreReplication(ChangedPropertyTracker);
+
+	if (FNSNetStats::IsEnabled())
+	{
+		const int32 Header = FNSNetStats::PropertyHeaderBytes;
+
+		if (Health != LastReplicatedHealth)
+		{
+			FNSNetStats::RecordMulticast(ENSNetEvent::Prop_Health, this, Header + sizeof(Health));
+		}
+		if (Deaths != LastReplicatedDeaths)
+		{
+			FNSNetStats::RecordMulticast(ENSNetEvent::Prop_Deaths, this, Header + sizeof(Deaths));
+		}
+		if (Team != LastReplicatedTeam)
+		{
+			FNSNetStats::RecordMulticast(ENSNetEvent::Prop_Team, this, Header + sizeof(Team));
+		}
+		if (Score != LastReplicatedScore)
+		{
+			FNSNetStats::RecordMulticast(ENSNetEvent::Prop_Score, this, Header + sizeof(Score));
+		}
+	}
+
+	LastReplicatedHealth = Health;
+	LastReplicatedDeaths = Deaths;
+	LastReplicatedTeam = Team;
+	LastReplicatedScore = Score;
+}
+
+void ANSPlayerState::OnRep_Score()
+{
+	Super::OnRep_Score();
+	OnRep_ScoreboardData();
+}
+
+void ANSPlayerState::OnRep_ScoreboardData()
+{
+	ANSGameState* GameState = GetWorld() != nullptr ? GetWorld()->GetGameState<ANSGameState>() : nullptr;
+	if (GameState != nullptr)
+	{
+		GameState->NotifyScoreboardChanged();
+	}
 }
 
 void ANSPlayerState::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const 
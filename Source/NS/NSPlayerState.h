@@ -17,17 +17,32 @@ class NS_API ANSPlayerState : public APlayerState
 	ANSPlayerState();
 
 public:
+	virtual void PreReplication(IRepChangedPropertyTracker& ChangedPropertyTracker) override;
+
+	virtual void OnRep_Score() override;
+
 	/** Valor que almacena la salud del jugador */ 
 	UPROPERTY(Replicated) 
 	float Health; 
 	
 	/** Valor que almacena el nmero de veces que ha muerto en la partida*/ 
-	UPROPERTY(Replicated) 
+	UPROPERTY(ReplicatedUsing = OnRep_ScoreboardData) 
 	uint8 Deaths; 
 	
 	/** Valor que almacena el equipo al que pertence el jugador */ 
-	UPROPERTY(Replicated) 
+	UPROPERTY(ReplicatedUsing = OnRep_ScoreboardData) 
 	ETeam Team;
+
+private:
+	/** Tells the game state that the scoreboard needs rebuilding */
+	UFUNCTION()
+	void OnRep_ScoreboardData();
+
+	/** Values sent in the previous net update, to account property traffic */
+	float LastReplicatedHealth;
+	uint8 LastReplicatedDeaths;
+	ETeam LastReplicatedTeam;
+	float LastReplicatedScore;
 	
 	
 };
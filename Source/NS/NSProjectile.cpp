@@ -2,6 +2,9 @@
 
 #include "NS.h"
 #include "NSProjectile.h"
+#include "NSGameMode.h"
+#include "NSCharacter.h"
+#include "NSWeaponDefinition.h"
 #include "GameFramework/ProjectileMovementComponent.h"
 
 ANSProjectile::ANSProjectile() 
@@ -29,10 +32,52 @@ ANSProjectile::ANSProjectile()
 
 	// Die after 3 seconds by default
 	InitialLifeSpan = 3.0f;
+
+	Weapon = nullptr;
+	Team = ETeam::RED_TEAM;
+}
+
+void ANSProjectile::SetShooterWeapon(const UNSWeaponDefinition* InWeapon, ETeam InTeam)
+{
+	Weapon = InWeapon;
+	Team = InTeam;
+}
+
+void ANSProjectile::BeginPlay()
+{
+	Super::BeginPlay();
+
+	ANSGameMode* GameMode = GetWorld()->GetAuthGameMode<ANSGameMode>();
+	if (GameMode != nullptr)
+	{
+		// The component keeps the settings and the velocity, it just does not tick
+		ProjectileMovement->SetComponentTickEnabled(false);
+		GameMode->GetTasks().AddProjectile(this);
+	}
+}
+
+void ANSProjectile::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	ANSGameMode* GameMode = GetWorld()->GetAuthGameMode<ANSGameMode>();
+	if (GameMode != nullptr)
+	{
+		GameMode->GetTasks().RemoveProjectile(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
 }
 
 void ANSProjectile::OnHit(UPrimitiveComponent* HitComp, AActor* OtherActor, UPrimitiveComponent* OtherComp, FVector NormalImpulse, const FHitResult& Hit)
 {
+	// Explosive weapons blow up on whatever they hit, the game mode damages the enemies around with the step's other explosions
+	ANSGameMode* GameMode = GetWorld()->GetAuthGameMode<ANSGameMode>();
+	if (GameMode != nullptr && Weapon != nullptr && Weapon->ExplosionRadius > 0.0f)
+	{
+		GameMode->GetTasks().QueueExplosion(Cast<ANSCharacter>(Instigator), Team, Weapon, GetActorLocation());
+		Destroy();
+		return;
+	}
+
 	// Only add impulse and destroy projectile if we hit a physics
 	if ((OtherActor != NULL) && (OtherActor != this) && (OtherComp != NULL) && OtherComp->IsSimulatingPhysics())
 	{
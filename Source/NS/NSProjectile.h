@@ -3,6 +3,8 @@
 #include "GameFramework/Actor.h"
 #include "NSProjectile.generated.h"
 
+enum class ETeam : uint8;
+
 UCLASS(config=Game)
 class ANSProjectile : public AActor
 {
@@ -19,6 +21,13 @@ class ANSProjectile : public AActor
 public:
 	ANSProjectile();
 
+	/** On the server the game mode moves every projectile in its parallel phase instead of the movement component */
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	/** Server: the weapon that fired us and the shooter's team, for the explosion */
+	void SetShooterWeapon(const class UNSWeaponDefinition* InWeapon, ETeam InTeam);
+
 	/** called when projectile hits something */
 	UFUNCTION()
 	void OnHit(UPrimitiveComponent* HitComp, AActor* OtherActor, UPrimitiveComponent* OtherComp, FVector NormalImpulse, const FHitResult& Hit);
@@ -27,5 +36,11 @@ public:
 	FORCEINLINE class USphereComponent* GetCollisionComp() const { return CollisionComp; }
 	/** Returns ProjectileMovement subobject **/
 	FORCEINLINE class UProjectileMovementComponent* GetProjectileMovement() const { return ProjectileMovement; }
+
+private:
+	/** Data asset or class defaults, never collected while the match runs */
+	const class UNSWeaponDefinition* Weapon;
+
+	ETeam Team;
 };
 
@@ -7,8 +7,8 @@
 // Sets default values
 ANSSPawnPoint::ANSSPawnPoint()
 {
-	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
-	PrimaryActorTick.bCanEverTick = true;
+	// Overlap events keep OverlappingActors up to date, so there is nothing to do every frame
+	PrimaryActorTick.bCanEverTick = false;
 
 	SpawnCapsule = CreateDefaultSubobject<UCapsuleComponent>(TEXT("Capsule"));
 	SpawnCapsule->SetCollisionProfileName("OverlapAllDynamic");
@@ -31,14 +31,6 @@ void ANSSPawnPoint::OnConstruction(const FTransform& Transform)
 
 }
 
-
-// Called every frame
-void ANSSPawnPoint::Tick(float DeltaTime)
-{
-	Super::Tick(DeltaTime);
-	SpawnCapsule->UpdateOverlaps();
-}
-
 void ANSSPawnPoint::ActorBeginOverlaps(AActor* MyOverlappedActor, AActor* OtherActor)
 {
 	if (Role == ROLE_Authority)
@@ -15,9 +15,6 @@ public:
 	// Sets default values for this actor's properties
 	ANSSPawnPoint();
 
-	// Called every frame
-	virtual void Tick(float DeltaSeconds) override;
-
 	virtual void OnConstruction(const FTransform& Transform) override;
 
 	UFUNCTION()
@@ -0,0 +1,114 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "NS.h"
+#include "NSServerClock.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Sim Steps"), STAT_NSSimSteps, STATGROUP_NS);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Sim Overruns"), STAT_NSSimOverruns, STATGROUP_NS);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Net Update Scale"), STAT_NSNetUpdateScale, STATGROUP_NS);
+
+static TAutoConsoleVariable<int32> CVarSimLogStats(
+	TEXT("ns.Sim.LogStats"),
+	0,
+	TEXT("Logs simulation steps, overruns and dropped time every second."));
+
+FNSServerClock::FNSServerClock()
+	: StepSeconds(0.0f)
+	, MaxSubSteps(1)
+	, MinNetUpdateScale(1.0f)
+	, Accumulator(0.0f)
+	, NetUpdateScale(1.0f)
+	, WindowTime(0.0f)
+	, WindowSteps(0)
+	, WindowOverruns(0)
+	, WindowDroppedSeconds(0.0f)
+	, TotalOverruns(0)
+{
+}
+
+void FNSServerClock::Configure(int32 TickRate, int32 InMaxSubSteps, float InMinNetUpdateScale)
+{
+	StepSeconds = TickRate > 0 ? 1.0f / TickRate : 0.0f;
+	MaxSubSteps = FMath::Max(InMaxSubSteps, 1);
+	MinNetUpdateScale = FMath::Clamp(InMinNetUpdateScale, 0.01f, 1.0f);
+	Accumulator = 0.0f;
+}
+
+int32 FNSServerClock::Advance(float DeltaSeconds)
+{
+	if (!IsFixedStep())
+	{
+		WindowSteps++;
+		SET_DWORD_STAT(STAT_NSSimSteps, 1);
+		return 1;
+	}
+
+	Accumulator += DeltaSeconds;
+	int32 Steps = FMath::FloorToInt(Accumulator / StepSeconds);
+
+	if (Steps > MaxSubSteps)
+	{
+		// Behind by more than we may catch up in one frame, drop the rest
+		WindowOverruns++;
+		TotalOverruns++;
+		WindowDroppedSeconds += (Steps - MaxSubSteps) * StepSeconds;
+
+		Accumulator -= (Steps - MaxSubSteps) * StepSeconds;
+		Steps = MaxSubSteps;
+	}
+
+	Accumulator -= Steps * StepSeconds;
+	WindowSteps += Steps;
+
+	SET_DWORD_STAT(STAT_NSSimSteps, Steps);
+	SET_DWORD_STAT(STAT_NSSimOverruns, TotalOverruns);
+	return Steps;
+}
+
+void FNSServerClock::Defer(int32 Steps)
+{
+	if (IsFixedStep())
+	{
+		Accumulator += Steps * StepSeconds;
+		WindowSteps -= Steps;
+	}
+}
+
+bool FNSServerClock::UpdateNetUpdateScale(float DeltaSeconds)
+{
+	WindowTime += DeltaSeconds;
+	if (WindowTime < 1.0f)
+	{
+		return false;
+	}
+
+	if (CVarSimLogStats.GetValueOnGameThread() != 0)
+	{
+		UE_LOG(LogNS, Log, TEXT("Simulation: %d steps, %d overruns, %.1f ms dropped, net update scale %.2f"),
+			WindowSteps, WindowOverruns, WindowDroppedSeconds * 1000.0f, NetUpdateScale);
+	}
+
+	const float OldScale = NetUpdateScale;
+	if (WindowOverruns > 0)
+	{
+		NetUpdateScale = FMath::Max(NetUpdateScale * 0.5f, MinNetUpdateScale);
+	}
+	else
+	{
+		NetUpdateScale = FMath::Min(NetUpdateScale + 0.1f, 1.0f);
+	}
+
+	if (NetUpdateScale < OldScale)
+	{
+		UE_LOG(LogNS, Warning, TEXT("Server fell behind: %d overruns, %.1f ms of simulation dropped in the last second. Net update scale %.2f"),
+			WindowOverruns, WindowDroppedSeconds * 1000.0f, NetUpdateScale);
+	}
+
+	WindowTime = 0.0f;
+	WindowSteps = 0;
+	WindowOverruns = 0;
+	WindowDroppedSeconds = 0.0f;
+
+	SET_FLOAT_STAT(STAT_NSNetUpdateScale, NetUpdateScale);
+	return NetUpdateScale != OldScale;
+}
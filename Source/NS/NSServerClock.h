@@ -0,0 +1,62 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+/**
+ * Fixed-step clock for the server simulation.
+ *
+ * Frame time goes into an accumulator that is drained in steps of
+ * 1 / TickRate seconds, at most MaxSubSteps per frame. Time beyond that is
+ * dropped and the frame counted as an overrun, so a loaded server slows
+ * its simulation down instead of spiralling. After a second with overruns
+ * the net update scale is halved, down to MinNetUpdateScale, and it climbs
+ * back once the server keeps up again. A tick rate of 0 follows the engine
+ * frame rate with one variable step per frame.
+ *
+ * When the server frame is shorter than a step, Advance returns 0 and
+ * whatever the simulation consumes stays queued until a frame that steps.
+ * Actors can be destroyed and collected in between, so the queues hold
+ * weak pointers and drop what is gone.
+ */
+class FNSServerClock
+{
+public:
+	FNSServerClock();
+
+	void Configure(int32 TickRate, int32 MaxSubSteps, float MinNetUpdateScale);
+
+	bool IsFixedStep() const { return StepSeconds > 0.0f; }
+
+	/** Length of one step, or of the whole frame when not in fixed step mode */
+	float GetStepSeconds(float DeltaSeconds) const { return IsFixedStep() ? StepSeconds : DeltaSeconds; }
+
+	/** Adds the frame time and returns how many steps to simulate now */
+	int32 Advance(float DeltaSeconds);
+
+	/** Gives back steps returned by Advance that were left unsimulated, the next frame runs them first */
+	void Defer(int32 Steps);
+
+	/** Reviews the last second every second. Returns true when the net update scale changed */
+	bool UpdateNetUpdateScale(float DeltaSeconds);
+
+	/** Multiplier for the NetUpdateFrequency of the simulated actors */
+	float GetNetUpdateScale() const { return NetUpdateScale; }
+
+	int32 GetTotalOverruns() const { return TotalOverruns; }
+
+private:
+	float StepSeconds;
+	int32 MaxSubSteps;
+	float MinNetUpdateScale;
+
+	float Accumulator;
+	float NetUpdateScale;
+
+	/** Current one second window */
+	float WindowTime;
+	int32 WindowSteps;
+	int32 WindowOverruns;
+	float WindowDroppedSeconds;
+
+	int32 TotalOverruns;
+};
@@ -0,0 +1,256 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "NS.h"
+#include "NSShotTrace.h"
+#include "NSAllocTracker.h"
+#include "NSPerfTracker.h"
+#include "NSCharacter.h"
+#include "NSWeaponDefinition.h"
+#include "HAL/ThreadSingleton.h"
+
+static TAutoConsoleVariable<int32> CVarTeamChannels(
+	TEXT("ns.Fire.TeamChannels"),
+	1,
+	TEXT("1 traces shots against the enemy team channel only. 0 traces both teams and stops pellets at teammates."));
+
+/** Hit results of the last trace issued by this thread */
+class FNSHitBuffer : public TThreadSingleton<FNSHitBuffer>
+{
+public:
+	FNSHitBuffer()
+	{
+		Hits.Reserve(32);
+	}
+
+	TArray<FHitResult> Hits;
+};
+
+ECollisionChannel FNSShotTrace::GetTeamChannel(ETeam Team)
+{
+	return Team == ETeam::RED_TEAM ? COLLISION_RED_TEAM : COLLISION_BLUE_TEAM;
+}
+
+const FCollisionObjectQueryParams& FNSShotTrace::GetObjectQuery(ETeam ShooterTeam)
+{
+	static const FCollisionObjectQueryParams RedShots(ECC_TO_BITFIELD(COLLISION_PROJECTILE) | ECC_TO_BITFIELD(COLLISION_BLUE_TEAM));
+	static const FCollisionObjectQueryParams BlueShots(ECC_TO_BITFIELD(COLLISION_PROJECTILE) | ECC_TO_BITFIELD(COLLISION_RED_TEAM));
+	static const FCollisionObjectQueryParams AnyTeamShots(ECC_TO_BITFIELD(COLLISION_PROJECTILE) | ECC_TO_BITFIELD(COLLISION_RED_TEAM) | ECC_TO_BITFIELD(COLLISION_BLUE_TEAM));
+
+	if (CVarTeamChannels.GetValueOnAnyThread() == 0)
+	{
+		return AnyTeamShots;
+	}
+	return ShooterTeam == ETeam::RED_TEAM ? RedShots : BlueShots;
+}
+
+/** What a pellet does after reaching an object */
+enum class EShotHitResult : uint8
+{
+	/** Hurt an enemy */
+	Hit,
+	/** Crossed an enemy's capsule between its hitboxes, goes on unchanged */
+	PassThrough,
+	/** Anything else stops it */
+	Stop
+};
+
+/** Resolves the hitbox reached and adds its damage */
+static EShotHitResult AddShotHit(const FHitResult& Hit, const FVector& Origin, const FVector& End, ETeam ShooterTeam,
+	const UNSWeaponDefinition* Weapon, int32 Penetrations, FNSShotDamageList& OutDamage)
+{
+	// The query only reports enemies, the team check is left for ns.Fire.TeamChannels 0
+	ANSCharacter* OtherChar = Cast<ANSCharacter>(Hit.GetActor());
+	if (OtherChar == nullptr || OtherChar->CurrentTeam == ShooterTeam)
+	{
+		return EShotHitResult::Stop;
+	}
+
+	ENSHitZone Zone;
+	float Distance;
+	if (!OtherChar->ResolveHitZone(Origin, End, Zone, Distance))
+	{
+		return EShotHitResult::PassThrough;
+	}
+
+	const float PelletDamage = Weapon->GetDamageAt(Distance, Penetrations) * Weapon->GetZoneDamageScale(Zone);
+
+	FNSShotDamage* Entry = OutDamage.FindByPredicate([OtherChar](const FNSShotDamage& Other) { return Other.Victim == OtherChar; });
+	if (Entry != nullptr)
+	{
+		Entry->Damage += PelletDamage;
+	}
+	else
+	{
+		OutDamage.Add({ OtherChar, PelletDamage });
+	}
+
+	return EShotHitResult::Hit;
+}
+
+/**
+ * One pellet through every object along it, until MaxPenetrations enemies were hurt or something else stops it.
+ * The trace may start past Origin, damage falloff is still measured from it. IgnoredActor was already resolved
+ */
+static void TracePenetrating(UWorld* World, const FVector& Origin, const FVector& TraceStart, const FVector& End, const FCollisionObjectQueryParams& ObjQuery,
+	const FCollisionQueryParams& ColQuery, ETeam ShooterTeam, const UNSWeaponDefinition* Weapon, int32 MaxPenetrations, const AActor* IgnoredActor, FNSShotDamageList& OutDamage)
+{
+	// Object queries report every object along the ray, sorted by distance
+	TArray<FHitResult>& Hits = FNSHitBuffer::Get().Hits;
+	Hits.Reset();
+	World->LineTraceMultiByObjectType(Hits, TraceStart, End, ObjQuery, ColQuery);
+
+	int32 Penetrations = 0;
+	const AActor* LastActor = nullptr;
+
+	for (const FHitResult& Hit : Hits)
+	{
+		// A character can be hit on several components, only the first one counts
+		if (Hit.GetActor() == LastActor || Hit.GetActor() == IgnoredActor)
+		{
+			continue;
+		}
+		LastActor = Hit.GetActor();
+
+		const EShotHitResult Result = AddShotHit(Hit, Origin, End, ShooterTeam, Weapon, Penetrations, OutDamage);
+		if (Result == EShotHitResult::Stop || (Result == EShotHitResult::Hit && ++Penetrations > MaxPenetrations))
+		{
+			break;
+		}
+	}
+}
+
+const FRandomStream& FNSShotTrace::GetFireStream()
+{
+	// Its own stream, so reseeding it never moves bot aim or anything else on FMath::FRand
+	static const FRandomStream Stream(FPlatformTime::Cycles());
+	return Stream;
+}
+
+void FNSShotTrace::Trace(const ANSCharacter* Shooter, ETeam ShooterTeam, const UNSWeaponDefinition* Weapon,
+	const FVector& Origin, const FVector& Direction, const FRandomStream& Spread, FNSShotDamageList& OutDamage)
+{
+	// The fully enabled variant decides pellets and penetration from the weapon at runtime
+	TraceT<true, true>(Shooter, ShooterTeam, Weapon, Origin, Direction, Spread, OutDamage);
+}
+
+template<bool bMultiPellet, bool bPenetrating>
+void FNSShotTrace::TraceT(const ANSCharacter* Shooter, ETeam ShooterTeam, const UNSWeaponDefinition* Weapon,
+	const FVector& Origin, const FVector& Direction, const FRandomStream& Spread, FNSShotDamageList& OutDamage)
+{
+	NS_ALLOC_SCOPE(ShotTrace);
+
+	UWorld* World = Shooter->GetWorld();
+
+	// Both built once, the shooter's ignores itself
+	const FCollisionObjectQueryParams& ObjQuery = GetObjectQuery(ShooterTeam);
+	const FCollisionQueryParams& ColQuery = Shooter->GetShotQueryParams();
+
+	const int32 PelletCount = bMultiPellet ? Weapon->PelletCount : 1;
+
+	for (int32 Pellet = 0; Pellet < PelletCount; ++Pellet)
+	{
+		// A single pellet spreads too, as in the generic path
+		const FVector PelletDir = Weapon->SpreadDegrees > 0.0f
+			? Spread.VRandCone(Direction, FMath::DegreesToRadians(Weapon->SpreadDegrees))
+			: Direction;
+		const FVector End = Origin + PelletDir * Weapon->Range;
+
+		if (bPenetrating)
+		{
+			TracePenetrating(World, Origin, Origin, End, ObjQuery, ColQuery, ShooterTeam, Weapon, Weapon->MaxPenetrations, nullptr, OutDamage);
+		}
+		else
+		{
+			FHitResult Hit;
+			if (World->LineTraceSingleByObjectType(Hit, Origin, End, ObjQuery, ColQuery)
+				&& AddShotHit(Hit, Origin, End, ShooterTeam, Weapon, 0, OutDamage) == EShotHitResult::PassThrough)
+			{
+				// Between the arms or legs of the first enemy, the pellet goes on to whatever is behind it
+				TracePenetrating(World, Origin, Hit.Location, End, ObjQuery, ColQuery, ShooterTeam, Weapon, 0, Hit.GetActor(), OutDamage);
+			}
+		}
+	}
+}
+
+template void FNSShotTrace::TraceT<false, false>(const ANSCharacter*, ETeam, const UNSWeaponDefinition*, const FVector&, const FVector&, const FRandomStream&, FNSShotDamageList&);
+template void FNSShotTrace::TraceT<false, true>(const ANSCharacter*, ETeam, const UNSWeaponDefinition*, const FVector&, const FVector&, const FRandomStream&, FNSShotDamageList&);
+template void FNSShotTrace::TraceT<true, false>(const ANSCharacter*, ETeam, const UNSWeaponDefinition*, const FVector&, const FVector&, const FRandomStream&, FNSShotDamageList&);
+template void FNSShotTrace::TraceT<true, true>(const ANSCharacter*, ETeam, const UNSWeaponDefinition*, const FVector&, const FVector&, const FRandomStream&, FNSShotDamageList&);
+
+static FAutoConsoleCommandWithWorldAndArgs CrowdBenchCommand(
+	TEXT("ns.Fire.CrowdBench"),
+	TEXT("Spawns N characters per team (default 32) in a line, friendlies in front, and logs traces per second with and without team channels over T traces (default 10000). Fails if the team channels hit fewer enemies: ns.Fire.CrowdBench <N> <T>"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		AGameModeBase* GameMode = World != nullptr ? World->GetAuthGameMode() : nullptr;
+		if (GameMode == nullptr)
+		{
+			UE_LOG(LogNS, Warning, TEXT("ns.Fire.CrowdBench only runs on the server"));
+			return;
+		}
+
+		const int32 PerTeam = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 32;
+		const int32 Traces = Args.Num() > 1 ? FMath::Max(FCString::Atoi(*Args[1]), 1) : 10000;
+
+		UClass* CharacterClass = GameMode->DefaultPawnClass != nullptr && GameMode->DefaultPawnClass->IsChildOf(ANSCharacter::StaticClass())
+			? *GameMode->DefaultPawnClass : ANSCharacter::StaticClass();
+
+		// High above the level so only the crowd is on the way
+		const FVector Start(0.0f, 0.0f, 100000.0f);
+		FActorSpawnParameters SpawnParams;
+		SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+		TArray<ANSCharacter*> Crowd;
+		for (int32 i = 0; i < PerTeam * 2; ++i)
+		{
+			ANSCharacter* Character = World->SpawnActor<ANSCharacter>(CharacterClass, Start + FVector(150.0f * i, 0.0f, 0.0f), FRotator::ZeroRotator, SpawnParams);
+			if (Character != nullptr)
+			{
+				Character->SetTeam(i < PerTeam ? ETeam::RED_TEAM : ETeam::BLUE_TEAM);
+				Crowd.Add(Character);
+			}
+		}
+
+		if (Crowd.Num() < 2)
+		{
+			UE_LOG(LogNS, Warning, TEXT("ns.Fire.CrowdBench could not spawn the crowd"));
+			return;
+		}
+
+		// The first red shoots down the line through every other red to reach the blues
+		const ANSCharacter* Shooter = Crowd[0];
+		const UNSWeaponDefinition* Weapon = GetDefault<UNSWeaponDefinition>();
+		const int32 PreviousTeamChannels = CVarTeamChannels.GetValueOnGameThread();
+
+		double Seconds[2];
+		int32 Hits[2];
+		for (int32 Pass = 0; Pass < 2; ++Pass)
+		{
+			CVarTeamChannels->Set(Pass == 0 ? 0 : 1, ECVF_SetByCode);
+			Hits[Pass] = 0;
+
+			const double StartTime = FPlatformTime::Seconds();
+			// Both passes fire the same pellets
+			const FRandomStream Spread(1234);
+			for (int32 i = 0; i < Traces; ++i)
+			{
+				FNSShotDamageList Damages;
+				FNSShotTrace::Trace(Shooter, Shooter->CurrentTeam, Weapon, Start, FVector::ForwardVector, Spread, Damages);
+				Hits[Pass] += Damages.Num();
+			}
+			Seconds[Pass] = FPlatformTime::Seconds() - StartTime;
+		}
+		CVarTeamChannels->Set(PreviousTeamChannels, ECVF_SetByCode);
+
+		UE_LOG(LogNS, Log, TEXT("ns.Fire.CrowdBench %dv%d, %d traces: both teams %.0f traces/s (%d enemies hit), team channels %.0f traces/s (%d enemies hit)"),
+			PerTeam, PerTeam, Traces, Traces / Seconds[0], Hits[0], Traces / Seconds[1], Hits[1]);
+
+		// Friendlies stop nothing on the team channels, so they can only reach more enemies
+		FNSPerfTracker::Expect(Hits[1] >= Hits[0], TEXT("ns.Fire.CrowdBench"),
+			FString::Printf(TEXT("team channels hit %d enemies, querying both teams hit %d"), Hits[1], Hits[0]));
+
+		for (ANSCharacter* Character : Crowd)
+		{
+			Character->Destroy();
+		}
+	}));
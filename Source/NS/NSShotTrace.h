@@ -0,0 +1,60 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "NSFrameArena.h"
+
+enum class ETeam : uint8;
+
+/** Damage gathered for one victim over all the pellets of a shot */
+struct FNSShotDamage
+{
+	class ANSCharacter* Victim;
+	float Damage;
+};
+
+/** Game thread only: past 16 victims the list grows in the frame arena instead of the heap */
+typedef TArray<FNSShotDamage, TInlineAllocator<16, FNSFrameAllocator>> FNSShotDamageList;
+
+/**
+ * Hitscan trace pipeline. Every pellet issues one multi-hit trace into a
+ * per-thread hit buffer that is reused between shots, with query params
+ * built once per character, so firing does not allocate once the buffer
+ * has grown to its working size. ns.Alloc.CheckShot verifies it.
+ *
+ * Characters live on the object channel of their team, so the query only
+ * asks for the shooter's enemies and the physics scene never reports a
+ * teammate: shots go through friendlies. ns.Fire.TeamChannels 0 queries
+ * both teams and stops the pellet at the first teammate instead.
+ *
+ * A character's capsule is only the broad phase: the pellet is then resolved
+ * against its hitboxes (FNSHitboxSet), which pick the damage multiplier of
+ * the body part, or let the pellet through when it misses them all.
+ */
+class FNSShotTrace
+{
+public:
+	/**
+	 * Traces every pellet of Weapon, spread with Spread, and gathers the damage per victim.
+	 * A teammate or any other object stops a pellet without being hurt.
+	 */
+	static void Trace(const class ANSCharacter* Shooter, ETeam ShooterTeam, const class UNSWeaponDefinition* Weapon,
+		const FVector& Origin, const FVector& Direction, const FRandomStream& Spread, FNSShotDamageList& OutDamage);
+
+	/**
+	 * Same as Trace with the pellet loop and penetration compiled in or out.
+	 * TraceT<false, false> is a single closest-hit trace.
+	 */
+	template<bool bMultiPellet, bool bPenetrating>
+	static void TraceT(const class ANSCharacter* Shooter, ETeam ShooterTeam, const class UNSWeaponDefinition* Weapon,
+		const FVector& Origin, const FVector& Direction, const FRandomStream& Spread, FNSShotDamageList& OutDamage);
+
+	/** Pellet spread of the shots of the match. Game thread only, benches seed their own stream */
+	static const FRandomStream& GetFireStream();
+
+	/** Object channel the characters of Team are moved to */
+	static ECollisionChannel GetTeamChannel(ETeam Team);
+
+	/** Objects a shot of ShooterTeam can hit. Built once per team */
+	static const FCollisionObjectQueryParams& GetObjectQuery(ETeam ShooterTeam);
+};
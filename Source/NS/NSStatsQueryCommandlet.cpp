@@ -0,0 +1,342 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "NS.h"
+#include "NSStatsQueryCommandlet.h"
+#include "NSMatchStats.h"
+
+/** Records read per block, 2 MB */
+static const int32 RecordsPerBlock = 65536;
+
+/** Running totals of one player */
+struct FNSStatsTotals
+{
+	uint64 Kills;
+	uint64 Deaths;
+	uint64 Shots;
+	uint64 Hits;
+	uint64 Lives;
+	double LifeSeconds;
+
+	/** Last spawn not yet closed by a death */
+	uint32 SpawnMatch;
+	float SpawnTime;
+
+	FNSStatsTotals()
+	{
+		FMemory::Memzero(*this);
+	}
+};
+
+static bool ReadHeader(IFileHandle* File, const FString& Path)
+{
+	FNSStatsFileHeader Header;
+	if (!File->Read((uint8*)&Header, sizeof(Header)) || Header.Magic != FNSMatchStats::FileMagic || Header.RecordSize != sizeof(FNSStatsRecord))
+	{
+		UE_LOG(LogNS, Error, TEXT("%s is not an NS stats file"), *Path);
+		return false;
+	}
+	return true;
+}
+
+static TMap<uint64, FString> LoadNames(const FString& Path)
+{
+	TMap<uint64, FString> Names;
+
+	// Written as UTF-8 without a byte order mark
+	TArray<uint8> Bytes;
+	if (!FFileHelper::LoadFileToArray(Bytes, *Path, FILEREAD_Silent))
+	{
+		return Names;
+	}
+	Bytes.Add(0);
+
+	TArray<FString> Lines;
+	FString(UTF8_TO_TCHAR((const ANSICHAR*)Bytes.GetData())).ParseIntoArrayLines(Lines);
+	for (const FString& Line : Lines)
+	{
+		FString Id;
+		FString Name;
+		if (Line.Split(TEXT(","), &Id, &Name))
+		{
+			Names.Add(FCString::Strtoui64(*Id, nullptr, 10), Name);
+		}
+	}
+	return Names;
+}
+
+UNSStatsQueryCommandlet::UNSStatsQueryCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UNSStatsQueryCommandlet::Main(const FString& Params)
+{
+	FString DataPath = FNSMatchStats::GetDataPath();
+	FParse::Value(*Params, TEXT("file="), DataPath);
+
+	int64 GenerateRecords = 0;
+	if (FParse::Value(*Params, TEXT("generate="), GenerateRecords))
+	{
+		return Generate(DataPath, GenerateRecords);
+	}
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	TUniquePtr<IFileHandle> File(PlatformFile.OpenRead(*DataPath));
+	if (!File.IsValid())
+	{
+		UE_LOG(LogNS, Error, TEXT("Could not open %s"), *DataPath);
+		return 1;
+	}
+	if (!ReadHeader(File.Get(), DataPath))
+	{
+		return 1;
+	}
+
+	const int64 TotalRecords = (File->Size() - (int64)sizeof(FNSStatsFileHeader)) / (int64)sizeof(FNSStatsRecord);
+	int64 FirstRecord = 0;
+	int64 NumRecords = TotalRecords;
+
+	// A single match is read from its range in the index, or filtered from a full scan if it never ended
+	uint32 MatchFilter = 0;
+	FParse::Value(*Params, TEXT("match="), MatchFilter);
+	const bool bLastMatch = FParse::Param(*Params, TEXT("last"));
+
+	if (MatchFilter != 0 || bLastMatch)
+	{
+		TArray<uint8> IndexData;
+		FFileHelper::LoadFileToArray(IndexData, *FPaths::ChangeExtension(DataPath, TEXT("idx")), FILEREAD_Silent);
+
+		const FNSStatsIndexEntry* Entries = (const FNSStatsIndexEntry*)IndexData.GetData();
+		const int32 NumEntries = IndexData.Num() / sizeof(FNSStatsIndexEntry);
+
+		const FNSStatsIndexEntry* Found = nullptr;
+		for (int32 i = NumEntries - 1; i >= 0 && Found == nullptr; --i)
+		{
+			if (bLastMatch || Entries[i].MatchId == MatchFilter)
+			{
+				Found = &Entries[i];
+			}
+		}
+
+		if (Found != nullptr)
+		{
+			MatchFilter = Found->MatchId;
+			FirstRecord = FMath::Min((int64)Found->FirstRecord, TotalRecords);
+			NumRecords = FMath::Min((int64)Found->NumRecords, TotalRecords - FirstRecord);
+		}
+		else if (bLastMatch)
+		{
+			UE_LOG(LogNS, Error, TEXT("No match has ended in %s yet"), *DataPath);
+			return 1;
+		}
+	}
+
+	const TMap<uint64, FString> Names = LoadNames(FPaths::ChangeExtension(DataPath, TEXT("names")));
+
+	FString PlayerFilter;
+	FParse::Value(*Params, TEXT("player="), PlayerFilter);
+
+	int32 Top = 20;
+	FParse::Value(*Params, TEXT("top="), Top);
+
+	const double StartTime = FPlatformTime::Seconds();
+
+	TMap<uint64, FNSStatsTotals> Players;
+	TSet<uint32> Matches;
+	TArray<FNSStatsRecord> Block;
+	Block.SetNumUninitialized(RecordsPerBlock);
+
+	File->Seek(sizeof(FNSStatsFileHeader) + FirstRecord * sizeof(FNSStatsRecord));
+
+	for (int64 Done = 0; Done < NumRecords; )
+	{
+		const int32 Count = (int32)FMath::Min<int64>(RecordsPerBlock, NumRecords - Done);
+		if (!File->Read((uint8*)Block.GetData(), Count * sizeof(FNSStatsRecord)))
+		{
+			UE_LOG(LogNS, Error, TEXT("Read failed at record %lld of %s"), FirstRecord + Done, *DataPath);
+			return 1;
+		}
+		Done += Count;
+
+		for (int32 i = 0; i < Count; ++i)
+		{
+			const FNSStatsRecord& Record = Block[i];
+			if (MatchFilter != 0 && Record.MatchId != MatchFilter)
+			{
+				continue;
+			}
+
+			switch ((ENSStatsEvent)Record.Event)
+			{
+			case ENSStatsEvent::MatchBegin:
+				Matches.Add(Record.MatchId);
+				break;
+
+			case ENSStatsEvent::Spawn:
+			{
+				FNSStatsTotals& Totals = Players.FindOrAdd(Record.PlayerId);
+				Totals.SpawnMatch = Record.MatchId;
+				Totals.SpawnTime = Record.Time;
+				break;
+			}
+
+			case ENSStatsEvent::Shot:
+				Players.FindOrAdd(Record.PlayerId).Shots++;
+				break;
+
+			case ENSStatsEvent::Hit:
+				Players.FindOrAdd(Record.PlayerId).Hits++;
+				break;
+
+			case ENSStatsEvent::Kill:
+				Players.FindOrAdd(Record.PlayerId).Kills++;
+				break;
+
+			case ENSStatsEvent::Death:
+			{
+				FNSStatsTotals& Totals = Players.FindOrAdd(Record.PlayerId);
+				Totals.Deaths++;
+				if (Totals.SpawnMatch == Record.MatchId)
+				{
+					Totals.Lives++;
+					Totals.LifeSeconds += Record.Time - Totals.SpawnTime;
+					Totals.SpawnMatch = 0;
+				}
+				break;
+			}
+
+			default:
+				break;
+			}
+		}
+	}
+
+	const double Seconds = FPlatformTime::Seconds() - StartTime;
+
+	TArray<uint64> Ids;
+	Players.GenerateKeyArray(Ids);
+	Ids.Sort([&Players](uint64 A, uint64 B) { return Players[A].Kills > Players[B].Kills; });
+
+	UE_LOG(LogNS, Display, TEXT("%lld records, %d matches, %d players read in %.3f s (%.1f M records/s)"),
+		NumRecords, Matches.Num(), Players.Num(), Seconds, Seconds > 0.0 ? NumRecords / Seconds / 1000000.0 : 0.0);
+	UE_LOG(LogNS, Display, TEXT("%-24s %8s %8s %6s %10s %10s %8s %10s"),
+		TEXT("Player"), TEXT("Kills"), TEXT("Deaths"), TEXT("K/D"), TEXT("Shots"), TEXT("Hits"), TEXT("Acc %"), TEXT("Life (s)"));
+
+	int32 Shown = 0;
+	for (uint64 Id : Ids)
+	{
+		const FString* Name = Names.Find(Id);
+		const FString DisplayName = Name != nullptr ? *Name : FString::Printf(TEXT("%llu"), Id);
+		if (!PlayerFilter.IsEmpty() ? DisplayName != PlayerFilter : Shown >= Top)
+		{
+			continue;
+		}
+		++Shown;
+
+		const FNSStatsTotals& Totals = Players[Id];
+		UE_LOG(LogNS, Display, TEXT("%-24s %8llu %8llu %6.2f %10llu %10llu %8.1f %10.1f"), *DisplayName,
+			Totals.Kills, Totals.Deaths, Totals.Deaths > 0 ? (double)Totals.Kills / Totals.Deaths : (double)Totals.Kills,
+			Totals.Shots, Totals.Hits, Totals.Shots > 0 ? Totals.Hits * 100.0 / Totals.Shots : 0.0,
+			Totals.Lives > 0 ? Totals.LifeSeconds / Totals.Lives : 0.0);
+	}
+
+	return 0;
+}
+
+int32 UNSStatsQueryCommandlet::Generate(const FString& DataPath, int64 NumRecords)
+{
+	const int32 NumPlayers = 64;
+	const int64 RecordsPerMatch = 100000;
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	PlatformFile.CreateDirectoryTree(*FPaths::GetPath(DataPath));
+
+	uint32 MatchId = FNSMatchStats::ReadLastMatchId(DataPath);
+
+	TUniquePtr<IFileHandle> DataFile(PlatformFile.OpenWrite(*DataPath, true, false));
+	TUniquePtr<IFileHandle> IndexFile(PlatformFile.OpenWrite(*FPaths::ChangeExtension(DataPath, TEXT("idx")), true, false));
+	if (!DataFile.IsValid() || !IndexFile.IsValid())
+	{
+		UE_LOG(LogNS, Error, TEXT("Could not open %s"), *DataPath);
+		return 1;
+	}
+
+	const int64 Size = DataFile->Size();
+	if (Size == 0)
+	{
+		const FNSStatsFileHeader Header = { FNSMatchStats::FileMagic, FNSMatchStats::FileVersion, sizeof(FNSStatsRecord), 0 };
+		DataFile->Write((const uint8*)&Header, sizeof(Header));
+	}
+	else if (Size < (int64)sizeof(FNSStatsFileHeader) || (Size - (int64)sizeof(FNSStatsFileHeader)) % (int64)sizeof(FNSStatsRecord) != 0)
+	{
+		UE_LOG(LogNS, Error, TEXT("%s is not an NS stats file"), *DataPath);
+		return 1;
+	}
+	uint64 NextRecord = Size > 0 ? (Size - (int64)sizeof(FNSStatsFileHeader)) / (int64)sizeof(FNSStatsRecord) : 0;
+
+	uint64 PlayerIds[NumPlayers];
+	FString Names;
+	for (int32 i = 0; i < NumPlayers; ++i)
+	{
+		const FString Name = FString::Printf(TEXT("Synthetic %d"), i);
+		PlayerIds[i] = FNSMatchStats::HashPlayerKey(Name);
+		Names += FString::Printf(TEXT("%llu,%s\n"), PlayerIds[i], *Name);
+	}
+	FFileHelper::SaveStringToFile(Names, *FPaths::ChangeExtension(DataPath, TEXT("names")), FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM, &IFileManager::Get(), FILEWRITE_Append);
+
+	FRandomStream Random(NumRecords);
+	TArray<FNSStatsRecord> Block;
+	Block.Reserve(RecordsPerBlock);
+
+	for (int64 Written = 0; Written < NumRecords; )
+	{
+		const int64 MatchRecords = FMath::Min(RecordsPerMatch, NumRecords - Written);
+		const FNSStatsIndexEntry Entry = { ++MatchId, 0, NextRecord, (uint64)MatchRecords };
+		float Time = 0.0f;
+
+		for (int64 i = 0; i < MatchRecords; ++i)
+		{
+			FNSStatsRecord& Record = Block[Block.AddZeroed()];
+			Record.MatchId = MatchId;
+			Record.Time = Time;
+
+			// Mostly shots, a third of them hit, one hit in ten kills and the victim spawns again
+			const int32 Player = Random.RandHelper(NumPlayers);
+			const int32 Other = (Player + 1 + Random.RandHelper(NumPlayers - 1)) % NumPlayers;
+			const float Roll = Random.FRand();
+			Record.PlayerId = PlayerIds[Player];
+			Record.Team = (uint8)(Player % 2);
+			Record.Event = (uint8)(i == 0 ? ENSStatsEvent::MatchBegin
+				: Roll < 0.7f ? ENSStatsEvent::Shot
+				: Roll < 0.9f ? ENSStatsEvent::Hit
+				: Roll < 0.95f ? ENSStatsEvent::Spawn
+				: Roll < 0.975f ? ENSStatsEvent::Kill
+				: ENSStatsEvent::Death);
+			Record.OtherId = Record.Event == (uint8)ENSStatsEvent::Shot || Record.Event == (uint8)ENSStatsEvent::Spawn ? 0 : PlayerIds[Other];
+			Record.Value = Record.Event == (uint8)ENSStatsEvent::Hit ? 20.0f : 0.0f;
+
+			Time += 0.01f;
+
+			if (Block.Num() == RecordsPerBlock)
+			{
+				DataFile->Write((const uint8*)Block.GetData(), Block.Num() * sizeof(FNSStatsRecord));
+				Block.Reset();
+			}
+		}
+
+		NextRecord += MatchRecords;
+		Written += MatchRecords;
+		IndexFile->Write((const uint8*)&Entry, sizeof(Entry));
+	}
+
+	if (Block.Num() > 0)
+	{
+		DataFile->Write((const uint8*)Block.GetData(), Block.Num() * sizeof(FNSStatsRecord));
+	}
+
+	UE_LOG(LogNS, Display, TEXT("Appended %lld synthetic records to %s"), NumRecords, *DataPath);
+	return 0;
+}
@@ -0,0 +1,29 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "Commandlets/Commandlet.h"
+#include "NSStatsQueryCommandlet.generated.h"
+
+/**
+ * Aggregates the records written by FNSMatchStats into kills, deaths, K/D,
+ * accuracy and average time from spawn to death per player. The data file
+ * is streamed in fixed blocks, so memory does not grow with its size, and
+ * a single match is read straight from its index range.
+ *
+ * Usage: NS -run=NSStatsQuery [-file=<NSStats.dat>] [-match=<Id> | -last] [-player=<Name>] [-top=<N>]
+ *        NS -run=NSStatsQuery -generate=<Records> [-file=<Path>] appends synthetic matches to measure queries
+ */
+UCLASS()
+class UNSStatsQueryCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UNSStatsQueryCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+
+private:
+	int32 Generate(const FString& DataPath, int64 NumRecords);
+};
@@ -0,0 +1,235 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "NS.h"
+#include "NSTimerWheel.h"
+
+FNSTimerWheel::FNSTimerWheel(int32 InNumSlots, float InTickSeconds)
+	: NumSlots(FMath::Max(InNumSlots, 1))
+	, TickSeconds(FMath::Max(InTickSeconds, KINDA_SMALL_NUMBER))
+	, Accumulator(0.0f)
+	, CurrentTick(0)
+	, NumActive(0)
+{
+	SlotHeads.Init(INDEX_NONE, NumSlots);
+	SlotTails.Init(INDEX_NONE, NumSlots);
+}
+
+FNSTimerHandle FNSTimerWheel::Schedule(float Delay, uint32 OwnerId, uint8 Type, UObject* Target)
+{
+	int32 Index;
+	if (FreeEntries.Num() > 0)
+	{
+		Index = FreeEntries.Pop(false);
+	}
+	else
+	{
+		Index = Entries.AddZeroed();
+	}
+
+	// Time already accumulated towards the next tick counts as elapsed
+	const uint64 Ticks = (uint64)FMath::Max(FMath::CeilToInt((Delay + Accumulator) / TickSeconds), 1);
+	const int32 Slot = SlotOf(CurrentTick + Ticks);
+
+	FEntry& Entry = Entries[Index];
+	Entry.Target = Target;
+	Entry.OwnerId = OwnerId;
+	Entry.Generation++;
+	Entry.Rounds = (uint32)((Ticks - 1) / (uint64)NumSlots);
+	Entry.Slot = Slot;
+	Entry.Type = Type;
+	Entry.bActive = true;
+
+	// Append to the slot so timers due on the same tick keep their scheduling order
+	Entry.Prev = SlotTails[Slot];
+	Entry.Next = INDEX_NONE;
+	if (Entry.Prev != INDEX_NONE)
+	{
+		Entries[Entry.Prev].Next = Index;
+	}
+	else
+	{
+		SlotHeads[Slot] = Index;
+	}
+	SlotTails[Slot] = Index;
+
+	int32* FoundHead = OwnerHeads.Find(OwnerId);
+	int32& OwnerHead = FoundHead != nullptr ? *FoundHead : OwnerHeads.Add(OwnerId, INDEX_NONE);
+	Entry.OwnerPrev = INDEX_NONE;
+	Entry.OwnerNext = OwnerHead;
+	if (OwnerHead != INDEX_NONE)
+	{
+		Entries[OwnerHead].OwnerPrev = Index;
+	}
+	OwnerHead = Index;
+
+	NumActive++;
+
+	FNSTimerHandle Handle;
+	Handle.Index = Index;
+	Handle.Generation = Entry.Generation;
+	return Handle;
+}
+
+bool FNSTimerWheel::IsPending(FNSTimerHandle Handle) const
+{
+	return Entries.IsValidIndex(Handle.Index) && Entries[Handle.Index].bActive && Entries[Handle.Index].Generation == Handle.Generation;
+}
+
+bool FNSTimerWheel::Cancel(FNSTimerHandle Handle)
+{
+	if (!IsPending(Handle))
+	{
+		return false;
+	}
+
+	Release(Handle.Index);
+	return true;
+}
+
+int32 FNSTimerWheel::CancelOwner(uint32 OwnerId)
+{
+	int32 Cancelled = 0;
+
+	const int32* OwnerHead = OwnerHeads.Find(OwnerId);
+	while (OwnerHead != nullptr && *OwnerHead != INDEX_NONE)
+	{
+		Release(*OwnerHead);
+		Cancelled++;
+		OwnerHead = OwnerHeads.Find(OwnerId);
+	}
+
+	return Cancelled;
+}
+
+void FNSTimerWheel::CollectExpired(int32 Slot)
+{
+	Expired.Reset();
+
+	for (int32 Index = SlotHeads[Slot]; Index != INDEX_NONE; Index = Entries[Index].Next)
+	{
+		FEntry& Entry = Entries[Index];
+		if (Entry.Rounds > 0)
+		{
+			Entry.Rounds--;
+		}
+		else
+		{
+			FNSTimerHandle Handle;
+			Handle.Index = Index;
+			Handle.Generation = Entry.Generation;
+			Expired.Add(Handle);
+		}
+	}
+}
+
+void FNSTimerWheel::Release(int32 Index)
+{
+	FEntry& Entry = Entries[Index];
+	check(Entry.bActive);
+
+	if (Entry.Prev != INDEX_NONE)
+	{
+		Entries[Entry.Prev].Next = Entry.Next;
+	}
+	else
+	{
+		SlotHeads[Entry.Slot] = Entry.Next;
+	}
+
+	if (Entry.Next != INDEX_NONE)
+	{
+		Entries[Entry.Next].Prev = Entry.Prev;
+	}
+	else
+	{
+		SlotTails[Entry.Slot] = Entry.Prev;
+	}
+
+	if (Entry.OwnerPrev != INDEX_NONE)
+	{
+		Entries[Entry.OwnerPrev].OwnerNext = Entry.OwnerNext;
+	}
+	else if (Entry.OwnerNext != INDEX_NONE)
+	{
+		OwnerHeads.Add(Entry.OwnerId, Entry.OwnerNext);
+	}
+	else
+	{
+		OwnerHeads.Remove(Entry.OwnerId);
+	}
+
+	if (Entry.OwnerNext != INDEX_NONE)
+	{
+		Entries[Entry.OwnerNext].OwnerPrev = Entry.OwnerPrev;
+	}
+
+	Entry.Target = nullptr;
+	Entry.bActive = false;
+	FreeEntries.Add(Index);
+	NumActive--;
+}
+
+static FAutoConsoleCommand TimerSoakCommand(
+	TEXT("ns.Timers.Soak"),
+	TEXT("Schedules N timers (default 100000) on a standalone wheel, cancels half of them, runs it dry at 60 Hz and checks count and ordering: ns.Timers.Soak <N>"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		const int32 Count = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 100000;
+		const float TickSeconds = 1.0f / 60.0f;
+
+		FNSTimerWheel Wheel(512, TickSeconds);
+		FRandomStream Random(1234);
+
+		TArray<FNSTimerHandle> Handles;
+		TArray<uint64> DueTicks;
+		Handles.Reserve(Count);
+		DueTicks.Reserve(Count);
+
+		const double ScheduleStart = FPlatformTime::Seconds();
+		for (int32 i = 0; i < Count; ++i)
+		{
+			const float Delay = Random.FRandRange(0.0f, 60.0f);
+			DueTicks.Add((uint64)FMath::Max(FMath::CeilToInt(Delay / TickSeconds), 1));
+
+			// The owner id carries the schedule order so ordering can be checked on expiry
+			Handles.Add(Wheel.Schedule(Delay, (uint32)i, 0, nullptr));
+		}
+		const double ScheduleSeconds = FPlatformTime::Seconds() - ScheduleStart;
+
+		const double CancelStart = FPlatformTime::Seconds();
+		int32 Cancelled = 0;
+		for (int32 i = 0; i < Count; i += 2)
+		{
+			Cancelled += Wheel.Cancel(Handles[i]) ? 1 : 0;
+		}
+		const double CancelSeconds = FPlatformTime::Seconds() - CancelStart;
+
+		int32 Fired = 0;
+		int32 OutOfOrder = 0;
+		int32 Ticks = 0;
+		uint64 LastDue = 0;
+		uint32 LastOwner = 0;
+
+		const double AdvanceStart = FPlatformTime::Seconds();
+		while (Wheel.Num() > 0)
+		{
+			Ticks++;
+			Wheel.Advance(TickSeconds, [&](uint8 Type, uint32 OwnerId, UObject* Target)
+			{
+				const uint64 Due = DueTicks[OwnerId];
+				if ((Fired > 0 && (Due < LastDue || (Due == LastDue && OwnerId < LastOwner))) || OwnerId % 2 == 0)
+				{
+					OutOfOrder++;
+				}
+				LastDue = Due;
+				LastOwner = OwnerId;
+				Fired++;
+			});
+		}
+		const double AdvanceSeconds = FPlatformTime::Seconds() - AdvanceStart;
+
+		const bool bPassed = Fired + Cancelled == Count && OutOfOrder == 0;
+		UE_LOG(LogNS, Log, TEXT("ns.Timers.Soak %s: %d scheduled in %.2f ms, %d cancelled in %.2f ms, %d fired over %d ticks in %.2f ms (%.3f us/tick), %d out of order"),
+			bPassed ? TEXT("PASSED") : TEXT("FAILED"), Count, ScheduleSeconds * 1000.0, Cancelled, CancelSeconds * 1000.0,
+			Fired, Ticks, AdvanceSeconds * 1000.0, AdvanceSeconds * 1000000.0 / FMath::Max(Ticks, 1), OutOfOrder);
+	}));
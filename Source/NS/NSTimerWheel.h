@@ -0,0 +1,121 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+/** Identifies a scheduled timer, stays safe to use after the timer fired or was cancelled */
+struct FNSTimerHandle
+{
+	int32 Index;
+	uint32 Generation;
+
+	FNSTimerHandle()
+		: Index(INDEX_NONE)
+		, Generation(0)
+	{
+	}
+
+	bool IsValid() const { return Index != INDEX_NONE; }
+};
+
+/**
+ * Hashed timer wheel. Scheduling and cancelling are O(1) and advancing one
+ * tick only visits the timers hashed to that tick's slot, so thousands of
+ * pending timers cost almost nothing per frame.
+ *
+ * Timers fire in due tick order, and timers due on the same tick fire in
+ * the order they were scheduled. Every timer has an owner id so all the
+ * timers of a player can be cancelled at once when they leave. Entries are
+ * pooled: once the pool has grown, scheduling does not allocate.
+ */
+class FNSTimerWheel
+{
+public:
+	explicit FNSTimerWheel(int32 InNumSlots = 512, float InTickSeconds = 1.0f / 60.0f);
+
+	/** Schedules a timer of the given type firing after Delay seconds */
+	FNSTimerHandle Schedule(float Delay, uint32 OwnerId, uint8 Type, UObject* Target);
+
+	/** Returns false if the timer already fired or was cancelled */
+	bool Cancel(FNSTimerHandle Handle);
+
+	/** Cancels every pending timer of OwnerId, returns how many were cancelled */
+	int32 CancelOwner(uint32 OwnerId);
+
+	bool IsPending(FNSTimerHandle Handle) const;
+
+	int32 Num() const { return NumActive; }
+
+	/**
+	 * Advances the wheel and calls OnExpired(Type, OwnerId, Target) for every
+	 * timer that is due. Callbacks may schedule and cancel timers.
+	 */
+	template<typename FuncType>
+	void Advance(float DeltaSeconds, FuncType OnExpired)
+	{
+		Accumulator += DeltaSeconds;
+
+		while (Accumulator >= TickSeconds)
+		{
+			Accumulator -= TickSeconds;
+			CurrentTick++;
+
+			CollectExpired(SlotOf(CurrentTick));
+
+			for (const FNSTimerHandle& Handle : Expired)
+			{
+				if (IsPending(Handle))
+				{
+					const FEntry& Entry = Entries[Handle.Index];
+					const uint8 Type = Entry.Type;
+					const uint32 OwnerId = Entry.OwnerId;
+					UObject* Target = Entry.Target.Get();
+
+					Release(Handle.Index);
+					OnExpired(Type, OwnerId, Target);
+				}
+			}
+		}
+	}
+
+private:
+	struct FEntry
+	{
+		FWeakObjectPtr Target;
+		uint32 OwnerId;
+		uint32 Generation;
+
+		/** Full turns of the wheel left before firing */
+		uint32 Rounds;
+
+		int32 Slot;
+		int32 Prev;
+		int32 Next;
+		int32 OwnerPrev;
+		int32 OwnerNext;
+		uint8 Type;
+		bool bActive;
+	};
+
+	int32 SlotOf(uint64 Tick) const { return (int32)(Tick % (uint64)NumSlots); }
+
+	/** Decrements the rounds of the slot's timers and stores the due ones in Expired */
+	void CollectExpired(int32 Slot);
+
+	/** Unlinks an entry from its slot and owner lists and returns it to the pool */
+	void Release(int32 Index);
+
+	int32 NumSlots;
+	float TickSeconds;
+	float Accumulator;
+	uint64 CurrentTick;
+	int32 NumActive;
+
+	TArray<FEntry> Entries;
+	TArray<int32> FreeEntries;
+	TArray<int32> SlotHeads;
+	TArray<int32> SlotTails;
+	TMap<uint32, int32> OwnerHeads;
+
+	/** Reused between ticks */
+	TArray<FNSTimerHandle> Expired;
+};
@@ -0,0 +1,81 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "NS.h"
+#include "NSWeaponDefinition.h"
+#include "NSHitboxes.h"
+
+
+UNSWeaponDefinition::UNSWeaponDefinition()
+{
+	// Same values the hitscan used before weapons were data driven
+	FireTrace = ENSFireTrace::Hitscan;
+	FireMode = ENSFireMode::Single;
+	FireInterval = 0.1f;
+	bPlayEffects = true;
+	ProjectileClass = nullptr;
+	Damage = 10.0f;
+	Range = 10000000.0f;
+	DamageFalloff = nullptr;
+	HeadDamageScale = 2.0f;
+	TorsoDamageScale = 1.0f;
+	ArmDamageScale = 0.75f;
+	LegDamageScale = 0.75f;
+	ExplosionRadius = 0.0f;
+	ExplosionInnerRadius = 50.0f;
+	ExplosionMinDamageScale = 0.1f;
+	ExplosionFalloff = 1.0f;
+	PelletCount = 1;
+	SpreadDegrees = 0.0f;
+	MaxPenetrations = 0;
+	PenetrationDamageScale = 0.5f;
+}
+
+float UNSWeaponDefinition::GetDamageAt(float Distance, int32 Penetrations) const
+{
+	float Result = Damage;
+
+	if (DamageFalloff != nullptr)
+	{
+		Result *= DamageFalloff->GetFloatValue(Distance);
+	}
+
+	for (int32 i = 0; i < Penetrations; ++i)
+	{
+		Result *= PenetrationDamageScale;
+	}
+
+	return Result;
+}
+
+float UNSWeaponDefinition::GetZoneDamageScale(ENSHitZone Zone) const
+{
+	switch (Zone)
+	{
+	case ENSHitZone::Head:
+		return HeadDamageScale;
+	case ENSHitZone::Arm:
+		return ArmDamageScale;
+	case ENSHitZone::Leg:
+		return LegDamageScale;
+	default:
+		return TorsoDamageScale;
+	}
+}
+
+float UNSWeaponDefinition::GetExplosionDamageAt(float Distance) const
+{
+	if (Distance > ExplosionRadius)
+	{
+		return 0.0f;
+	}
+
+	// The default inner radius is larger than the smallest explosions
+	const float InnerRadius = FMath::Min(ExplosionInnerRadius, ExplosionRadius);
+	if (Distance <= InnerRadius)
+	{
+		return Damage;
+	}
+
+	const float Alpha = (ExplosionRadius - Distance) / FMath::Max(ExplosionRadius - InnerRadius, KINDA_SMALL_NUMBER);
+	return Damage * FMath::Lerp(ExplosionMinDamageScale, 1.0f, FMath::Pow(Alpha, ExplosionFalloff));
+}
@@ -0,0 +1,122 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "Engine/DataAsset.h"
+#include "NSWeaponDefinition.generated.h"
+
+enum class ENSHitZone : uint8;
+
+/** How a shot reaches its target */
+UENUM(BlueprintType)
+enum class ENSFireTrace : uint8
+{
+	Hitscan,
+	Projectile
+};
+
+/** How many shots a trigger pull produces */
+UENUM(BlueprintType)
+enum class ENSFireMode : uint8
+{
+	Single,
+	Burst,
+	Auto
+};
+
+/**
+ * Describes how a weapon's shot is traced and how much damage it deals.
+ * Characters without a weapon asset use this class' defaults.
+ */
+UCLASS(BlueprintType)
+class NS_API UNSWeaponDefinition : public UDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	UNSWeaponDefinition();
+
+	/** Hitscan traces on the server, Projectile spawns ProjectileClass */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = Firing)
+	ENSFireTrace FireTrace;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = Firing)
+	ENSFireMode FireMode;
+
+	/** Seconds between shots of a burst or of automatic fire */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = Firing, meta = (ClampMin = "0.01"))
+	float FireInterval;
+
+	/** Play and replicate animations, sounds and particles for each shot */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = Firing)
+	bool bPlayEffects;
+
+	/** Spawned by Projectile weapons */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = Firing)
+	TSubclassOf<class ANSProjectile> ProjectileClass;
+
+	/** Damage of a single pellet at point blank */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = Damage)
+	float Damage;
+
+	/** Maximum trace distance, in cm */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = Damage)
+	float Range;
+
+	/** Damage multiplier by distance in cm. No curve means no falloff */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = Damage)
+	class UCurveFloat* DamageFalloff;
+
+	/** Damage multipliers by hitbox zone */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = Damage, meta = (ClampMin = "0"))
+	float HeadDamageScale;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = Damage, meta = (ClampMin = "0"))
+	float TorsoDamageScale;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = Damage, meta = (ClampMin = "0"))
+	float ArmDamageScale;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = Damage, meta = (ClampMin = "0"))
+	float LegDamageScale;
+
+	/** Radius, in cm, of the explosion of a Projectile weapon, with Damage at its centre. 0 only pushes physics objects */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = Explosion, meta = (ClampMin = "0"))
+	float ExplosionRadius;
+
+	/** Enemies this close to the centre take the full Damage. Never more than ExplosionRadius */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = Explosion, meta = (ClampMin = "0"))
+	float ExplosionInnerRadius;
+
+	/** Fraction of Damage at the edge of the explosion */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = Explosion, meta = (ClampMin = "0", ClampMax = "1"))
+	float ExplosionMinDamageScale;
+
+	/** Exponent of the falloff from the inner radius to the edge, 1 is linear */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = Explosion, meta = (ClampMin = "0.1"))
+	float ExplosionFalloff;
+
+	/** Traces per shot, e.g. 12 for a shotgun */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = Pellets, meta = (ClampMin = "1"))
+	int32 PelletCount;
+
+	/** Half angle of the pellet cone, in degrees */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = Pellets, meta = (ClampMin = "0"))
+	float SpreadDegrees;
+
+	/** Number of enemies a pellet goes through before stopping */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = Penetration, meta = (ClampMin = "0"))
+	int32 MaxPenetrations;
+
+	/** Damage multiplier applied after each enemy a pellet goes through */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = Penetration, meta = (ClampMin = "0", ClampMax = "1"))
+	float PenetrationDamageScale;
+
+	/** Damage of one pellet at Distance, after it went through Penetrations enemies */
+	float GetDamageAt(float Distance, int32 Penetrations) const;
+
+	float GetZoneDamageScale(ENSHitZone Zone) const;
+
+	/** Explosion damage Distance cm from its centre, 0 past ExplosionRadius */
+	float GetExplosionDamageAt(float Distance) const;
+};